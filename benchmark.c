@@ -0,0 +1,667 @@
+//
+// --- Frame benchmark, replays scripted frames on headless consoles
+//
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "console.h"
+#include "console_drawlist.h"
+#include "console_thread.h"
+#include "console_record.h"
+#include "console_sprite.h"
+#include "console_layer.h"
+
+#define SNAKE_LENGTH 48
+
+typedef struct BenchSize
+{
+    int width;
+    int height;
+} BenchSize;
+
+typedef void (*BenchScene)(Console* console, ConsoleBuffer* canvas, int frame);
+
+typedef struct BenchTimes
+{
+    double drawSeconds;
+    double displaySeconds;
+    uint64_t bytes;
+} BenchTimes;
+
+void bench_countBytes(void* userData, const char* bytes, size_t size)
+{
+    BenchTimes* times = userData;
+    times->bytes += size;
+}
+
+// Paints a fixed scribble into the canvas, standing in for the user's drawing in example.c
+void bench_initCanvas(ConsoleBuffer* canvas)
+{
+    srand(1);
+
+    for (int i = 0; i < 40; i++)
+    {
+        int x1 = 1 + rand() % (canvas->width - 2);
+        int y1 = 1 + rand() % (canvas->height - 3);
+        int x2 = 1 + rand() % (canvas->width - 2);
+        int y2 = 1 + rand() % (canvas->height - 3);
+        uint8_t colour = 1 + rand() % 15;
+
+        if (i % 2 == 0) ConsoleBuffer_drawLine(canvas, x1, y1, x2, y2, ' ', colour << 4);
+        else ConsoleBuffer_drawRect(canvas, min(x1, x2), min(y1, y2), abs(x2 - x1) / 4 + 1, abs(y2 - y1) / 4 + 1, ' ', colour << 4);
+    }
+}
+
+// The drawing example's border, tooltips and colour selection
+void bench_drawChrome(ConsoleBuffer* buffer)
+{
+    const int width = buffer->width;
+    const int height = buffer->height;
+
+    ConsoleBuffer_drawLine(buffer, 0, 0, 0, height, ' ', 8 << 4);
+    ConsoleBuffer_drawLine(buffer, 0, 0, width, 0, ' ', 8 << 4);
+    ConsoleBuffer_drawLine(buffer, width - 1, 0, width - 1, height, ' ', 8 << 4);
+    ConsoleBuffer_drawRect(buffer, 0, height - 2, width, 2, ' ', 8 << 4);
+
+    ConsoleBuffer_drawText(buffer, "Epic Console Drawing", width / 2 - 10, 0, 0x8F);
+    ConsoleBuffer_drawText(buffer, "Space to clear", 0, height - 2, 0x8F);
+    ConsoleBuffer_drawText(buffer, "Escape to quit", 0, height - 1, 0x8F);
+    ConsoleBuffer_drawText(buffer, "Shift for line tool", 18, height - 2, 0x8F);
+    ConsoleBuffer_drawText(buffer, "Ctrl for rect tool", 18, height - 1, 0x8F);
+
+    for (int i = 1; i < 16; i++)
+    {
+        ConsoleBuffer_drawRect(buffer, 43 + i * 2, height - 2, 2, 1, ' ', i << 4);
+    }
+}
+
+// Cursor sweeping across the canvas
+ConsolePoint bench_cursorPosition(int width, int height, int frame)
+{
+    return (ConsolePoint){1 + frame % (width - 2), 1 + (frame / (width - 2)) % (height - 3)};
+}
+
+// The drawing example's frame: copy of the canvas, border, tooltips, palette and cursor
+void bench_sceneDrawing(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    ConsoleBuffer* buffer = &console->consoleBuffer;
+
+    ConsoleBuffer_clear(buffer, 0, 0);
+    ConsoleBuffer_copyInto(buffer, canvas);
+    bench_drawChrome(buffer);
+
+    ConsolePoint cursor = bench_cursorPosition(buffer->width, buffer->height, frame);
+    ConsoleBuffer_setChar(buffer, cursor.x, cursor.y, ' ');
+    ConsoleBuffer_setBackgroundAttrib(buffer, cursor.x, cursor.y, 7);
+}
+
+// The snake example's frame: an apple, a snake of two cell wide segments and the score
+void bench_sceneSnake(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    ConsoleBuffer* buffer = &console->consoleBuffer;
+    const int columns = buffer->width / 2;
+    const int height = buffer->height;
+
+    ConsoleBuffer_clear(buffer, 0, 0);
+
+    ConsoleBuffer_drawRect(buffer, (frame * 7 % columns) * 2, frame * 3 % height, 2, 1, ' ', BACKGROUND_RED);
+
+    for (int i = 0; i < SNAKE_LENGTH; i++)
+    {
+        int position = max(frame - i, 0);
+        ConsoleBuffer_drawRect(buffer, (position % columns) * 2, (position / columns) % height, 2, 1, ' ', BACKGROUND_GREEN);
+    }
+
+    char scoreStr[20];
+    snprintf(scoreStr, sizeof(scoreStr), "%d", frame / 10);
+    ConsoleBuffer_drawText(buffer, "SCORE:", 0, 0, 15);
+    ConsoleBuffer_drawText(buffer, scoreStr, 8, 0, 15);
+}
+
+// A mostly static screen: after the first frame only a counter and the cursor change
+void bench_sceneStatus(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    ConsoleBuffer* buffer = &console->consoleBuffer;
+
+    if (frame == 0)
+    {
+        bench_sceneDrawing(console, canvas, frame);
+        return;
+    }
+
+    char counterStr[20];
+    snprintf(counterStr, sizeof(counterStr), "%8d", frame);
+    ConsoleBuffer_drawText(buffer, counterStr, buffer->width - 10, buffer->height - 1, 0x8F);
+
+    int previousX = 1 + (frame - 1) % (buffer->width - 2);
+    int cursorX = 1 + frame % (buffer->width - 2);
+    ConsoleBuffer_setBackgroundAttrib(buffer, previousX, 1, 0);
+    ConsoleBuffer_setBackgroundAttrib(buffer, cursorX, 1, 7);
+}
+
+// A log tail under a title bar: every frame the log scrolls up a line and a new one is written at the bottom
+void bench_sceneLog(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    ConsoleBuffer* buffer = &console->consoleBuffer;
+
+    if (frame == 0)
+    {
+        ConsoleBuffer_clear(buffer, ' ', 0x07);
+        ConsoleBuffer_drawRect(buffer, 0, 0, buffer->width, 1, ' ', 0x70);
+        ConsoleBuffer_drawText(buffer, "LOG", 1, 0, 0x70);
+    }
+
+    char line[64];
+    snprintf(line, sizeof(line), "%8d request served in %d ms", frame, frame * 7 % 100);
+    ConsoleBuffer_scroll(buffer, 0, 1, buffer->width, buffer->height - 1, -1, ' ', 0x07);
+    ConsoleBuffer_drawText(buffer, line, 0, buffer->height - 1, (frame % 10 == 0) ? 0x0C : 0x07);
+}
+
+// A plot panel: a framed inner area with a thousand segments that partly run outside it
+void bench_scenePlot(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    ConsoleBuffer* buffer = &console->consoleBuffer;
+    const int width = buffer->width;
+    const int height = buffer->height;
+
+    ConsoleBuffer_clear(buffer, ' ', 0);
+    ConsoleBuffer_drawRect(buffer, 1, 1, width - 2, height - 2, ' ', BACKGROUND_BLUE);
+
+    ConsoleBuffer_pushClip(buffer, 2, 2, width - 4, height - 4);
+    for (int i = 0; i < 1000; i++)
+    {
+        int x1 = (i * 37 + frame) % (width + 20) - 10;
+        int y1 = (i * 11) % (height + 10) - 5;
+        int x2 = x1 + (i * 13 + frame) % 41 - 20;
+        int y2 = y1 + (i * 7) % 21 - 10;
+        ConsoleBuffer_drawLine(buffer, x1, y1, x2, y2, '*', FOREGROUND_GREEN | FOREGROUND_INTENSITY | BACKGROUND_BLUE);
+    }
+    ConsoleBuffer_popClip(buffer);
+}
+
+#define PANEL_COUNT 40
+
+// Overlapping windows of a UI layer, each with a frame, a title and rows of text, cascading over a full screen desktop
+void bench_drawPanels(ConsoleBuffer* buffer, ConsoleDrawList* drawList, int frame)
+{
+    const int width = buffer->width;
+    const int height = buffer->height;
+
+    for (int i = 0; i < PANEL_COUNT; i++)
+    {
+        int panelWidth = max(width - 2 * PANEL_COUNT + i, 8);
+        int panelHeight = max(height - PANEL_COUNT / 2 + i / 4, 6);
+        int x = (i * 2 + frame) % max(width - panelWidth + 1, 1);
+        int y = (i / 2) % max(height - panelHeight + 1, 1);
+        WORD attrib = (i % 7 + 1) << 4 | 15;
+
+        if (drawList)
+        {
+            ConsoleDrawList_drawRect(drawList, x, y, panelWidth, panelHeight, ' ', attrib);
+            ConsoleDrawList_drawRect(drawList, x, y, panelWidth, 1, ' ', 0x70);
+            ConsoleDrawList_pushClip(drawList, x + 1, y + 1, panelWidth - 2, panelHeight - 2);
+            ConsoleDrawList_drawText(drawList, "Panel", x + 1, y, 0x70);
+            for (int row = 1; row < panelHeight - 1; row++)
+            {
+                ConsoleDrawList_drawText(drawList, "lorem ipsum dolor sit amet consectetur", x + 1, y + row, attrib);
+            }
+            ConsoleDrawList_popClip(drawList);
+        }
+        else
+        {
+            ConsoleBuffer_drawRect(buffer, x, y, panelWidth, panelHeight, ' ', attrib);
+            ConsoleBuffer_drawRect(buffer, x, y, panelWidth, 1, ' ', 0x70);
+            ConsoleBuffer_pushClip(buffer, x + 1, y + 1, panelWidth - 2, panelHeight - 2);
+            ConsoleBuffer_drawText(buffer, "Panel", x + 1, y, 0x70);
+            for (int row = 1; row < panelHeight - 1; row++)
+            {
+                ConsoleBuffer_drawText(buffer, "lorem ipsum dolor sit amet consectetur", x + 1, y + row, attrib);
+            }
+            ConsoleBuffer_popClip(buffer);
+        }
+    }
+}
+
+void bench_scenePanels(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    bench_drawPanels(&console->consoleBuffer, NULL, frame);
+}
+
+// The same panels recorded into a draw list, so the hidden ones are culled before rasterizing
+void bench_scenePanelsList(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    static ConsoleDrawList drawList;
+    static char created = 0;
+    if (!created)
+    {
+        drawList = ConsoleDrawList_create();
+        created = 1;
+    }
+
+    ConsoleDrawList_reset(&drawList);
+    bench_drawPanels(&console->consoleBuffer, &drawList, frame);
+    ConsoleDrawList_submit(&drawList, &console->consoleBuffer);
+}
+
+// Worst case: every cell changes every frame
+void bench_sceneFullRedraw(Console* console, ConsoleBuffer* canvas, int frame)
+{
+    ConsoleBuffer* buffer = &console->consoleBuffer;
+
+    for (int y = 0; y < buffer->height; y++)
+    {
+        for (int x = 0; x < buffer->width; x++)
+        {
+            ConsoleBuffer_setChar(buffer, x, y, 'a' + (x + y + frame) % 26);
+            ConsoleBuffer_setAttrib(buffer, x, y, (x + frame) & 0xFF);
+        }
+    }
+}
+
+void bench_run(const char* name, BenchScene scene, BenchSize size, int frames)
+{
+    BenchTimes times = {0};
+
+    Console console = Console_createHeadless(size.width, size.height, bench_countBytes, &times);
+    ConsoleBuffer_setDirtyTracking(&console.consoleBuffer, 1);
+    ConsoleBuffer canvas = ConsoleBuffer_create(size.width, size.height);
+    bench_initCanvas(&canvas);
+
+    // Warm up, so the first full frame is not counted
+    scene(&console, &canvas, 0);
+    Console_display(&console);
+    times.bytes = 0;
+
+    for (int frame = 1; frame <= frames; frame++)
+    {
+        double start = Console_getTime();
+        scene(&console, &canvas, frame);
+        double drawn = Console_getTime();
+        Console_display(&console);
+        double displayed = Console_getTime();
+
+        times.drawSeconds += drawn - start;
+        times.displaySeconds += displayed - drawn;
+    }
+
+    double totalSeconds = times.drawSeconds + times.displaySeconds;
+    double cells = (double)size.width * size.height * frames;
+
+    printf("%-8s %5dx%-4d %10.1f %10.2f %10.2f %10.2f %12.1f\n", name, size.width, size.height,
+        frames / totalSeconds, totalSeconds * 1e9 / cells, times.drawSeconds * 1e9 / cells,
+        times.displaySeconds * 1e9 / cells, (double)times.bytes / frames);
+
+    ConsoleBuffer_destroy(&canvas);
+    Console_destroy(&console);
+}
+
+// Runs a scene on two consoles, one with a recorder attached, reporting the time recording adds and the file size per frame.
+// The consoles take turns drawing each frame so both see the same machine state, and the best of a few rounds is kept
+void bench_recording(const char* name, BenchScene scene, BenchSize size, int frames)
+{
+    const char* path = "benchmark.rec";
+    double seconds[2] = {1e30, 1e30};
+    long fileSize = 0;
+
+    for (int round = 0; round < 3; round++)
+    {
+        BenchTimes times[2] = {0};
+        Console consoles[2];
+        ConsoleBuffer canvases[2];
+        double elapsed[2] = {0, 0};
+
+        for (int i = 0; i < 2; i++)
+        {
+            consoles[i] = Console_createHeadless(size.width, size.height, bench_countBytes, &times[i]);
+            ConsoleBuffer_setDirtyTracking(&consoles[i].consoleBuffer, 1);
+            canvases[i] = ConsoleBuffer_create(size.width, size.height);
+            bench_initCanvas(&canvases[i]);
+        }
+
+        ConsoleRecorder recorder = ConsoleRecorder_create(path, size.width, size.height);
+        ConsoleRecorder_attach(&recorder, &consoles[1]);
+
+        // Warm up, so the first full frame and the recorder's first keyframe are not counted
+        for (int i = 0; i < 2; i++)
+        {
+            scene(&consoles[i], &canvases[i], 0);
+            Console_display(&consoles[i]);
+        }
+
+        for (int frame = 1; frame <= frames; frame++)
+        {
+            for (int turn = 0; turn < 2; turn++)
+            {
+                // Alternate which goes first, so neither always runs on the other's warm cache
+                const int i = turn ^ (frame & 1);
+
+                double start = Console_getTime();
+                scene(&consoles[i], &canvases[i], frame);
+                Console_display(&consoles[i]);
+                elapsed[i] += Console_getTime() - start;
+            }
+        }
+
+        for (int i = 0; i < 2; i++)
+        {
+            seconds[i] = min(seconds[i], elapsed[i]);
+        }
+
+        ConsoleRecorder_detach(&recorder, &consoles[1]);
+        ConsoleRecorder_destroy(&recorder);
+
+        FILE* file = fopen(path, "rb");
+        fseek(file, 0, SEEK_END);
+        fileSize = ftell(file);
+        fclose(file);
+        remove(path);
+
+        for (int i = 0; i < 2; i++)
+        {
+            ConsoleBuffer_destroy(&canvases[i]);
+            Console_destroy(&consoles[i]);
+        }
+    }
+
+    printf("%-8s %5dx%-4d %10.3f %10.3f %9.1f%% %12.1f\n", name, size.width, size.height, seconds[0] * 1e3 / frames,
+        seconds[1] * 1e3 / frames, (seconds[1] / seconds[0] - 1) * 100, (double)fileSize / (frames + 1));
+}
+
+// The drawing scene composed by hand every frame against the same screen kept as layers: the canvas, the chrome keyed over
+// it and a one cell cursor layer. Only the cursor moves, so the compositor recomposes the tiles it left and entered
+void bench_layers(BenchSize size, int frames)
+{
+    const ConsoleCell transparentCell = CONSOLE_CELL(0, 0xFF);
+    BenchTimes times = {0};
+
+    Console console = Console_createHeadless(size.width, size.height, bench_countBytes, &times);
+    ConsoleBuffer_setDirtyTracking(&console.consoleBuffer, 1);
+    ConsoleBuffer canvas = ConsoleBuffer_create(size.width, size.height);
+    bench_initCanvas(&canvas);
+
+    double start = Console_getTime();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        bench_sceneDrawing(&console, &canvas, frame);
+        Console_display(&console);
+    }
+    double byHand = Console_getTime() - start;
+
+    ConsoleBuffer chrome = ConsoleBuffer_create(size.width, size.height);
+    ConsoleBuffer cursor = ConsoleBuffer_create(1, 1);
+    ConsoleBuffer_clear(&chrome, CONSOLE_CELL_CHAR(transparentCell), CONSOLE_CELL_ATTRIB(transparentCell));
+    bench_drawChrome(&chrome);
+    ConsoleBuffer_clear(&cursor, ' ', 7 << 4);
+
+    ConsoleCompositor compositor = ConsoleCompositor_create(size.width, size.height, CONSOLE_CELL(0, 0));
+    ConsoleCompositor_addLayer(&compositor, &canvas, 0, 0);
+    int chromeLayer = ConsoleCompositor_addLayer(&compositor, &chrome, 0, 0);
+    int cursorLayer = ConsoleCompositor_addLayer(&compositor, &cursor, 0, 0);
+    ConsoleCompositor_setLayerTransparency(&compositor, chromeLayer, 1, transparentCell);
+
+    int tiles = 0;
+    start = Console_getTime();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        ConsolePoint position = bench_cursorPosition(size.width, size.height, frame);
+        ConsoleCompositor_setLayerPosition(&compositor, cursorLayer, position.x, position.y);
+        ConsoleCompositor_display(&compositor, &console);
+        if (frame > 0) tiles += ConsoleCompositor_getStats(&compositor).tiles;
+    }
+    double composed = Console_getTime() - start;
+
+    printf("%-8s %5dx%-4d %10.3f %10.3f %10.1f %12.1f\n", "layers", size.width, size.height, byHand * 1e3 / frames,
+        composed * 1e3 / frames, byHand / composed, (double)tiles / max(frames - 1, 1));
+
+    ConsoleCompositor_destroy(&compositor);
+    ConsoleBuffer_destroy(&cursor);
+    ConsoleBuffer_destroy(&chrome);
+    ConsoleBuffer_destroy(&canvas);
+    Console_destroy(&console);
+}
+
+// Times the bulk buffer operations on their own, reporting throughput over the cells written
+void bench_kernels(int frames)
+{
+    const int width = 4096;
+    const int height = 64;
+    const double bytes = (double)width * height * sizeof(ConsoleCell) * frames;
+
+    ConsoleBuffer target = ConsoleBuffer_create(width, height);
+    ConsoleBuffer source = ConsoleBuffer_create(width, height);
+    for (int i = 0; i < width * height; i++)
+    {
+        source._cells[i] = (i % 3) ? CONSOLE_CELL('#', i & 0xFF) : CONSOLE_CELL(' ', 0);
+    }
+
+    double start = Console_getTime();
+    for (int frame = 0; frame < frames; frame++) ConsoleBuffer_clear(&target, '.', 0x1E);
+    double cleared = Console_getTime();
+    for (int frame = 0; frame < frames; frame++) ConsoleBuffer_drawRect(&target, 0, 0, width, height, '#', 0x2F);
+    double filled = Console_getTime();
+    for (int frame = 0; frame < frames; frame++) ConsoleBuffer_blit(&target, &source, 0, 0, 0, 0, width, height);
+    double copied = Console_getTime();
+    for (int frame = 0; frame < frames; frame++) ConsoleBuffer_blitMasked(&target, &source, 0, 0, 0, 0, width, height, CONSOLE_CELL(' ', 0));
+    double masked = Console_getTime();
+
+    printf("\n%-12s %10s\n", "kernel", "GB/s");
+    printf("%-12s %10.2f\n", "clear", bytes / (cleared - start) * 1e-9);
+    printf("%-12s %10.2f\n", "drawRect", bytes / (filled - cleared) * 1e-9);
+    printf("%-12s %10.2f\n", "blit", bytes / (copied - filled) * 1e-9);
+    printf("%-12s %10.2f\n", "blitMasked", bytes / (masked - copied) * 1e-9);
+
+    ConsoleBuffer_destroy(&source);
+    ConsoleBuffer_destroy(&target);
+}
+
+// Blits a few hundred 32x16 sprites per frame, as sprites and as masked blits of their source: an ellipse outline with
+// long transparent gaps, a filled ellipse, and noise at half coverage as the worst case for runs
+void bench_sprites(int frames)
+{
+    const int width = 320;
+    const int height = 100;
+    const int spriteCount = 400;
+    const char* shapes[] = {"ring", "disc", "noise"};
+    const ConsoleCell transparentCell = CONSOLE_CELL(' ', 0);
+
+    ConsoleBuffer target = ConsoleBuffer_create(width, height);
+    ConsoleBuffer_setDirtyTracking(&target, 1);
+
+    printf("\n%-12s %10s %12s %12s %12s\n", "sprites", "opaque", "ns/sprite", "ns/opaque", "masked ns");
+
+    for (int i = 0; i < (int)(sizeof(shapes) / sizeof(shapes[0])); i++)
+    {
+        ConsoleBuffer source = ConsoleBuffer_create(32, 16);
+        ConsoleBuffer_clear(&source, ' ', 0);
+        if (i == 0) ConsoleBuffer_drawEllipse(&source, 15, 7, 15, 7, '@', 0x0A);
+        if (i == 1) ConsoleBuffer_fillEllipse(&source, 15, 7, 15, 7, '@', 0x0A);
+        if (i == 2)
+        {
+            srand(3);
+            for (int j = 0; j < 32 * 16; j++)
+            {
+                if (rand() % 2) source._cells[j] = CONSOLE_CELL('@', 0x0A + j % 5);
+            }
+        }
+
+        ConsoleSprite sprite = ConsoleSprite_create(&source, 0, 0, 32, 16, transparentCell);
+
+        double start = Console_getTime();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int j = 0; j < spriteCount; j++)
+            {
+                ConsoleBuffer_blitSprite(&target, &sprite, (j * 37 + frame) % (width + 32) - 32, (j * 11) % (height + 16) - 16);
+            }
+        }
+        double blitted = Console_getTime();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int j = 0; j < spriteCount; j++)
+            {
+                ConsoleBuffer_blitMasked(&target, &source, (j * 37 + frame) % (width + 32) - 32, (j * 11) % (height + 16) - 16, 0, 0, 32, 16, transparentCell);
+            }
+        }
+        double masked = Console_getTime();
+
+        const double blits = (double)frames * spriteCount;
+        const int opaque = ConsoleSprite_getOpaqueCount(&sprite);
+        printf("%-12s %10d %12.1f %12.2f %12.1f\n", shapes[i], opaque, (blitted - start) / blits * 1e9,
+            (blitted - start) / (blits * opaque) * 1e9, (masked - blitted) / blits * 1e9);
+
+        ConsoleSprite_destroy(&sprite);
+        ConsoleBuffer_destroy(&source);
+    }
+
+    ConsoleBuffer_destroy(&target);
+}
+
+// Draws a scrolling 640x400 image into 200x100 cells every frame, in colour and in grey, and displays it in 24-bit colour
+void bench_images(int frames)
+{
+    const int cellWidth = 200;
+    const int cellHeight = 100;
+    const int imageWidth = 640;
+    const int imageHeight = 400;
+    const char* names[] = {"rgb", "grey"};
+
+    printf("\n%-12s %10s %10s %10s %12s\n", "image", "source", "draw ms", "display ms", "bytes/frame");
+
+    for (int i = 0; i < 2; i++)
+    {
+        const ConsoleImageFormat format = i == 0 ? CONSOLE_IMAGE_RGB : CONSOLE_IMAGE_GREY;
+        const int channels = format == CONSOLE_IMAGE_RGB ? 3 : 1;
+
+        // Twice as wide so each frame can show a different window of it
+        const int stride = 2 * imageWidth * channels;
+        uint8_t* pixels = malloc((size_t)stride * imageHeight);
+        for (int y = 0; y < imageHeight; y++)
+        {
+            for (int x = 0; x < stride; x++)
+            {
+                pixels[y * stride + x] = (uint8_t)((x / channels) * (x % channels + 1) + y * 3);
+            }
+        }
+
+        BenchTimes times = {0, 0, 0};
+        Console console = Console_createHeadless(cellWidth, cellHeight, bench_countBytes, &times);
+        ConsoleBuffer_setColourPlanes(&console.consoleBuffer, 1);
+        ConsoleArena scratch = ConsoleArena_create(64 * 1024);
+        times.bytes = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            ConsoleImage image = {&pixels[(frame % imageWidth) * channels], imageWidth, imageHeight, stride, format};
+
+            double start = Console_getTime();
+            ConsoleArena_reset(&scratch);
+            ConsoleBuffer_drawImage(&console.consoleBuffer, 0, 0, cellWidth, cellHeight, &image, &scratch);
+            double drawn = Console_getTime();
+            Console_display(&console);
+            double displayed = Console_getTime();
+
+            times.drawSeconds += drawn - start;
+            times.displaySeconds += displayed - drawn;
+        }
+
+        printf("%-12s %5dx%-4d %10.3f %10.3f %12.1f\n", names[i], imageWidth, imageHeight, times.drawSeconds * 1e3 / frames,
+            times.displaySeconds * 1e3 / frames, (double)times.bytes / frames);
+
+        ConsoleArena_destroy(&scratch);
+        Console_destroy(&console);
+        free(pixels);
+    }
+}
+
+// Rasterizes a fill heavy draw list into a large virtual buffer with pools of increasing width
+void bench_scaling(int frames)
+{
+    const int width = 4096;
+    const int height = 1024;
+    const int poolWidths[] = {1, 2, 4, 8};
+    const int poolCount = sizeof(poolWidths) / sizeof(poolWidths[0]);
+    frames = max(frames / 10, 1);
+
+    ConsoleBuffer buffer = ConsoleBuffer_create(width, height);
+    ConsoleBuffer_setDirtyTracking(&buffer, 1);
+
+    // Overlapping but never fully covered rects, so culling leaves the fills to the rasterizer
+    ConsoleDrawList drawList = ConsoleDrawList_create();
+    srand(2);
+    for (int i = 0; i < 2000; i++)
+    {
+        int x = rand() % width;
+        int y = rand() % height;
+        ConsoleDrawList_drawRect(&drawList, x, y, 64 + rand() % 512, 16 + rand() % 128, '#', rand() & 0xFF);
+        ConsoleDrawList_drawLine(&drawList, x, y, rand() % width, rand() % height, '*', 0x0E);
+    }
+
+    printf("\n%-12s %10s %10s\n", "threads", "ms/frame", "speedup");
+
+    double baseSeconds = 0;
+    for (int i = 0; i < poolCount; i++)
+    {
+        ConsoleWorkerPool pool = ConsoleWorkerPool_create(poolWidths[i] - 1);
+
+        double start = Console_getTime();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            ConsoleDrawList_submitParallel(&drawList, &buffer, &pool);
+        }
+        double seconds = (Console_getTime() - start) / frames;
+        if (i == 0) baseSeconds = seconds;
+
+        printf("%-12d %10.2f %10.2f\n", ConsoleWorkerPool_getWidth(&pool), seconds * 1e3, baseSeconds / seconds);
+
+        ConsoleWorkerPool_destroy(&pool);
+    }
+
+    ConsoleDrawList_destroy(&drawList);
+    ConsoleBuffer_destroy(&buffer);
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = 500;
+    if (argc > 1) frames = atoi(argv[1]);
+
+    const BenchSize sizes[] = {{80, 40}, {160, 50}, {320, 100}, {1280, 400}};
+    const int sizeCount = sizeof(sizes) / sizeof(sizes[0]);
+
+    printf("%-8s %10s %10s %10s %10s %10s %12s\n", "scene", "size", "frames/s", "ns/cell", "draw", "display", "bytes/frame");
+
+    for (int i = 0; i < sizeCount; i++)
+    {
+        bench_run("drawing", bench_sceneDrawing, sizes[i], frames);
+        bench_run("snake", bench_sceneSnake, sizes[i], frames);
+        bench_run("status", bench_sceneStatus, sizes[i], frames);
+        bench_run("log", bench_sceneLog, sizes[i], frames);
+        bench_run("plot", bench_scenePlot, sizes[i], frames);
+        bench_run("panels", bench_scenePanels, sizes[i], frames);
+        bench_run("panelsDL", bench_scenePanelsList, sizes[i], frames);
+        bench_run("full", bench_sceneFullRedraw, sizes[i], frames);
+    }
+
+    printf("\n%-8s %10s %10s %10s %10s %12s\n", "record", "size", "ms/frame", "recorded", "overhead", "file/frame");
+    for (int i = 0; i < sizeCount; i++)
+    {
+        bench_recording("snake", bench_sceneSnake, sizes[i], frames);
+        bench_recording("status", bench_sceneStatus, sizes[i], frames);
+        bench_recording("panels", bench_scenePanels, sizes[i], frames);
+        bench_recording("full", bench_sceneFullRedraw, sizes[i], frames);
+    }
+
+    printf("\n%-8s %10s %10s %10s %10s %12s\n", "compose", "size", "hand ms", "layers ms", "speedup", "tiles/frame");
+    for (int i = 0; i < sizeCount; i++)
+    {
+        bench_layers(sizes[i], frames);
+    }
+
+    bench_kernels(frames);
+    bench_sprites(frames);
+    bench_images(frames);
+    bench_scaling(frames);
+
+    return 0;
+}
@@ -1,14 +1,478 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "console.h"
+#include "console_thread.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#endif
+
+//
+// --- Profiling hooks, compiled away unless CONSOLE_PROFILE is defined
+//
+
+#ifdef CONSOLE_PROFILE
+// Library allocations on every thread, frames take the difference over their span
+static ConsoleAtomicInt Console_profileAllocations;
+
+static void Console_initProfile(Console* console);
+
+#define CONSOLE_PROFILE_BEGIN() const double profileStart = Console_getTime()
+#define CONSOLE_PROFILE_END(console, phase) ((console)->_profile._phaseSeconds[phase] += Console_getTime() - profileStart)
+#define CONSOLE_PROFILE_COUNT(console, counter, n) ((console)->_profile._counters.counter += (n))
+#define CONSOLE_PROFILE_INIT(console) Console_initProfile(console)
+#else
+#define CONSOLE_PROFILE_BEGIN() ((void)0)
+#define CONSOLE_PROFILE_END(console, phase) ((void)0)
+#define CONSOLE_PROFILE_COUNT(console, counter, n) ((void)0)
+#define CONSOLE_PROFILE_INIT(console) ((void)0)
+#endif
+
+//
+// --- Bulk cell kernels, picked at runtime from the best instruction set the CPU supports
+//
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CONSOLE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(CONSOLE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CONSOLE_TARGET_SSE2 __attribute__((target("sse2")))
+#define CONSOLE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CONSOLE_TARGET_SSE2
+#define CONSOLE_TARGET_AVX2
+#endif
+
+typedef void (*ConsoleFillFunc)(ConsoleCell* cells, ConsoleCell cell, size_t count);
+typedef void (*ConsoleMaskedCopyFunc)(ConsoleCell* cells, const ConsoleCell* source, size_t count, ConsoleCell transparentCell);
+typedef void (*ConsoleRowSumFunc)(uint32_t* sums, const uint8_t* row, size_t count);
+
+static void Console_fillCellsScalar(ConsoleCell* cells, ConsoleCell cell, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        cells[i] = cell;
+    }
+}
+
+static void Console_copyCellsMaskedScalar(ConsoleCell* cells, const ConsoleCell* source, size_t count, ConsoleCell transparentCell)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (source[i] != transparentCell) cells[i] = source[i];
+    }
+}
+
+static void Console_sumRowScalar(uint32_t* sums, const uint8_t* row, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        sums[i] += row[i];
+    }
+}
+
+#ifdef CONSOLE_X86
+CONSOLE_TARGET_SSE2 static void Console_fillCellsSSE2(ConsoleCell* cells, ConsoleCell cell, size_t count)
+{
+    const __m128i pattern = _mm_set1_epi16((short)cell);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm_storeu_si128((__m128i*)&cells[i], pattern);
+        _mm_storeu_si128((__m128i*)&cells[i + 8], pattern);
+    }
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm_storeu_si128((__m128i*)&cells[i], pattern);
+    }
+
+    Console_fillCellsScalar(&cells[i], cell, count - i);
+}
+
+CONSOLE_TARGET_SSE2 static void Console_copyCellsMaskedSSE2(ConsoleCell* cells, const ConsoleCell* source, size_t count, ConsoleCell transparentCell)
+{
+    const __m128i key = _mm_set1_epi16((short)transparentCell);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i sourceCells = _mm_loadu_si128((const __m128i*)&source[i]);
+        __m128i destCells = _mm_loadu_si128((const __m128i*)&cells[i]);
+        __m128i transparent = _mm_cmpeq_epi16(sourceCells, key);
+        __m128i result = _mm_or_si128(_mm_and_si128(transparent, destCells), _mm_andnot_si128(transparent, sourceCells));
+        _mm_storeu_si128((__m128i*)&cells[i], result);
+    }
+
+    Console_copyCellsMaskedScalar(&cells[i], &source[i], count - i, transparentCell);
+}
+
+CONSOLE_TARGET_SSE2 static void Console_sumRowSSE2(uint32_t* sums, const uint8_t* row, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)&row[i]);
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        __m128i* out = (__m128i*)&sums[i];
+
+        _mm_storeu_si128(&out[0], _mm_add_epi32(_mm_loadu_si128(&out[0]), _mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_si128(&out[1], _mm_add_epi32(_mm_loadu_si128(&out[1]), _mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_si128(&out[2], _mm_add_epi32(_mm_loadu_si128(&out[2]), _mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_si128(&out[3], _mm_add_epi32(_mm_loadu_si128(&out[3]), _mm_unpackhi_epi16(high, zero)));
+    }
+
+    Console_sumRowScalar(&sums[i], &row[i], count - i);
+}
+
+CONSOLE_TARGET_AVX2 static void Console_fillCellsAVX2(ConsoleCell* cells, ConsoleCell cell, size_t count)
+{
+    const __m256i pattern = _mm256_set1_epi16((short)cell);
+    size_t i = 0;
+
+    for (; i + 64 <= count; i += 64)
+    {
+        _mm256_storeu_si256((__m256i*)&cells[i], pattern);
+        _mm256_storeu_si256((__m256i*)&cells[i + 16], pattern);
+        _mm256_storeu_si256((__m256i*)&cells[i + 32], pattern);
+        _mm256_storeu_si256((__m256i*)&cells[i + 48], pattern);
+    }
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm256_storeu_si256((__m256i*)&cells[i], pattern);
+    }
+
+    Console_fillCellsScalar(&cells[i], cell, count - i);
+}
+
+CONSOLE_TARGET_AVX2 static void Console_copyCellsMaskedAVX2(ConsoleCell* cells, const ConsoleCell* source, size_t count, ConsoleCell transparentCell)
+{
+    const __m256i key = _mm256_set1_epi16((short)transparentCell);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i sourceCells = _mm256_loadu_si256((const __m256i*)&source[i]);
+        __m256i destCells = _mm256_loadu_si256((const __m256i*)&cells[i]);
+        __m256i transparent = _mm256_cmpeq_epi16(sourceCells, key);
+        _mm256_storeu_si256((__m256i*)&cells[i], _mm256_blendv_epi8(sourceCells, destCells, transparent));
+    }
+
+    Console_copyCellsMaskedScalar(&cells[i], &source[i], count - i, transparentCell);
+}
+
+CONSOLE_TARGET_AVX2 static void Console_sumRowAVX2(uint32_t* sums, const uint8_t* row, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i widened = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&row[i]));
+        __m256i* out = (__m256i*)&sums[i];
+        _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), widened));
+    }
+
+    Console_sumRowScalar(&sums[i], &row[i], count - i);
+}
+
+static int Console_cpuHasAVX2(void)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    int osSavesAVX = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    if (!osSavesAVX) return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static int Console_cpuHasSSE2(void)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif
+
+// Picked once by the first ConsoleBuffer_create. The kernels only work on buffers, so by the time draw lists fill them
+// from several threads the pointers are only read
+static ConsoleFillFunc Console_fillCells = Console_fillCellsScalar;
+static ConsoleMaskedCopyFunc Console_copyCellsMasked = Console_copyCellsMaskedScalar;
+
+// Adds each byte of a row to its sum, for box filtering images
+static ConsoleRowSumFunc Console_sumRow = Console_sumRowScalar;
+
+static ConsoleAtomicInt Console_kernelsSelected;
+
+static void Console_selectKernels(void)
+{
+    if (ConsoleAtomic_load(&Console_kernelsSelected)) return;
+
+    ConsoleFillFunc fill = Console_fillCellsScalar;
+    ConsoleMaskedCopyFunc copyMasked = Console_copyCellsMaskedScalar;
+    ConsoleRowSumFunc sumRow = Console_sumRowScalar;
+
+#ifdef CONSOLE_X86
+    if (Console_cpuHasAVX2())
+    {
+        fill = Console_fillCellsAVX2;
+        copyMasked = Console_copyCellsMaskedAVX2;
+        sumRow = Console_sumRowAVX2;
+    }
+    else if (Console_cpuHasSSE2())
+    {
+        fill = Console_fillCellsSSE2;
+        copyMasked = Console_copyCellsMaskedSSE2;
+        sumRow = Console_sumRowSSE2;
+    }
+#endif
+
+    Console_fillCells = fill;
+    Console_copyCellsMasked = copyMasked;
+    Console_sumRow = sumRow;
+    ConsoleAtomic_store(&Console_kernelsSelected, 1);
+}
+
+//
+// --- Scratch arena
+//
+
+#define CONSOLE_ARENA_ALIGN 16
+
+struct ConsoleArenaBlock
+{
+    ConsoleArenaBlock* next;
+    size_t capacity;
+    size_t used;
+};
+
+static size_t Console_alignSize(size_t size)
+{
+    return (size + CONSOLE_ARENA_ALIGN - 1) & ~(size_t)(CONSOLE_ARENA_ALIGN - 1);
+}
+
+static ConsoleArenaBlock* ConsoleArena_newBlock(size_t capacity, ConsoleArenaBlock* next)
+{
+    ConsoleArenaBlock* block = malloc(Console_alignSize(sizeof(ConsoleArenaBlock)) + capacity);
+    CONSOLE_PROFILE_ALLOCATION();
+    block->next = next;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+ConsoleArena ConsoleArena_create(size_t capacity)
+{
+    ConsoleArena arena;
+    arena._capacity = Console_alignSize(max(capacity, (size_t)CONSOLE_ARENA_ALIGN));
+    arena._blocks = ConsoleArena_newBlock(arena._capacity, NULL);
+    return arena;
+}
+
+void* ConsoleArena_alloc(ConsoleArena* arena, size_t size)
+{
+    size = Console_alignSize(max(size, (size_t)1));
+
+    ConsoleArenaBlock* block = arena->_blocks;
+    if (block->used + size > block->capacity)
+    {
+        // Each new block at least doubles the arena, so a reset can fold them into one
+        size_t capacity = max(arena->_capacity, size);
+        block = ConsoleArena_newBlock(capacity, block);
+        arena->_blocks = block;
+        arena->_capacity += capacity;
+    }
+
+    void* memory = (char*)block + Console_alignSize(sizeof(ConsoleArenaBlock)) + block->used;
+    block->used += size;
+    return memory;
+}
+
+void ConsoleArena_reset(ConsoleArena* arena)
+{
+    ConsoleArenaBlock* block = arena->_blocks;
+    if (block->next)
+    {
+        while (block)
+        {
+            ConsoleArenaBlock* next = block->next;
+            free(block);
+            block = next;
+        }
+
+        arena->_blocks = ConsoleArena_newBlock(arena->_capacity, NULL);
+        return;
+    }
+
+    block->used = 0;
+}
+
+void ConsoleArena_destroy(ConsoleArena* arena)
+{
+    ConsoleArenaBlock* block = arena->_blocks;
+    while (block)
+    {
+        ConsoleArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->_blocks = NULL;
+    arena->_capacity = 0;
+}
+
+//
+// --- Colour quantization
+//
+
+// Colours as sent to the terminal, and as front buffers store them: attribute colours as 0-15, palette entries as
+// CONSOLE_CODE_PALETTE | index and 24-bit colours as CONSOLE_CODE_RGB | colour
+#define CONSOLE_CODE_PALETTE 0x100
+#define CONSOLE_CODE_RGB 0x1000000
+
+// Colours are looked up by the top 5 bits of each channel
+#define CONSOLE_QUANTIZE_SIZE (1 << 15)
+
+// Attribute colours as the Windows console shows them by default, indexed by the blue, green, red and intensity bits
+static const uint8_t CONSOLE_ATTRIB_RGB[16][3] = {
+    {0, 0, 0}, {0, 0, 128}, {0, 128, 0}, {0, 128, 128}, {128, 0, 0}, {128, 0, 128}, {128, 128, 0}, {192, 192, 192},
+    {128, 128, 128}, {0, 0, 255}, {0, 255, 0}, {0, 255, 255}, {255, 0, 0}, {255, 0, 255}, {255, 255, 0}, {255, 255, 255},
+};
+
+static const uint8_t CONSOLE_CUBE_LEVELS[6] = {0, 95, 135, 175, 215, 255};
+
+static uint8_t Console_paletteTable[CONSOLE_QUANTIZE_SIZE];
+static uint8_t Console_attribTable[CONSOLE_QUANTIZE_SIZE];
+static char Console_colourTablesBuilt;
+
+static int Console_colourDistance(int r, int g, int b, int r2, int g2, int b2)
+{
+    // Weighted towards green, which the eye is most sensitive to
+    return 2 * (r - r2) * (r - r2) + 4 * (g - g2) * (g - g2) + 3 * (b - b2) * (b - b2);
+}
+
+// Index of the closest of CONSOLE_CUBE_LEVELS, which are 40 apart from 95 up
+static int Console_nearestCubeLevel(int value)
+{
+    if (value < 48) return 0;
+    if (value < 115) return 1;
+    return (value - 35) / 40;
+}
+
+// Fills the tables taking each quantized colour to its closest 256 colour palette entry and attribute colour, so
+// presenting a colour is a lookup. Palette entries 0-15 are left out as terminals theme them
+static void Console_buildColourTables(void)
+{
+    if (Console_colourTablesBuilt) return;
+
+    for (int index = 0; index < CONSOLE_QUANTIZE_SIZE; index++)
+    {
+        const int r = ((index >> 10) & 31) * 255 / 31;
+        const int g = ((index >> 5) & 31) * 255 / 31;
+        const int b = (index & 31) * 255 / 31;
+
+        const int cubeR = Console_nearestCubeLevel(r);
+        const int cubeG = Console_nearestCubeLevel(g);
+        const int cubeB = Console_nearestCubeLevel(b);
+        int best = 16 + 36 * cubeR + 6 * cubeG + cubeB;
+        int bestDistance = Console_colourDistance(r, g, b, CONSOLE_CUBE_LEVELS[cubeR], CONSOLE_CUBE_LEVELS[cubeG], CONSOLE_CUBE_LEVELS[cubeB]);
+
+        // The grey ramp, entries 232-255, runs from 8 to 238 in steps of 10
+        const int grey = min(max(((r + g + b) / 3 - 3) / 10, 0), 23);
+        const int greyValue = 8 + 10 * grey;
+        if (Console_colourDistance(r, g, b, greyValue, greyValue, greyValue) < bestDistance) best = 232 + grey;
+        Console_paletteTable[index] = (uint8_t)best;
+
+        best = 0;
+        for (int attrib = 0; attrib < 16; attrib++)
+        {
+            const uint8_t* rgb = CONSOLE_ATTRIB_RGB[attrib];
+            int distance = Console_colourDistance(r, g, b, rgb[0], rgb[1], rgb[2]);
+            if (attrib == 0 || distance < bestDistance)
+            {
+                best = attrib;
+                bestDistance = distance;
+            }
+        }
+        Console_attribTable[index] = (uint8_t)best;
+    }
+
+    Console_colourTablesBuilt = 1;
+}
+
+// Index of a colour in the lookup tables
+static int Console_colourIndex(ConsoleColour colour)
+{
+    return ((colour >> 9) & 0x7C00) | ((colour >> 6) & 0x3E0) | ((colour >> 3) & 0x1F);
+}
+
+static int Console_quantizeColour(ConsoleColourMode mode, ConsoleColour colour)
+{
+    if (mode == CONSOLE_COLOUR_MODE_RGB) return CONSOLE_CODE_RGB | (int)(colour & 0xFFFFFF);
+
+    const int index = Console_colourIndex(colour);
+    if (mode == CONSOLE_COLOUR_MODE_256) return CONSOLE_CODE_PALETTE | Console_paletteTable[index];
+    return Console_attribTable[index];
+}
+
+static void Console_fillColours(ConsoleColour* colours, ConsoleColour colour, size_t count)
+{
+    for (size_t i = 0; i < count; i++) colours[i] = colour;
+}
+
+//
+// --- ConsoleBuffer
+//
 
 ConsoleBuffer ConsoleBuffer_create(int width, int height)
 {
+    Console_selectKernels();
+
     ConsoleBuffer buffer;
     buffer.width = width;
     buffer.height = height;
 
-    int bufferMemSize = width * height * sizeof(CHAR_INFO);
-    buffer._buffer = malloc(bufferMemSize);
-    memset(buffer._buffer, 0, bufferMemSize);
+    int bufferMemSize = width * height * sizeof(ConsoleCell);
+    buffer._cells = malloc(bufferMemSize);
+    CONSOLE_PROFILE_ALLOCATION();
+    memset(buffer._cells, 0, bufferMemSize);
+
+    buffer._foregrounds = NULL;
+    buffer._backgrounds = NULL;
+
+    buffer._tileStamps = NULL;
+    buffer._tilesX = (width + CONSOLE_TILE_WIDTH - 1) / CONSOLE_TILE_WIDTH;
+    buffer._tilesY = (height + CONSOLE_TILE_HEIGHT - 1) / CONSOLE_TILE_HEIGHT;
+    buffer._dirtyEpoch = 1;
+
+    buffer._clip = (ConsoleRect){0, 0, width, height};
+    buffer._clipDepth = 0;
+
+    buffer._scrollRect = buffer._clip;
+    buffer._scrollDy = 0;
 
     return buffer;
 }
@@ -19,139 +483,2391 @@ ConsoleBuffer ConsoleBuffer_copy(const ConsoleBuffer* consoleBuffer)
     copy.width = consoleBuffer->width;
     copy.height = consoleBuffer->height;
 
-    int bufferSize = copy.width * copy.height * sizeof(CHAR_INFO);
-    copy._buffer = malloc(bufferSize);
-    memcpy(copy._buffer, consoleBuffer->_buffer, bufferSize);
+    int bufferSize = copy.width * copy.height * sizeof(ConsoleCell);
+    copy._cells = malloc(bufferSize);
+    CONSOLE_PROFILE_ALLOCATION();
+    memcpy(copy._cells, consoleBuffer->_cells, bufferSize);
+
+    copy._foregrounds = NULL;
+    copy._backgrounds = NULL;
+    if (consoleBuffer->_foregrounds)
+    {
+        const size_t planeSize = copy.width * copy.height * sizeof(ConsoleColour);
+        copy._foregrounds = malloc(planeSize);
+        CONSOLE_PROFILE_ALLOCATION();
+        copy._backgrounds = malloc(planeSize);
+        CONSOLE_PROFILE_ALLOCATION();
+        memcpy(copy._foregrounds, consoleBuffer->_foregrounds, planeSize);
+        memcpy(copy._backgrounds, consoleBuffer->_backgrounds, planeSize);
+    }
+
+    // Copies start without dirty tracking
+    copy._tileStamps = NULL;
+    copy._tilesX = consoleBuffer->_tilesX;
+    copy._tilesY = consoleBuffer->_tilesY;
+    copy._dirtyEpoch = 1;
+
+    copy._clip = (ConsoleRect){0, 0, copy.width, copy.height};
+    copy._clipDepth = 0;
+
+    copy._scrollRect = copy._clip;
+    copy._scrollDy = 0;
 
     return copy;
 }
 
-void ConsoleBuffer_destroy(ConsoleBuffer* consoleBuffer)
+void ConsoleBuffer_copyInto(ConsoleBuffer* consoleBuffer, const ConsoleBuffer* source)
 {
-    free(consoleBuffer->_buffer);
-    consoleBuffer->_buffer = NULL;
+    memcpy(consoleBuffer->_cells, source->_cells, consoleBuffer->width * consoleBuffer->height * sizeof(ConsoleCell));
+
+    ConsoleBuffer_setColourPlanes(consoleBuffer, source->_foregrounds != NULL);
+    if (source->_foregrounds)
+    {
+        memcpy(consoleBuffer->_foregrounds, source->_foregrounds, consoleBuffer->width * consoleBuffer->height * sizeof(ConsoleColour));
+        memcpy(consoleBuffer->_backgrounds, source->_backgrounds, consoleBuffer->width * consoleBuffer->height * sizeof(ConsoleColour));
+    }
+
+    // Everything is replaced, there is nothing left to scroll
+    consoleBuffer->_scrollDy = 0;
+    ConsoleBuffer_markDirty(consoleBuffer, 0, 0, consoleBuffer->width, consoleBuffer->height);
 }
 
-void ConsoleBuffer_setChar(ConsoleBuffer* consoleBuffer, int x, int y, char c)
+// Clips a blit to the source buffer and the target's clip rect, returning 0 if nothing is left to copy
+static int ConsoleBuffer_clipBlit(const ConsoleBuffer* consoleBuffer, const ConsoleBuffer* source, int* x, int* y, int* sourceX, int* sourceY, int* width, int* height)
 {
-    consoleBuffer->_buffer[x + y * consoleBuffer->width].Char.AsciiChar = c;
+    const ConsoleRect clip = consoleBuffer->_clip;
+    int left = max(max(clip.left - *x, -*sourceX), 0);
+    int top = max(max(clip.top - *y, -*sourceY), 0);
+    *x += left;
+    *sourceX += left;
+    *width -= left;
+    *y += top;
+    *sourceY += top;
+    *height -= top;
+
+    *width = min(*width, min(clip.right - *x, source->width - *sourceX));
+    *height = min(*height, min(clip.bottom - *y, source->height - *sourceY));
+
+    return *width > 0 && *height > 0;
 }
 
-void ConsoleBuffer_setAttrib(ConsoleBuffer* consoleBuffer, int x, int y, DWORD attrib)
+void ConsoleBuffer_blit(ConsoleBuffer* consoleBuffer, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height)
 {
-    consoleBuffer->_buffer[x + y * consoleBuffer->width].Attributes = attrib;
+    if (!ConsoleBuffer_clipBlit(consoleBuffer, source, &x, &y, &sourceX, &sourceY, &width, &height)) return;
+
+    ConsoleBuffer_markDirty(consoleBuffer, x, y, width, height);
+
+    // Blitting a buffer onto itself further down would overwrite rows before they are copied, so those go bottom up
+    const char bottomUp = source == consoleBuffer && y > sourceY;
+    for (int i = 0; i < height; i++)
+    {
+        const int j = bottomUp ? height - 1 - i : i;
+        memmove(&consoleBuffer->_cells[(y + j) * consoleBuffer->width + x], &source->_cells[(sourceY + j) * source->width + sourceX], width * sizeof(ConsoleCell));
+    }
 }
 
-void ConsoleBuffer_setForegroundAttrib(ConsoleBuffer* consoleBuffer, int x, int y, uint8_t flags)
+void ConsoleBuffer_blitMasked(ConsoleBuffer* consoleBuffer, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height, ConsoleCell transparentCell)
+{
+    if (!ConsoleBuffer_clipBlit(consoleBuffer, source, &x, &y, &sourceX, &sourceY, &width, &height)) return;
+
+    ConsoleBuffer_markDirty(consoleBuffer, x, y, width, height);
+
+    for (int j = 0; j < height; j++)
+    {
+        Console_copyCellsMasked(&consoleBuffer->_cells[(y + j) * consoleBuffer->width + x], &source->_cells[(sourceY + j) * source->width + sourceX], width, transparentCell);
+    }
+}
+
+// Moves the rows of a rect of elements dy rows, dropping the ones moved out of it. Rects as wide as the rows are one block
+static void Console_shiftRows(void* elements, size_t elementSize, int stride, ConsoleRect rect, int dy)
 {
-    CHAR_INFO* bufferPtr = &consoleBuffer->_buffer[x + y * consoleBuffer->width];
-    bufferPtr->Attributes = (flags & 0xF) | (bufferPtr->Attributes & 0xF0);
+    char* bytes = elements;
+    const int count = rect.bottom - rect.top - abs(dy);
+    const int from = dy < 0 ? rect.top - dy : rect.top;
+    const size_t rowSize = (rect.right - rect.left) * elementSize;
+
+    if (rect.left == 0 && rect.right == stride)
+    {
+        memmove(&bytes[(size_t)(from + dy) * rowSize], &bytes[(size_t)from * rowSize], count * rowSize);
+        return;
+    }
+
+    // Rows never overlap each other, they only have to be moved in the right order
+    for (int i = 0; i < count; i++)
+    {
+        const int y = dy < 0 ? from + i : from + count - 1 - i;
+        memcpy(&bytes[((size_t)(y + dy) * stride + rect.left) * elementSize], &bytes[((size_t)y * stride + rect.left) * elementSize], rowSize);
+    }
 }
 
-void ConsoleBuffer_setBackgroundAttrib(ConsoleBuffer* consoleBuffer, int x, int y, uint8_t flags)
+void ConsoleBuffer_scroll(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, int dy, char c, WORD attrib)
 {
-    CHAR_INFO* bufferPtr = &consoleBuffer->_buffer[x + y * consoleBuffer->width];
-    bufferPtr->Attributes = ((flags & 0xF) << 4) | (bufferPtr->Attributes & 0xF);
+    const ConsoleRect clip = consoleBuffer->_clip;
+    ConsoleRect rect;
+    rect.left = max(x, clip.left);
+    rect.top = max(y, clip.top);
+    rect.right = (int)min((int64_t)x + width, (int64_t)clip.right);
+    rect.bottom = (int)min((int64_t)y + height, (int64_t)clip.bottom);
+    if (rect.left >= rect.right || rect.top >= rect.bottom || dy == 0) return;
+
+    ConsoleBuffer_markDirty(consoleBuffer, rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top);
+
+    const char sameRect = consoleBuffer->_scrollDy != 0 && memcmp(&consoleBuffer->_scrollRect, &rect, sizeof(rect)) == 0;
+    const int rows = rect.bottom - rect.top;
+    int exposedTop = rect.top;
+    int exposedBottom = rect.bottom;
+
+    if (abs(dy) < rows)
+    {
+        Console_shiftRows(consoleBuffer->_cells, sizeof(ConsoleCell), consoleBuffer->width, rect, dy);
+        if (consoleBuffer->_foregrounds)
+        {
+            Console_shiftRows(consoleBuffer->_foregrounds, sizeof(ConsoleColour), consoleBuffer->width, rect, dy);
+            Console_shiftRows(consoleBuffer->_backgrounds, sizeof(ConsoleColour), consoleBuffer->width, rect, dy);
+        }
+
+        if (dy < 0) exposedTop = rect.bottom + dy;
+        else exposedBottom = rect.top + dy;
+
+        // Scrolls of the same rect add up, one of another rect replaces the last, which is then redrawn as changed cells
+        consoleBuffer->_scrollDy = sameRect ? consoleBuffer->_scrollDy + dy : dy;
+        consoleBuffer->_scrollRect = rect;
+        if (abs(consoleBuffer->_scrollDy) >= rows) consoleBuffer->_scrollDy = 0;
+    }
+    else if (sameRect)
+    {
+        consoleBuffer->_scrollDy = 0;
+    }
+
+    const ConsoleCell cell = CONSOLE_CELL(c, attrib);
+    for (int row = exposedTop; row < exposedBottom; row++)
+    {
+        Console_fillCells(&consoleBuffer->_cells[row * consoleBuffer->width + rect.left], cell, rect.right - rect.left);
+        if (!consoleBuffer->_foregrounds) continue;
+
+        Console_fillColours(&consoleBuffer->_foregrounds[row * consoleBuffer->width + rect.left], CONSOLE_COLOUR_ATTRIB, rect.right - rect.left);
+        Console_fillColours(&consoleBuffer->_backgrounds[row * consoleBuffer->width + rect.left], CONSOLE_COLOUR_ATTRIB, rect.right - rect.left);
+    }
 }
 
-ConsolePixel ConsoleBuffer_getPixel(ConsoleBuffer* consoleBuffer, int x, int y)
+void ConsoleBuffer_destroy(ConsoleBuffer* consoleBuffer)
 {
-    return consoleBuffer->_buffer[y * consoleBuffer->width + x];
+    free(consoleBuffer->_cells);
+    consoleBuffer->_cells = NULL;
+
+    free(consoleBuffer->_tileStamps);
+    consoleBuffer->_tileStamps = NULL;
+
+    free(consoleBuffer->_foregrounds);
+    free(consoleBuffer->_backgrounds);
+    consoleBuffer->_foregrounds = NULL;
+    consoleBuffer->_backgrounds = NULL;
 }
 
-void ConsoleBuffer_drawText(ConsoleBuffer* consoleBuffer, const char* text, int x, int y, WORD attrib)
+void ConsoleBuffer_setDirtyTracking(ConsoleBuffer* consoleBuffer, char enabled)
 {
-    int i = 0;
-    while (1)
+    if (enabled && !consoleBuffer->_tileStamps)
     {
-        char c = text[i];
-        if (c == '\0') break;
-        ConsoleBuffer_setChar(consoleBuffer, x + i, y, c);
-        ConsoleBuffer_setAttrib(consoleBuffer, x + i, y, attrib);
-        i++;
+        consoleBuffer->_tileStamps = malloc(consoleBuffer->_tilesX * consoleBuffer->_tilesY * sizeof(uint32_t));
+        CONSOLE_PROFILE_ALLOCATION();
+        ConsoleBuffer_markDirty(consoleBuffer, 0, 0, consoleBuffer->width, consoleBuffer->height);
+    }
+    else if (!enabled)
+    {
+        free(consoleBuffer->_tileStamps);
+        consoleBuffer->_tileStamps = NULL;
     }
 }
 
-void ConsoleBuffer_drawRect(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, char c, WORD attrib)
+static void ConsoleBuffer_markCell(ConsoleBuffer* consoleBuffer, int x, int y)
 {
-    int widthSign = 1;
-    int heightSign = 1;
+    if (consoleBuffer->_tileStamps)
+    {
+        consoleBuffer->_tileStamps[((unsigned)y / CONSOLE_TILE_HEIGHT) * consoleBuffer->_tilesX + (unsigned)x / CONSOLE_TILE_WIDTH] = consoleBuffer->_dirtyEpoch;
+    }
+}
 
-    if (width < 0)
+void ConsoleBuffer_markDirty(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height)
+{
+    if (!consoleBuffer->_tileStamps) return;
+
+    int left = max(x, 0);
+    int top = max(y, 0);
+    int right = min(x + width, consoleBuffer->width);
+    int bottom = min(y + height, consoleBuffer->height);
+    if (left >= right || top >= bottom) return;
+
+    for (int tileY = top / CONSOLE_TILE_HEIGHT; tileY <= (bottom - 1) / CONSOLE_TILE_HEIGHT; tileY++)
     {
-        x--;
-        widthSign = -1;
-        width--;
+        uint32_t* stamps = &consoleBuffer->_tileStamps[tileY * consoleBuffer->_tilesX];
+        for (int tileX = left / CONSOLE_TILE_WIDTH; tileX <= (right - 1) / CONSOLE_TILE_WIDTH; tileX++)
+        {
+            stamps[tileX] = consoleBuffer->_dirtyEpoch;
+        }
     }
-    if (height < 0)
+}
+
+uint32_t ConsoleBuffer_takeDirtyMark(ConsoleBuffer* consoleBuffer)
+{
+    return consoleBuffer->_dirtyEpoch++;
+}
+
+char ConsoleBuffer_isTileDirty(const ConsoleBuffer* consoleBuffer, int tileX, int tileY, uint32_t mark)
+{
+    if (!consoleBuffer->_tileStamps) return 1;
+    return consoleBuffer->_tileStamps[tileY * consoleBuffer->_tilesX + tileX] > mark;
+}
+
+// Finds the next span of dirty tiles on row y at or after column from. Without dirty tracking the whole row is one span
+static int ConsoleBuffer_nextDirtySpan(const ConsoleBuffer* consoleBuffer, uint32_t mark, int y, int from, int* start, int* end)
+{
+    if (!consoleBuffer->_tileStamps)
     {
-        y--;
-        heightSign = -1;
-        height--;
+        *start = 0;
+        *end = consoleBuffer->width;
+        return from == 0;
     }
 
-    for (int i = 0; abs(i) < abs(width); i += widthSign)
-    {
-        for (int j = 0; abs(j) < abs(height); j += heightSign)
-        {
-            ConsoleBuffer_setChar(consoleBuffer, x + i, y + j, c);
-            ConsoleBuffer_setAttrib(consoleBuffer, x + i, y + j, attrib);
-        }
-    }
+    const uint32_t* stamps = &consoleBuffer->_tileStamps[(y / CONSOLE_TILE_HEIGHT) * consoleBuffer->_tilesX];
+    int tileX = (from + CONSOLE_TILE_WIDTH - 1) / CONSOLE_TILE_WIDTH;
+
+    while (tileX < consoleBuffer->_tilesX && stamps[tileX] <= mark) tileX++;
+    if (tileX >= consoleBuffer->_tilesX) return 0;
+
+    int tileEnd = tileX + 1;
+    while (tileEnd < consoleBuffer->_tilesX && stamps[tileEnd] > mark) tileEnd++;
+
+    *start = tileX * CONSOLE_TILE_WIDTH;
+    *end = min(tileEnd * CONSOLE_TILE_WIDTH, consoleBuffer->width);
+    return 1;
+}
+
+void ConsoleBuffer_pushClip(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height)
+{
+    int depth = consoleBuffer->_clipDepth++;
+    if (depth >= CONSOLE_CLIP_STACK_MAX) return;
+
+    ConsoleRect* clip = &consoleBuffer->_clip;
+    consoleBuffer->_clipStack[depth] = *clip;
+
+    clip->left = max(clip->left, x);
+    clip->top = max(clip->top, y);
+    clip->right = max(min(clip->right, x + width), clip->left);
+    clip->bottom = max(min(clip->bottom, y + height), clip->top);
+}
+
+void ConsoleBuffer_popClip(ConsoleBuffer* consoleBuffer)
+{
+    if (consoleBuffer->_clipDepth == 0) return;
+
+    int depth = --consoleBuffer->_clipDepth;
+    if (depth >= CONSOLE_CLIP_STACK_MAX) return;
+
+    consoleBuffer->_clip = consoleBuffer->_clipStack[depth];
+}
+
+ConsoleRect ConsoleBuffer_getClip(const ConsoleBuffer* consoleBuffer)
+{
+    return consoleBuffer->_clip;
+}
+
+void ConsoleBuffer_setColourPlanes(ConsoleBuffer* consoleBuffer, char enabled)
+{
+    if (enabled == (consoleBuffer->_foregrounds != NULL)) return;
+
+    if (enabled)
+    {
+        Console_buildColourTables();
+
+        const size_t count = consoleBuffer->width * consoleBuffer->height;
+        consoleBuffer->_foregrounds = malloc(count * sizeof(ConsoleColour));
+        CONSOLE_PROFILE_ALLOCATION();
+        consoleBuffer->_backgrounds = malloc(count * sizeof(ConsoleColour));
+        CONSOLE_PROFILE_ALLOCATION();
+        Console_fillColours(consoleBuffer->_foregrounds, CONSOLE_COLOUR_ATTRIB, count);
+        Console_fillColours(consoleBuffer->_backgrounds, CONSOLE_COLOUR_ATTRIB, count);
+    }
+    else
+    {
+        free(consoleBuffer->_foregrounds);
+        free(consoleBuffer->_backgrounds);
+        consoleBuffer->_foregrounds = NULL;
+        consoleBuffer->_backgrounds = NULL;
+    }
+
+    ConsoleBuffer_markDirty(consoleBuffer, 0, 0, consoleBuffer->width, consoleBuffer->height);
+}
+
+void ConsoleBuffer_setColour(ConsoleBuffer* consoleBuffer, int x, int y, ConsoleColour foreground, ConsoleColour background)
+{
+    consoleBuffer->_foregrounds[x + y * consoleBuffer->width] = foreground;
+    consoleBuffer->_backgrounds[x + y * consoleBuffer->width] = background;
+    ConsoleBuffer_markCell(consoleBuffer, x, y);
+}
+
+void ConsoleBuffer_fillColour(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, ConsoleColour foreground, ConsoleColour background)
+{
+    const ConsoleRect clip = consoleBuffer->_clip;
+    int left = max(x, clip.left);
+    int top = max(y, clip.top);
+    int right = (int)min((int64_t)x + width, (int64_t)clip.right);
+    int bottom = (int)min((int64_t)y + height, (int64_t)clip.bottom);
+    if (left >= right || top >= bottom) return;
+
+    ConsoleBuffer_markDirty(consoleBuffer, left, top, right - left, bottom - top);
+
+    for (int row = top; row < bottom; row++)
+    {
+        Console_fillColours(&consoleBuffer->_foregrounds[row * consoleBuffer->width + left], foreground, right - left);
+        Console_fillColours(&consoleBuffer->_backgrounds[row * consoleBuffer->width + left], background, right - left);
+    }
+}
+
+void ConsoleBuffer_setChar(ConsoleBuffer* consoleBuffer, int x, int y, char c)
+{
+    ConsoleCell* cell = &consoleBuffer->_cells[x + y * consoleBuffer->width];
+    *cell = (*cell & 0xFF00) | (uint8_t)c;
+    ConsoleBuffer_markCell(consoleBuffer, x, y);
+}
+
+void ConsoleBuffer_setAttrib(ConsoleBuffer* consoleBuffer, int x, int y, DWORD attrib)
+{
+    ConsoleCell* cell = &consoleBuffer->_cells[x + y * consoleBuffer->width];
+    *cell = (*cell & 0x00FF) | ((attrib & 0xFF) << 8);
+    ConsoleBuffer_markCell(consoleBuffer, x, y);
+}
+
+void ConsoleBuffer_setForegroundAttrib(ConsoleBuffer* consoleBuffer, int x, int y, uint8_t flags)
+{
+    ConsoleCell* cell = &consoleBuffer->_cells[x + y * consoleBuffer->width];
+    *cell = (*cell & 0xF0FF) | ((flags & 0xF) << 8);
+    ConsoleBuffer_markCell(consoleBuffer, x, y);
+}
+
+void ConsoleBuffer_setBackgroundAttrib(ConsoleBuffer* consoleBuffer, int x, int y, uint8_t flags)
+{
+    ConsoleCell* cell = &consoleBuffer->_cells[x + y * consoleBuffer->width];
+    *cell = (*cell & 0x0FFF) | ((flags & 0xF) << 12);
+    ConsoleBuffer_markCell(consoleBuffer, x, y);
+}
+
+ConsolePixel ConsoleBuffer_getPixel(ConsoleBuffer* consoleBuffer, int x, int y)
+{
+    ConsoleCell cell = consoleBuffer->_cells[y * consoleBuffer->width + x];
+
+    ConsolePixel pixel;
+    memset(&pixel, 0, sizeof(pixel));
+    pixel.Char.AsciiChar = CONSOLE_CELL_CHAR(cell);
+    pixel.Attributes = CONSOLE_CELL_ATTRIB(cell);
+    return pixel;
+}
+
+void ConsoleBuffer_drawText(ConsoleBuffer* consoleBuffer, const char* text, int x, int y, WORD attrib)
+{
+    const ConsoleRect clip = consoleBuffer->_clip;
+    if (y < clip.top || y >= clip.bottom) return;
+
+    int start = max(clip.left - x, 0);
+    int end = (int)min((size_t)max(clip.right - x, 0), strlen(text));
+    if (start >= end) return;
+
+    ConsoleBuffer_markDirty(consoleBuffer, x + start, y, end - start, 1);
+
+    ConsoleCell* cells = &consoleBuffer->_cells[y * consoleBuffer->width + x + start];
+    for (int i = start; i < end; i++)
+    {
+        *cells++ = CONSOLE_CELL(text[i], attrib);
+    }
+}
+
+void ConsoleBuffer_drawRect(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, char c, WORD attrib)
+{
+    // Negative sizes extend left or up from one before x or y
+    if (width < 0)
+    {
+        x += width - 1;
+        width = 1 - width;
+    }
+    if (height < 0)
+    {
+        y += height - 1;
+        height = 1 - height;
+    }
+
+    const ConsoleRect clip = consoleBuffer->_clip;
+    int left = max(x, clip.left);
+    int top = max(y, clip.top);
+    int right = min(x + width, clip.right);
+    int bottom = min(y + height, clip.bottom);
+    if (left >= right || top >= bottom) return;
+
+    x = left;
+    y = top;
+    width = right - left;
+    height = bottom - top;
+
+    ConsoleBuffer_markDirty(consoleBuffer, x, y, width, height);
+
+    const ConsoleCell cell = CONSOLE_CELL(c, attrib);
+    for (int j = 0; j < height; j++)
+    {
+        Console_fillCells(&consoleBuffer->_cells[(y + j) * consoleBuffer->width + x], cell, width);
+    }
+}
+
+// Cohen-Sutherland outcode of a point against the clip rect
+static int ConsoleBuffer_outcode(const ConsoleRect* clip, int x, int y)
+{
+    return (x < clip->left) | ((x >= clip->right) << 1) | ((y < clip->top) << 2) | ((y >= clip->bottom) << 3);
+}
+
+static int64_t Console_floorDiv(int64_t a, int64_t b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int64_t Console_ceilDiv(int64_t a, int64_t b)
+{
+    return -Console_floorDiv(-a, b);
+}
+
+// Range of offsets along a direction from origin that stay within [low, high]
+static void Console_offsetRange(int origin, int sign, int low, int high, int64_t* from, int64_t* to)
+{
+    *from = sign > 0 ? (int64_t)low - origin : (int64_t)origin - high;
+    *to = sign > 0 ? (int64_t)high - origin : (int64_t)origin - low;
+}
+
+void ConsoleBuffer_drawLine(ConsoleBuffer* consoleBuffer, int x1, int y1, int x2, int y2, char c, WORD attrib)
+{
+    const ConsoleRect clip = consoleBuffer->_clip;
+    const ConsoleCell cell = CONSOLE_CELL(c, attrib);
+
+    int outcode1 = ConsoleBuffer_outcode(&clip, x1, y1);
+    int outcode2 = ConsoleBuffer_outcode(&clip, x2, y2);
+    if (outcode1 & outcode2) return;
+
+    if (x1 == x2 && y1 == y2)
+    {
+        if (outcode1) return;
+        consoleBuffer->_cells[y1 * consoleBuffer->width + x1] = cell;
+        ConsoleBuffer_markDirty(consoleBuffer, x1, y1, 1, 1);
+        return;
+    }
+
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+    int sx = x2 >= x1 ? 1 : -1;
+    int sy = y2 >= y1 ? 1 : -1;
+
+    // Step i along the major axis moves the minor axis by floor((2 * i * minor + major) / (2 * major))
+    char xMajor = dx >= dy;
+    int major = xMajor ? dx : dy;
+    int minor = xMajor ? dy : dx;
+
+    int64_t first = 0;
+    int64_t last = major;
+
+    // A line leaving the clip rect is trimmed to the steps that land inside it, so it covers the same cells as unclipped
+    if (outcode1 | outcode2)
+    {
+        int64_t from, to;
+        if (xMajor) Console_offsetRange(x1, sx, clip.left, clip.right - 1, &from, &to);
+        else Console_offsetRange(y1, sy, clip.top, clip.bottom - 1, &from, &to);
+        first = max(first, from);
+        last = min(last, to);
+
+        if (xMajor) Console_offsetRange(y1, sy, clip.top, clip.bottom - 1, &from, &to);
+        else Console_offsetRange(x1, sx, clip.left, clip.right - 1, &from, &to);
+        if (minor == 0)
+        {
+            if (from > 0 || to < 0) return;
+        }
+        else
+        {
+            first = max(first, Console_ceilDiv((2 * from - 1) * major, 2 * (int64_t)minor));
+            last = min(last, Console_ceilDiv((2 * to + 1) * major, 2 * (int64_t)minor) - 1);
+        }
+
+        if (first > last) return;
+    }
+
+    int64_t numerator = 2 * first * minor + major;
+    int offset = (int)(numerator / (2 * major));
+    int error = (int)(numerator % (2 * major));
+
+    int x = x1 + sx * (xMajor ? (int)first : offset);
+    int y = y1 + sy * (xMajor ? offset : (int)first);
+    int majorX = xMajor ? sx : 0;
+    int majorY = xMajor ? 0 : sy;
+    int minorX = xMajor ? 0 : sx;
+    int minorY = xMajor ? sy : 0;
+
+    const int width = consoleBuffer->width;
+    ConsoleCell* cells = consoleBuffer->_cells;
+
+    // Marks dirty tiles once per chunk of steps, each chunk's bounding box spanning at most 2x2 tiles
+    for (int i = (int)first; i <= (int)last;)
+    {
+        int chunkEnd = min(i + CONSOLE_TILE_HEIGHT - 1, (int)last);
+        int chunkX = x;
+        int chunkY = y;
+        int endX = x;
+        int endY = y;
+
+        for (; i <= chunkEnd; i++)
+        {
+            cells[y * width + x] = cell;
+            endX = x;
+            endY = y;
+
+            x += majorX;
+            y += majorY;
+            error += 2 * minor;
+            if (error >= 2 * major)
+            {
+                error -= 2 * major;
+                x += minorX;
+                y += minorY;
+            }
+        }
+
+        ConsoleBuffer_markDirty(consoleBuffer, min(chunkX, endX), min(chunkY, endY), abs(endX - chunkX) + 1, abs(endY - chunkY) + 1);
+    }
+}
+
+// Fills cells [left, right) of row y, clipped to the clip rect. The shape rasterizers write through this
+static void ConsoleBuffer_fillSpan(ConsoleBuffer* consoleBuffer, int y, int left, int right, ConsoleCell cell)
+{
+    const ConsoleRect clip = consoleBuffer->_clip;
+    if (y < clip.top || y >= clip.bottom) return;
+
+    left = max(left, clip.left);
+    right = min(right, clip.right);
+    if (left >= right) return;
+
+    ConsoleBuffer_markDirty(consoleBuffer, left, y, right - left, 1);
+    Console_fillCells(&consoleBuffer->_cells[y * consoleBuffer->width + left], cell, right - left);
+}
+
+// A row span still to be scanned, and the direction of the row it was found from
+typedef struct ConsoleFillSpan
+{
+    int left;
+    int right;
+    int y;
+    int dy;
+} ConsoleFillSpan;
+
+typedef struct ConsoleFill
+{
+    ConsoleBuffer* consoleBuffer;
+    ConsoleArena* scratch;
+
+    ConsoleFillSpan* stack;
+    int count;
+    int capacity;
+
+    ConsoleCell mask;
+    ConsoleCell target;
+    ConsoleCell cell;
+
+    // Only used when the fill cell still matches, so filled cells can't be told apart from unfilled ones
+    uint8_t* visited;
+    int filled;
+} ConsoleFill;
+
+static char ConsoleFill_inside(const ConsoleFill* fill, int x, int y)
+{
+    const ConsoleBuffer* consoleBuffer = fill->consoleBuffer;
+    const ConsoleRect* clip = &consoleBuffer->_clip;
+    if (x < clip->left || x >= clip->right || y < clip->top || y >= clip->bottom) return 0;
+
+    const int i = y * consoleBuffer->width + x;
+    if ((consoleBuffer->_cells[i] & fill->mask) != fill->target) return 0;
+    return !fill->visited || !(fill->visited[i >> 3] & (1 << (i & 7)));
+}
+
+static void ConsoleFill_push(ConsoleFill* fill, int left, int right, int y, int dy)
+{
+    const ConsoleRect* clip = &fill->consoleBuffer->_clip;
+    if (y < clip->top || y >= clip->bottom) return;
+
+    // The old stack stays in the arena until it is reset, growing by doubling keeps that under the final size
+    if (fill->count == fill->capacity)
+    {
+        ConsoleFillSpan* stack = ConsoleArena_alloc(fill->scratch, fill->capacity * 2 * sizeof(ConsoleFillSpan));
+        memcpy(stack, fill->stack, fill->count * sizeof(ConsoleFillSpan));
+        fill->stack = stack;
+        fill->capacity *= 2;
+    }
+
+    ConsoleFillSpan* span = &fill->stack[fill->count++];
+    span->left = left;
+    span->right = right;
+    span->y = y;
+    span->dy = dy;
+}
+
+// Fills cells [left, right) of row y, which are all inside
+static void ConsoleFill_setSpan(ConsoleFill* fill, int left, int right, int y)
+{
+    ConsoleBuffer_fillSpan(fill->consoleBuffer, y, left, right, fill->cell);
+    fill->filled += right - left;
+
+    if (!fill->visited) return;
+
+    for (int i = y * fill->consoleBuffer->width + left; i < y * fill->consoleBuffer->width + right; i++)
+    {
+        fill->visited[i >> 3] |= 1 << (i & 7);
+    }
+}
+
+int ConsoleBuffer_floodFill(ConsoleBuffer* consoleBuffer, int x, int y, char c, WORD attrib, int match, ConsoleArena* scratch)
+{
+    ConsoleFill fill;
+    memset(&fill, 0, sizeof(fill));
+    fill.consoleBuffer = consoleBuffer;
+    fill.scratch = scratch;
+    fill.mask = ((match & CONSOLE_FILL_MATCH_CHAR) ? 0x00FF : 0) | ((match & CONSOLE_FILL_MATCH_ATTRIB) ? 0xFF00 : 0);
+    if (!fill.mask) fill.mask = 0xFFFF;
+    fill.cell = CONSOLE_CELL(c, attrib);
+
+    const ConsoleRect clip = consoleBuffer->_clip;
+    if (x < clip.left || x >= clip.right || y < clip.top || y >= clip.bottom) return 0;
+    fill.target = consoleBuffer->_cells[y * consoleBuffer->width + x] & fill.mask;
+
+    if ((fill.cell & fill.mask) == fill.target)
+    {
+        // Matching whole cells, nothing would change. Otherwise cells that match only in part still take the fill, and as the
+        // matched parts stay the same the filled cells are tracked
+        if (fill.mask == 0xFFFF) return 0;
+
+        size_t visitedSize = ((size_t)consoleBuffer->width * consoleBuffer->height + 7) / 8;
+        fill.visited = ConsoleArena_alloc(scratch, visitedSize);
+        memset(fill.visited, 0, visitedSize);
+    }
+
+    fill.capacity = 64;
+    fill.stack = ConsoleArena_alloc(scratch, fill.capacity * sizeof(ConsoleFillSpan));
+
+    // Span filling: each popped span is scanned and extended to whole runs of inside cells, which are filled at once. Runs
+    // reaching past the span they were found from are pushed back towards the row it came from as well
+    ConsoleFill_push(&fill, x, x, y, 1);
+    ConsoleFill_push(&fill, x, x, y - 1, -1);
+
+    while (fill.count > 0)
+    {
+        const ConsoleFillSpan span = fill.stack[--fill.count];
+        int x1 = span.left;
+        int x2 = span.right;
+        int row = span.y;
+        int dy = span.dy;
+        int start = x1;
+
+        if (ConsoleFill_inside(&fill, start, row))
+        {
+            while (ConsoleFill_inside(&fill, start - 1, row)) start--;
+
+            if (start < x1)
+            {
+                ConsoleFill_setSpan(&fill, start, x1, row);
+                ConsoleFill_push(&fill, start, x1 - 1, row - dy, -dy);
+            }
+        }
+
+        while (x1 <= x2)
+        {
+            int runStart = x1;
+            while (ConsoleFill_inside(&fill, x1, row)) x1++;
+            if (x1 > runStart) ConsoleFill_setSpan(&fill, runStart, x1, row);
+
+            if (x1 > start) ConsoleFill_push(&fill, start, x1 - 1, row + dy, dy);
+            if (x1 - 1 > x2) ConsoleFill_push(&fill, x2 + 1, x1 - 1, row - dy, -dy);
+
+            x1++;
+            while (x1 < x2 && !ConsoleFill_inside(&fill, x1, row)) x1++;
+            start = x1;
+        }
+    }
+
+    return fill.filled;
+}
+
+// Half width of the ellipse's row dy, or -1 outside it. Covers the cells whose centres fall inside the ellipse with half a
+// cell added to each radius, so a radius of 0 is a single cell
+static int Console_ellipseHalfWidth(int radiusX, int radiusY, int dy)
+{
+    if (dy < -radiusY || dy > radiusY) return -1;
+
+    const double rx = radiusX + 0.5;
+    const double ry = radiusY + 0.5;
+    return (int)(rx * sqrt(1.0 - ((double)dy * dy) / (ry * ry)) + 1e-9);
+}
+
+static void ConsoleBuffer_rasterizeEllipse(ConsoleBuffer* consoleBuffer, int x, int y, int radiusX, int radiusY, char c, WORD attrib, char filled)
+{
+    if (radiusX < 0 || radiusY < 0) return;
+
+    const ConsoleRect clip = consoleBuffer->_clip;
+    const ConsoleCell cell = CONSOLE_CELL(c, attrib);
+    int top = (int)max((int64_t)y - radiusY, (int64_t)clip.top);
+    int bottom = (int)min((int64_t)y + radiusY, (int64_t)clip.bottom - 1);
+
+    for (int row = top; row <= bottom; row++)
+    {
+        const int halfWidth = Console_ellipseHalfWidth(radiusX, radiusY, row - y);
+
+        // The outline is the cells of the filled shape not covered by both the rows above and below
+        int inner = filled ? halfWidth : min(Console_ellipseHalfWidth(radiusX, radiusY, row - y - 1), Console_ellipseHalfWidth(radiusX, radiusY, row - y + 1));
+        if (filled || inner < 0)
+        {
+            ConsoleBuffer_fillSpan(consoleBuffer, row, x - halfWidth, x + halfWidth + 1, cell);
+            continue;
+        }
+
+        inner = min(inner + 1, halfWidth);
+        ConsoleBuffer_fillSpan(consoleBuffer, row, x - halfWidth, x - inner + 1, cell);
+        ConsoleBuffer_fillSpan(consoleBuffer, row, x + inner, x + halfWidth + 1, cell);
+    }
+}
+
+void ConsoleBuffer_drawEllipse(ConsoleBuffer* consoleBuffer, int x, int y, int radiusX, int radiusY, char c, WORD attrib)
+{
+    ConsoleBuffer_rasterizeEllipse(consoleBuffer, x, y, radiusX, radiusY, c, attrib, 0);
+}
+
+void ConsoleBuffer_fillEllipse(ConsoleBuffer* consoleBuffer, int x, int y, int radiusX, int radiusY, char c, WORD attrib)
+{
+    ConsoleBuffer_rasterizeEllipse(consoleBuffer, x, y, radiusX, radiusY, c, attrib, 1);
+}
+
+void ConsoleBuffer_drawCircle(ConsoleBuffer* consoleBuffer, int x, int y, int radius, char c, WORD attrib)
+{
+    ConsoleBuffer_rasterizeEllipse(consoleBuffer, x, y, radius, radius, c, attrib, 0);
+}
+
+void ConsoleBuffer_fillCircle(ConsoleBuffer* consoleBuffer, int x, int y, int radius, char c, WORD attrib)
+{
+    ConsoleBuffer_rasterizeEllipse(consoleBuffer, x, y, radius, radius, c, attrib, 1);
+}
+
+void ConsoleBuffer_drawPolygon(ConsoleBuffer* consoleBuffer, const ConsolePoint* points, int numPoints, char c, WORD attrib)
+{
+    for (int i = 0; i < numPoints; i++)
+    {
+        const ConsolePoint* next = &points[(i + 1) % numPoints];
+        ConsoleBuffer_drawLine(consoleBuffer, points[i].x, points[i].y, next->x, next->y, c, attrib);
+    }
+}
+
+// Where an edge crosses a row, as the first and last cell centre at or past it either way
+typedef struct ConsolePolygonCrossing
+{
+    int ceilX;
+    int floorX;
+} ConsolePolygonCrossing;
+
+#define CONSOLE_POLYGON_STACK_CROSSINGS 64
+
+void ConsoleBuffer_fillPolygon(ConsoleBuffer* consoleBuffer, const ConsolePoint* points, int numPoints, char c, WORD attrib)
+{
+    if (numPoints < 1) return;
+
+    const ConsoleRect clip = consoleBuffer->_clip;
+    const ConsoleCell cell = CONSOLE_CELL(c, attrib);
+
+    int top = points[0].y;
+    int bottom = points[0].y;
+    for (int i = 1; i < numPoints; i++)
+    {
+        top = min(top, points[i].y);
+        bottom = max(bottom, points[i].y);
+    }
+    top = max(top, clip.top);
+    bottom = min(bottom, clip.bottom - 1);
+
+    ConsolePolygonCrossing stackCrossings[CONSOLE_POLYGON_STACK_CROSSINGS];
+    ConsolePolygonCrossing* crossings = numPoints <= CONSOLE_POLYGON_STACK_CROSSINGS ? stackCrossings : malloc(numPoints * sizeof(ConsolePolygonCrossing));
+    if (crossings != stackCrossings) CONSOLE_PROFILE_ALLOCATION();
+
+    // Even-odd rule at the cell centres of each row. Edges cover rows [top, bottom), so a vertex shared by two edges counts once
+    for (int y = top; y <= bottom; y++)
+    {
+        int count = 0;
+        for (int i = 0; i < numPoints; i++)
+        {
+            ConsolePoint a = points[i];
+            ConsolePoint b = points[(i + 1) % numPoints];
+            if (a.y == b.y) continue;
+            if (a.y > b.y)
+            {
+                ConsolePoint swap = a;
+                a = b;
+                b = swap;
+            }
+            if (y < a.y || y >= b.y) continue;
+
+            int64_t numerator = (int64_t)a.x * (b.y - a.y) + (int64_t)(y - a.y) * (b.x - a.x);
+            ConsolePolygonCrossing crossing;
+            crossing.ceilX = (int)Console_ceilDiv(numerator, b.y - a.y);
+            crossing.floorX = (int)Console_floorDiv(numerator, b.y - a.y);
+
+            // Insertion sort, there are rarely more than a few crossings per row
+            int j = count++;
+            while (j > 0 && (crossings[j - 1].ceilX > crossing.ceilX || (crossings[j - 1].ceilX == crossing.ceilX && crossings[j - 1].floorX > crossing.floorX)))
+            {
+                crossings[j] = crossings[j - 1];
+                j--;
+            }
+            crossings[j] = crossing;
+        }
+
+        for (int i = 0; i + 1 < count; i += 2)
+        {
+            ConsoleBuffer_fillSpan(consoleBuffer, y, crossings[i].ceilX, crossings[i + 1].floorX + 1, cell);
+        }
+    }
+
+    if (crossings != stackCrossings) free(crossings);
+
+    // The interior only holds cell centres strictly inside, the outline covers the edges themselves
+    ConsoleBuffer_drawPolygon(consoleBuffer, points, numPoints, c, attrib);
+}
+
+// Averages the summed source rows over each pixel's columns, for pixels [left, right) of a row width pixels wide
+static void Console_resolveImageRow(const ConsoleImage* image, const uint32_t* sums, int rows, int width, int left, int right, ConsoleColour* colours)
+{
+    for (int pixel = left; pixel < right; pixel++)
+    {
+        const int x0 = (int)((int64_t)pixel * image->width / width);
+        const int x1 = max((int)((int64_t)(pixel + 1) * image->width / width), x0 + 1);
+        const uint32_t count = (uint32_t)(x1 - x0) * rows;
+
+        if (image->format == CONSOLE_IMAGE_GREY)
+        {
+            uint32_t grey = 0;
+            for (int i = x0; i < x1; i++) grey += sums[i];
+
+            grey = (grey + count / 2) / count;
+            colours[pixel - left] = CONSOLE_RGB(grey, grey, grey);
+            continue;
+        }
+
+        uint32_t r = 0;
+        uint32_t g = 0;
+        uint32_t b = 0;
+        for (int i = x0 * 3; i < x1 * 3; i += 3)
+        {
+            r += sums[i];
+            g += sums[i + 1];
+            b += sums[i + 2];
+        }
+
+        colours[pixel - left] = CONSOLE_RGB((r + count / 2) / count, (g + count / 2) / count, (b + count / 2) / count);
+    }
+}
+
+void ConsoleBuffer_drawImage(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, const ConsoleImage* image, ConsoleArena* scratch)
+{
+    const ConsoleRect clip = consoleBuffer->_clip;
+    int left = max(x, clip.left);
+    int top = max(y, clip.top);
+    int right = (int)min((int64_t)x + width, (int64_t)clip.right);
+    int bottom = (int)min((int64_t)y + height, (int64_t)clip.bottom);
+    if (left >= right || top >= bottom || image->width <= 0 || image->height <= 0) return;
+
+    Console_buildColourTables();
+    ConsoleBuffer_markDirty(consoleBuffer, left, top, right - left, bottom - top);
+
+    const size_t rowSize = (size_t)image->width * (image->format == CONSOLE_IMAGE_RGB ? 3 : 1);
+    const int span = right - left;
+    uint32_t* sums = ConsoleArena_alloc(scratch, rowSize * sizeof(uint32_t));
+    ConsoleColour* colours = ConsoleArena_alloc(scratch, 2 * span * sizeof(ConsoleColour));
+
+    for (int row = top; row < bottom; row++)
+    {
+        // Box filter the upper and lower pixel rows: sum the source rows each covers, then average across columns
+        for (int half = 0; half < 2; half++)
+        {
+            const int pixelRow = 2 * (row - y) + half;
+            const int y0 = (int)((int64_t)pixelRow * image->height / (2 * height));
+            const int y1 = max((int)((int64_t)(pixelRow + 1) * image->height / (2 * height)), y0 + 1);
+
+            memset(sums, 0, rowSize * sizeof(uint32_t));
+            for (int sourceY = y0; sourceY < y1; sourceY++)
+            {
+                Console_sumRow(sums, &image->pixels[(size_t)sourceY * image->stride], rowSize);
+            }
+
+            Console_resolveImageRow(image, sums, y1 - y0, width, left - x, right - x, &colours[half * span]);
+        }
+
+        // Cells whose pixels match are blank, which the presenter can send as a repeat
+        ConsoleCell* cells = &consoleBuffer->_cells[row * consoleBuffer->width + left];
+        for (int i = 0; i < span; i++)
+        {
+            const int foreground = Console_attribTable[Console_colourIndex(colours[i])];
+            const int background = Console_attribTable[Console_colourIndex(colours[span + i])];
+            cells[i] = (colours[i] == colours[span + i]) ? CONSOLE_CELL(' ', background << 4) : CONSOLE_CELL(CONSOLE_CHAR_BLOCK_UPPER, foreground | (background << 4));
+        }
+
+        if (consoleBuffer->_foregrounds)
+        {
+            memcpy(&consoleBuffer->_foregrounds[row * consoleBuffer->width + left], colours, span * sizeof(ConsoleColour));
+            memcpy(&consoleBuffer->_backgrounds[row * consoleBuffer->width + left], &colours[span], span * sizeof(ConsoleColour));
+        }
+    }
+}
+
+void ConsoleBuffer_clear(ConsoleBuffer* consoleBuffer, char c, DWORD attrib)
+{
+    int bufferSize = consoleBuffer->width * consoleBuffer->height;
+
+    consoleBuffer->_scrollDy = 0;
+    ConsoleBuffer_markDirty(consoleBuffer, 0, 0, consoleBuffer->width, consoleBuffer->height);
+
+    if (consoleBuffer->_foregrounds)
+    {
+        Console_fillColours(consoleBuffer->_foregrounds, CONSOLE_COLOUR_ATTRIB, bufferSize);
+        Console_fillColours(consoleBuffer->_backgrounds, CONSOLE_COLOUR_ATTRIB, bufferSize);
+    }
+
+    ConsoleCell cell = CONSOLE_CELL(c, attrib);
+
+    // Both bytes of the cell match for e.g. a zeroed clear, so it can be filled byte-wise
+    if ((cell & 0xFF) == (cell >> 8))
+    {
+        memset(consoleBuffer->_cells, cell & 0xFF, bufferSize * sizeof(ConsoleCell));
+        return;
+    }
+
+    Console_fillCells(consoleBuffer->_cells, cell, bufferSize);
+}
+
+//
+// --- Console
+//
+
+// Implemented by each platform backend below
+static void Console_restoreTerminal(Console* console);
+static void Console_readEvents(Console* console);
+static void Console_writeOutput(Console* console, const char* bytes, size_t size);
+static void Console_clearTerminal(Console* console, WORD attrib);
+static void Console_presentFrame(Console* console);
+static char Console_waitInput(Console* console, int timeoutMs);
+
+void Console_destroy(Console* console)
+{
+    Console_clearWindow(console, 0);
+
+    if (!console->_headless)
+    {
+        Console_restoreTerminal(console);
+    }
+
+    ConsoleBuffer_destroy(&console->consoleBuffer);
+    ConsoleBuffer_destroy(&console->_frontBuffer);
+
+    free(console->_events);
+    free(console->_eventTimes);
+    free(console->_outputBuffer);
+    free(console->_rowColours);
+}
+
+void Console_refreshEvents(Console* console)
+{
+    // Edges are latched while events are consumed, so a press and release within one frame still show up
+    console->_leftMouseJustPressed = 0;
+    console->_leftMouseJustReleased = 0;
+    console->_rightMouseJustPressed = 0;
+    console->_rightMouseJustReleased = 0;
+
+    CONSOLE_PROFILE_BEGIN();
+
+    if (console->_inputSource.read)
+    {
+        console->_inputSource.read(console->_inputSource.userData, console);
+    }
+    else if (!console->_headless)
+    {
+        Console_readEvents(console);
+    }
+
+    CONSOLE_PROFILE_END(console, CONSOLE_PROFILE_REFRESH);
+}
+
+void Console_setInputSource(Console* console, const ConsoleInputSource* source)
+{
+    if (source)
+    {
+        console->_inputSource = *source;
+    }
+    else
+    {
+        memset(&console->_inputSource, 0, sizeof(console->_inputSource));
+    }
+}
+
+static char Console_isMouseMove(const ConsoleEvent* event)
+{
+    return event->EventType == MOUSE_EVENT && event->Event.MouseEvent.dwEventFlags == MOUSE_MOVED;
+}
+
+// Adds an event read from the terminal, merging it into the previous one if both are mouse moves
+// with the same buttons and modifiers. Events arriving while the ring is full are dropped and counted
+void Console_pushEvent(Console* console, const ConsoleEvent* event, double time)
+{
+    if (Console_isMouseMove(event) && console->_eventTail != console->_eventHead)
+    {
+        uint32_t lastIndex = (console->_eventTail - 1) & (CONSOLE_EVENT_CAPACITY - 1);
+        ConsoleEvent* last = &console->_events[lastIndex];
+        if (Console_isMouseMove(last) && last->Event.MouseEvent.dwButtonState == event->Event.MouseEvent.dwButtonState &&
+            last->Event.MouseEvent.dwControlKeyState == event->Event.MouseEvent.dwControlKeyState)
+        {
+            last->Event.MouseEvent.dwMousePosition = event->Event.MouseEvent.dwMousePosition;
+            console->_eventTimes[lastIndex] = time;
+            return;
+        }
+    }
+
+    if (console->_eventTail - console->_eventHead == CONSOLE_EVENT_CAPACITY)
+    {
+        console->_droppedEvents++;
+        return;
+    }
+
+    uint32_t index = console->_eventTail++ & (CONSOLE_EVENT_CAPACITY - 1);
+    console->_events[index] = *event;
+    console->_eventTimes[index] = time;
+}
+
+const ConsoleEvent* Console_peekEvent(const Console* console)
+{
+    if (console->_eventHead == console->_eventTail)
+    {
+        return NULL;
+    }
+
+    return &console->_events[console->_eventHead & (CONSOLE_EVENT_CAPACITY - 1)];
+}
+
+void Console_consumeEvent(Console* console)
+{
+    const ConsoleEvent* consoleEvent = Console_peekEvent(console);
+    if (!consoleEvent) return;
+
+    console->_eventHead++;
+    CONSOLE_PROFILE_COUNT(console, events, 1);
+
+    if (consoleEvent->EventType == KEY_EVENT)
+    {
+        console->_keysPressed[consoleEvent->Event.KeyEvent.wVirtualKeyCode] = consoleEvent->Event.KeyEvent.bKeyDown;
+    }
+
+    if (consoleEvent->EventType == MOUSE_EVENT)
+    {
+        console->_mousePos.X = min(consoleEvent->Event.MouseEvent.dwMousePosition.X, console->consoleBuffer.width - 1);
+        console->_mousePos.Y = min(consoleEvent->Event.MouseEvent.dwMousePosition.Y, console->consoleBuffer.height - 1);
+
+        char left = (consoleEvent->Event.MouseEvent.dwButtonState & FROM_LEFT_1ST_BUTTON_PRESSED) != 0;
+        char right = (consoleEvent->Event.MouseEvent.dwButtonState & RIGHTMOST_BUTTON_PRESSED) != 0;
+        console->_leftMouseJustPressed |= left && !console->_leftMousePressed;
+        console->_leftMouseJustReleased |= !left && console->_leftMousePressed;
+        console->_rightMouseJustPressed |= right && !console->_rightMousePressed;
+        console->_rightMouseJustReleased |= !right && console->_rightMousePressed;
+        console->_leftMousePressed = left;
+        console->_rightMousePressed = right;
+    }
+}
+
+int Console_pollEvent(Console* console, ConsoleEvent* consoleEvent)
+{
+    const ConsoleEvent* next = Console_peekEvent(console);
+    if (!next)
+    {
+        return 0;
+    }
+
+    CONSOLE_PROFILE_BEGIN();
+
+    *consoleEvent = *next;
+    Console_consumeEvent(console);
+
+    CONSOLE_PROFILE_END(console, CONSOLE_PROFILE_POLL);
+    return 1;
+}
+
+double Console_getEventTime(const Console* console)
+{
+    if (console->_eventHead == console->_eventTail)
+    {
+        return 0;
+    }
+
+    return console->_eventTimes[console->_eventHead & (CONSOLE_EVENT_CAPACITY - 1)];
+}
+
+uint32_t Console_getDroppedEventCount(const Console* console)
+{
+    return console->_droppedEvents;
+}
+
+int Console_getMouseX(const Console* console)
+{
+    return console->_mousePos.X;
+}
+
+int Console_getMouseY(const Console* console)
+{
+    return console->_mousePos.Y;
+}
+
+char Console_isLeftMousePressed(const Console* console)
+{
+    return console->_leftMousePressed;
+}
+
+char Console_isLeftMouseJustPressed(const Console* console)
+{
+    return console->_leftMouseJustPressed;
+}
+
+char Console_isLeftMouseJustReleased(const Console* console)
+{
+    return console->_leftMouseJustReleased;
+}
+
+char Console_isRightMousePressed(const Console* console)
+{
+    return console->_rightMousePressed;
+}
+
+char Console_isRightMouseJustPressed(const Console* console)
+{
+    return console->_rightMouseJustPressed;
+}
+
+char Console_isRightMouseJustReleased(const Console* console)
+{
+    return console->_rightMouseJustReleased;
+}
+
+char Console_isKeyPressed(const Console* console, uint8_t key)
+{
+    return console->_keysPressed[key];
+}
+
+void Console_setDiffPresent(Console* console, char enabled)
+{
+    console->_diffPresent = enabled;
+    Console_invalidate(console);
+}
+
+void Console_invalidate(Console* console)
+{
+    console->_frontBufferValid = 0;
+}
+
+void Console_setRepeatEnabled(Console* console, char enabled)
+{
+    console->_repeatEnabled = enabled;
+}
+
+// Returns the index of the first cell in [start, end) that differs, or end if none do
+static int Console_findChanged(const ConsoleCell* back, const ConsoleCell* front, int start, int end)
+{
+    int i = start;
+
+    // Compare four cells per 64-bit word
+    for (; i + 4 <= end; i += 4)
+    {
+        uint64_t backWord;
+        uint64_t frontWord;
+        memcpy(&backWord, &back[i], sizeof(backWord));
+        memcpy(&frontWord, &front[i], sizeof(frontWord));
+        if (backWord != frontWord) break;
+    }
+
+    for (; i < end; i++)
+    {
+        if (back[i] != front[i]) return i;
+    }
+
+    return end;
+}
+
+void Console_setColourMode(Console* console, ConsoleColourMode mode)
+{
+#ifdef _WIN32
+    // The Windows console is written as CHAR_INFO, which only has the attribute colours
+    if (!console->_headless) mode = CONSOLE_COLOUR_MODE_16;
+#endif
+
+    if (mode == console->_colourMode) return;
+    console->_colourMode = mode;
+    Console_invalidate(console);
+}
+
+ConsoleColourMode Console_getColourMode(const Console* console)
+{
+    return console->_colourMode;
+}
+
+// A row of cells with the colour codes they are shown in. Without colour planes the codes are the attribute colours
+typedef struct ConsoleRow
+{
+    const ConsoleCell* cells;
+    const ConsoleColour* foregrounds;
+    const ConsoleColour* backgrounds;
+} ConsoleRow;
+
+static int Console_getRowForeground(const ConsoleRow* row, int x)
+{
+    return row->foregrounds ? (int)row->foregrounds[x] : CONSOLE_CELL_ATTRIB(row->cells[x]) & 0xF;
+}
+
+static int Console_getRowBackground(const ConsoleRow* row, int x)
+{
+    return row->backgrounds ? (int)row->backgrounds[x] : (CONSOLE_CELL_ATTRIB(row->cells[x]) >> 4) & 0xF;
+}
+
+static int Console_rowCellDiffers(const ConsoleRow* back, const ConsoleRow* front, int x)
+{
+    if (back->cells[x] != front->cells[x]) return 1;
+    return back->foregrounds && (back->foregrounds[x] != front->foregrounds[x] || back->backgrounds[x] != front->backgrounds[x]);
+}
+
+// As Console_findChanged, also comparing colour codes
+static int Console_findChangedInRow(const ConsoleRow* back, const ConsoleRow* front, int start, int end)
+{
+    int x = Console_findChanged(back->cells, front->cells, start, end);
+    if (!back->foregrounds) return x;
+
+    for (int i = start; i < x; i++)
+    {
+        if (back->foregrounds[i] != front->foregrounds[i] || back->backgrounds[i] != front->backgrounds[i]) return i;
+    }
+
+    return x;
+}
+
+// The first cell in [start, end) shown the same in both rows, or end. Loops are kept separate for rows without colours,
+// which most rows are
+static int Console_findUnchangedInRow(const ConsoleRow* back, const ConsoleRow* front, int start, int end)
+{
+    const ConsoleCell* backCells = back->cells;
+    const ConsoleCell* frontCells = front->cells;
+    int x = start;
+
+    if (!back->foregrounds)
+    {
+        while (x < end && backCells[x] != frontCells[x]) x++;
+        return x;
+    }
+
+    while (x < end && Console_rowCellDiffers(back, front, x)) x++;
+    return x;
+}
+
+// Whether cells [start, end) of both rows are shown the same
+static int Console_rowSpansMatch(const ConsoleRow* back, const ConsoleRow* front, int start, int end)
+{
+    if (memcmp(&back->cells[start], &front->cells[start], (end - start) * sizeof(ConsoleCell)) != 0) return 0;
+    if (!back->foregrounds) return 1;
+
+    return memcmp(&back->foregrounds[start], &front->foregrounds[start], (end - start) * sizeof(ConsoleColour)) == 0 &&
+        memcmp(&back->backgrounds[start], &front->backgrounds[start], (end - start) * sizeof(ConsoleColour)) == 0;
+}
+
+// Front buffers have colour planes while the back buffer does, and the window is redrawn when that changes
+static void Console_matchColourPlanes(Console* console)
+{
+    const char enabled = console->consoleBuffer._foregrounds != NULL;
+    if (enabled == (console->_frontBuffer._foregrounds != NULL)) return;
+
+    ConsoleBuffer_setColourPlanes(&console->_frontBuffer, enabled);
+    if (enabled && !console->_rowColours)
+    {
+        console->_rowColours = malloc(2 * console->consoleBuffer.width * sizeof(ConsoleColour));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+    console->_frontBufferValid = 0;
+}
+
+// Row y of the back buffer, with the colour codes of cells [start, end) quantized into _rowColours if it has colour planes
+static ConsoleRow Console_resolveRow(Console* console, int y, int start, int end)
+{
+    const ConsoleBuffer* back = &console->consoleBuffer;
+    const int offset = y * back->width;
+
+    ConsoleRow row = {&back->_cells[offset], NULL, NULL};
+    if (!back->_foregrounds) return row;
+
+    ConsoleColour* foregrounds = console->_rowColours;
+    ConsoleColour* backgrounds = &console->_rowColours[back->width];
+    for (int x = start; x < end; x++)
+    {
+        const int attrib = CONSOLE_CELL_ATTRIB(row.cells[x]);
+        const ConsoleColour foreground = back->_foregrounds[offset + x];
+        const ConsoleColour background = back->_backgrounds[offset + x];
+
+        foregrounds[x] = foreground == CONSOLE_COLOUR_ATTRIB ? (attrib & 0xF) : Console_quantizeColour(console->_colourMode, foreground);
+        backgrounds[x] = background == CONSOLE_COLOUR_ATTRIB ? ((attrib >> 4) & 0xF) : Console_quantizeColour(console->_colourMode, background);
+    }
+
+    row.foregrounds = foregrounds;
+    row.backgrounds = backgrounds;
+    return row;
+}
+
+static ConsoleRow Console_getFrontRow(const Console* console, int y)
+{
+    const ConsoleBuffer* front = &console->_frontBuffer;
+    const int offset = y * front->width;
+
+    ConsoleRow row = {&front->_cells[offset], NULL, NULL};
+    if (front->_foregrounds)
+    {
+        row.foregrounds = &front->_foregrounds[offset];
+        row.backgrounds = &front->_backgrounds[offset];
+    }
+    return row;
+}
+
+// Records cells [start, end) of row y as shown
+static void Console_storeFrontRow(Console* console, const ConsoleRow* row, int y, int start, int end)
+{
+    ConsoleBuffer* front = &console->_frontBuffer;
+    const int offset = y * front->width;
+
+    memcpy(&front->_cells[offset + start], &row->cells[start], (end - start) * sizeof(ConsoleCell));
+    if (!row->foregrounds) return;
+
+    memcpy(&front->_foregrounds[offset + start], &row->foregrounds[start], (end - start) * sizeof(ConsoleColour));
+    memcpy(&front->_backgrounds[offset + start], &row->backgrounds[start], (end - start) * sizeof(ConsoleColour));
+}
+
+static void Console_reportChange(Console* console, int y, int start, int end)
+{
+    if (console->_changeSink) console->_changeSink(console->_changeSinkData, y, start, end);
+}
+
+// Takes the scroll recorded in the back buffer, returning 0 if there is none or the window is being redrawn anyway
+static int Console_takeScroll(Console* console, ConsoleRect* rect, int* dy)
+{
+    ConsoleBuffer* back = &console->consoleBuffer;
+    *rect = back->_scrollRect;
+    *dy = back->_scrollDy;
+    back->_scrollDy = 0;
+
+    return *dy != 0 && console->_diffPresent && console->_frontBufferValid;
+}
+
+// Repeats a scroll of the window in the front buffer. Returns the rows it exposed in top and bottom, which the caller writes
+static void Console_scrollFrontBuffer(Console* console, ConsoleRect rect, int dy, int* top, int* bottom)
+{
+    ConsoleBuffer* front = &console->_frontBuffer;
+    Console_shiftRows(front->_cells, sizeof(ConsoleCell), front->width, rect, dy);
+    if (front->_foregrounds)
+    {
+        Console_shiftRows(front->_foregrounds, sizeof(ConsoleColour), front->width, rect, dy);
+        Console_shiftRows(front->_backgrounds, sizeof(ConsoleColour), front->width, rect, dy);
+    }
+
+    *top = dy < 0 ? rect.bottom + dy : rect.top;
+    *bottom = dy < 0 ? rect.bottom : rect.top + dy;
+
+    // The rows that moved changed on the window too, the exposed ones are reported as they are written
+    for (int y = rect.top; y < rect.bottom; y++)
+    {
+        if (y < *top || y >= *bottom) Console_reportChange(console, y, rect.left, rect.right);
+    }
+}
+
+//
+// --- VT escape sequence output, used by the POSIX and headless backends
+//
+
+// Windows colour bits are blue, green, red; ANSI colour numbers are red, green, blue
+static const int CONSOLE_ANSI_COLOURS[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+static void Console_reserveOutput(Console* console, size_t size)
+{
+    if (console->_outputSize + size <= console->_outputCapacity) return;
+
+    size_t capacity = max(console->_outputCapacity * 2, console->_outputSize + size);
+    console->_outputBuffer = realloc(console->_outputBuffer, capacity);
+    CONSOLE_PROFILE_ALLOCATION();
+    console->_outputCapacity = capacity;
+}
+
+static void Console_appendBytes(Console* console, const char* bytes, size_t size)
+{
+    Console_reserveOutput(console, size);
+    memcpy(&console->_outputBuffer[console->_outputSize], bytes, size);
+    console->_outputSize += size;
+}
+
+static void Console_appendNumber(Console* console, int value)
+{
+    char digits[12];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    Console_reserveOutput(console, count);
+    while (count > 0)
+    {
+        console->_outputBuffer[console->_outputSize++] = digits[--count];
+    }
+}
+
+static void Console_appendString(Console* console, const char* string)
+{
+    Console_appendBytes(console, string, strlen(string));
+}
+
+static int Console_numberLength(int value)
+{
+    int length = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        length++;
+    }
+    return length;
+}
+
+static int Console_encodeNumber(char* out, int value)
+{
+    int length = Console_numberLength(value);
+    for (int i = length - 1; i >= 0; i--)
+    {
+        out[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return length;
+}
+
+// Encodes CSI n final, leaving out n when it is 1 as that is the default for cursor sequences
+static int Console_encodeCSI(char* out, int n, char final)
+{
+    int length = 0;
+    out[length++] = '\x1b';
+    out[length++] = '[';
+    if (n != 1) length += Console_encodeNumber(&out[length], n);
+    out[length++] = final;
+    return length;
+}
+
+static int Console_encodeColumnMove(int fromX, int x, char* out)
+{
+    char candidate[16];
+    int length;
+
+    // Absolute column, works from any state
+    int bestLength = Console_encodeCSI(out, x + 1, 'G');
+
+    if (fromX == x) return 0;
+
+    if (x == 0)
+    {
+        out[0] = '\r';
+        return 1;
+    }
+
+    // Carriage return then forwards
+    candidate[0] = '\r';
+    length = 1 + Console_encodeCSI(&candidate[1], x, 'C');
+    if (length < bestLength)
+    {
+        memcpy(out, candidate, length);
+        bestLength = length;
+    }
+
+    if (fromX < 0) return bestLength;
+
+    if (x > fromX)
+    {
+        length = Console_encodeCSI(candidate, x - fromX, 'C');
+    }
+    else if (fromX - x == 1)
+    {
+        candidate[0] = '\b';
+        length = 1;
+    }
+    else
+    {
+        length = Console_encodeCSI(candidate, fromX - x, 'D');
+    }
+
+    if (length < bestLength)
+    {
+        memcpy(out, candidate, length);
+        bestLength = length;
+    }
+
+    return bestLength;
+}
+
+static int Console_encodeRowMove(int fromY, int y, char* out)
+{
+    if (fromY == y) return 0;
+
+    // Absolute row
+    int bestLength = Console_encodeCSI(out, y + 1, 'd');
+
+    char candidate[16];
+    int length;
+
+    if (y > fromY)
+    {
+        // Line feeds only move down in raw mode, and never scroll as the target row is on screen
+        length = y - fromY;
+        if (length <= 3)
+        {
+            memset(candidate, '\n', length);
+        }
+        else
+        {
+            length = Console_encodeCSI(candidate, y - fromY, 'B');
+        }
+    }
+    else
+    {
+        length = Console_encodeCSI(candidate, fromY - y, 'A');
+    }
+
+    if (length < bestLength)
+    {
+        memcpy(out, candidate, length);
+        bestLength = length;
+    }
+
+    return bestLength;
+}
+
+// Encodes the shortest sequence found that moves the cursor from its tracked position to (x, y)
+static int Console_encodeCursorMove(const Console* console, int x, int y, char* out)
+{
+    const int fromX = console->_cursorX;
+    const int fromY = console->_cursorY;
+
+    if (fromX == x && fromY == y) return 0;
+
+    int bestLength = 0;
+    out[bestLength++] = '\x1b';
+    out[bestLength++] = '[';
+    if (y > 0 || x > 0) bestLength += Console_encodeNumber(&out[bestLength], y + 1);
+    if (x > 0)
+    {
+        out[bestLength++] = ';';
+        bestLength += Console_encodeNumber(&out[bestLength], x + 1);
+    }
+    out[bestLength++] = 'H';
+
+    if (fromY < 0) return bestLength;
+
+    char candidate[32];
+    int length = Console_encodeRowMove(fromY, y, candidate);
+    length += Console_encodeColumnMove(fromX, x, &candidate[length]);
+
+    if (length < bestLength)
+    {
+        memcpy(out, candidate, length);
+        bestLength = length;
+    }
+
+    return bestLength;
+}
+
+static void Console_appendCursorMove(Console* console, int x, int y)
+{
+    Console_reserveOutput(console, 32);
+    console->_outputSize += Console_encodeCursorMove(console, x, y, &console->_outputBuffer[console->_outputSize]);
+
+    console->_cursorX = x;
+    console->_cursorY = y;
+}
+
+static int Console_isBlank(char c)
+{
+    return c == ' ' || c == 0;
+}
+
+// Encodes a character outside ASCII. Block characters of code page 437 become their UTF-8 equivalents, U+2580 to U+2593,
+// other characters are sent as they are
+static int Console_encodeGlyph(char c, char* out)
+{
+    int code;
+    switch ((uint8_t)c)
+    {
+    case 0xB0: code = 0x91; break;
+    case 0xB1: code = 0x92; break;
+    case 0xB2: code = 0x93; break;
+    case 0xDB: code = 0x88; break;
+    case 0xDC: code = 0x84; break;
+    case 0xDD: code = 0x8C; break;
+    case 0xDE: code = 0x90; break;
+    case 0xDF: code = 0x80; break;
+    default: out[0] = c; return 1;
+    }
+
+    out[0] = '\xE2';
+    out[1] = '\x96';
+    out[2] = (char)code;
+    return 3;
+}
+
+// Longest SGR sequence Console_encodeColours writes, setting both colours to RGB
+#define CONSOLE_SGR_MAX 40
+
+// The colour codes the terminal needs for cell x. Blank cells only show their background, so they keep the current foreground
+static void Console_requiredColours(const Console* console, const ConsoleRow* row, int x, int* foreground, int* background)
+{
+    *foreground = Console_getRowForeground(row, x);
+    *background = Console_getRowBackground(row, x);
+
+    if (Console_isBlank(CONSOLE_CELL_CHAR(row->cells[x])) && console->_currentForeground >= 0)
+    {
+        *foreground = console->_currentForeground;
+    }
+}
+
+// Encodes the SGR parameters selecting a colour code, with base 30 for foregrounds and 40 for backgrounds
+static int Console_encodeColour(int code, int base, char* out)
+{
+    int length = 0;
+
+    if (code & (CONSOLE_CODE_RGB | CONSOLE_CODE_PALETTE))
+    {
+        length += Console_encodeNumber(&out[length], base + 8);
+        out[length++] = ';';
+
+        if (!(code & CONSOLE_CODE_RGB))
+        {
+            out[length++] = '5';
+            out[length++] = ';';
+            return length + Console_encodeNumber(&out[length], code & 0xFF);
+        }
+
+        out[length++] = '2';
+        for (int shift = 16; shift >= 0; shift -= 8)
+        {
+            out[length++] = ';';
+            length += Console_encodeNumber(&out[length], (code >> shift) & 0xFF);
+        }
+        return length;
+    }
+
+    return Console_encodeNumber(out, ((code & 0x8) ? base + 60 : base) + CONSOLE_ANSI_COLOURS[code & 0x7]);
+}
+
+// Encodes the colours that differ between the current and wanted ones, or nothing if they match. Colours are compared
+// as sent, after quantization, so colours that quantize the same are not sent again
+static int Console_encodeColours(int currentForeground, int currentBackground, int foreground, int background, char* out)
+{
+    if (currentForeground == foreground && currentBackground == background) return 0;
+
+    int length = 0;
+    out[length++] = '\x1b';
+    out[length++] = '[';
+
+    if (currentForeground != foreground)
+    {
+        length += Console_encodeColour(foreground, 30, &out[length]);
+    }
+
+    if (currentBackground != background)
+    {
+        if (length > 2) out[length++] = ';';
+        length += Console_encodeColour(background, 40, &out[length]);
+    }
+
+    out[length++] = 'm';
+    return length;
+}
+
+static void Console_appendColours(Console* console, int foreground, int background)
+{
+    if (foreground == console->_currentForeground && background == console->_currentBackground) return;
+
+    Console_reserveOutput(console, CONSOLE_SGR_MAX);
+    console->_outputSize += Console_encodeColours(console->_currentForeground, console->_currentBackground, foreground, background, &console->_outputBuffer[console->_outputSize]);
+    console->_currentForeground = foreground;
+    console->_currentBackground = background;
+}
+
+static void Console_flushOutput(Console* console)
+{
+    CONSOLE_PROFILE_BEGIN();
+    CONSOLE_PROFILE_COUNT(console, bytes, console->_outputSize);
+
+    if (console->_headless)
+    {
+        if (console->_outputFunc)
+        {
+            console->_outputFunc(console->_outputUserData, console->_outputBuffer, console->_outputSize);
+        }
+    }
+    else
+    {
+        Console_writeOutput(console, console->_outputBuffer, console->_outputSize);
+    }
+
+    console->_outputSize = 0;
+    CONSOLE_PROFILE_END(console, CONSOLE_PROFILE_WRITE);
+}
+
+static void Console_clearWindowANSI(Console* console, WORD attrib)
+{
+    Console_appendColours(console, attrib & 0xF, (attrib >> 4) & 0xF);
+    Console_appendString(console, "\x1b[2J\x1b[H");
+    Console_flushOutput(console);
+
+    console->_cursorX = 0;
+    console->_cursorY = 0;
+}
+
+// Blank cells only need their background to match to look the same
+static int Console_cellsLookSame(const ConsoleRow* row, int a, int b)
+{
+    const ConsoleCell cellA = row->cells[a];
+    const ConsoleCell cellB = row->cells[b];
+    const char blank = Console_isBlank(CONSOLE_CELL_CHAR(cellA)) && Console_isBlank(CONSOLE_CELL_CHAR(cellB));
+
+    if (!row->foregrounds)
+    {
+        return blank ? (cellA & 0xF000) == (cellB & 0xF000) : cellA == cellB;
+    }
+
+    if (row->backgrounds[a] != row->backgrounds[b]) return 0;
+    return blank || (CONSOLE_CELL_CHAR(cellA) == CONSOLE_CELL_CHAR(cellB) && row->foregrounds[a] == row->foregrounds[b]);
+}
+
+// The end of the run of cells from start that look like cell start
+static int Console_findSameRunEnd(const ConsoleRow* row, int start, int end)
+{
+    const ConsoleCell* cells = row->cells;
+    int x = start + 1;
+
+    if (!row->foregrounds)
+    {
+        const ConsoleCell cell = cells[start];
+        if (!Console_isBlank(CONSOLE_CELL_CHAR(cell)))
+        {
+            while (x < end && cells[x] == cell) x++;
+            return x;
+        }
+
+        while (x < end && Console_isBlank(CONSOLE_CELL_CHAR(cells[x])) && (cells[x] & 0xF000) == (cell & 0xF000)) x++;
+        return x;
+    }
+
+    while (x < end && Console_cellsLookSame(row, x, start)) x++;
+    return x;
+}
+
+// Writes a character outside ASCII followed by repeats more of it
+static void Console_appendGlyphs(Console* console, char c, int repeats)
+{
+    char glyph[3];
+    const int length = Console_encodeGlyph(c, glyph);
+
+    Console_reserveOutput(console, (repeats + 1) * length + 16);
+    memcpy(&console->_outputBuffer[console->_outputSize], glyph, length);
+    console->_outputSize += length;
+
+    if (console->_repeatEnabled && repeats * length > 3 + Console_numberLength(repeats))
+    {
+        console->_outputSize += Console_encodeCSI(&console->_outputBuffer[console->_outputSize], repeats, 'b');
+        return;
+    }
+
+    for (int i = 0; i < repeats; i++)
+    {
+        memcpy(&console->_outputBuffer[console->_outputSize], glyph, length);
+        console->_outputSize += length;
+    }
+}
+
+// Writes cells [start, end) of a row, repeating runs of identical cells with REP where that is shorter
+static void Console_appendCells(Console* console, const ConsoleRow* row, int start, int end, int y)
+{
+    Console_appendCursorMove(console, start, y);
+    Console_reportChange(console, y, start, end);
+    CONSOLE_PROFILE_COUNT(console, cells, end - start);
+
+    int x = start;
+    while (x < end)
+    {
+        int foreground;
+        int background;
+        Console_requiredColours(console, row, x, &foreground, &background);
+        Console_appendColours(console, foreground, background);
+
+        int runEnd = Console_findSameRunEnd(row, x, end);
+
+        char c = CONSOLE_CELL_CHAR(row->cells[x]);
+        int repeats = runEnd - x - 1;
+
+        if ((uint8_t)c >= 0x80)
+        {
+            Console_appendGlyphs(console, c, repeats);
+            x = runEnd;
+            continue;
+        }
+
+        Console_reserveOutput(console, runEnd - x + 16);
+        console->_outputBuffer[console->_outputSize++] = (c == 0) ? ' ' : c;
+
+        if (console->_repeatEnabled && repeats > 3 + Console_numberLength(repeats))
+        {
+            console->_outputSize += Console_encodeCSI(&console->_outputBuffer[console->_outputSize], repeats, 'b');
+        }
+        else
+        {
+            memset(&console->_outputBuffer[console->_outputSize], (c == 0) ? ' ' : c, repeats);
+            console->_outputSize += repeats;
+        }
+
+        x = runEnd;
+    }
+
+    // After the last column the cursor waits to wrap, or on a terminal wider than the buffer sits one column on, so only
+    // the row is known
+    console->_cursorX = end < console->consoleBuffer.width ? end : -1;
+    console->_cursorY = y;
+}
+
+// Bytes needed to rewrite unchanged cells [start, end) in place of a cursor move, stopping early once over limit
+static int Console_gapCost(const Console* console, const ConsoleRow* row, int start, int end, int limit)
+{
+    char sequence[CONSOLE_SGR_MAX];
+    int currentForeground = console->_currentForeground;
+    int currentBackground = console->_currentBackground;
+    int cost = 0;
+
+    for (int x = start; x < end && cost <= limit; x++)
+    {
+        const char c = CONSOLE_CELL_CHAR(row->cells[x]);
+        int foreground = Console_getRowForeground(row, x);
+        int background = Console_getRowBackground(row, x);
+        if (Console_isBlank(c) && currentForeground >= 0) foreground = currentForeground;
+
+        cost += ((uint8_t)c >= 0x80 ? Console_encodeGlyph(c, sequence) : 1) + Console_encodeColours(currentForeground, currentBackground, foreground, background, sequence);
+        currentForeground = foreground;
+        currentBackground = background;
+    }
+
+    return cost;
+}
+
+// Encodes the changed cells of row y within [start, end)
+static void Console_encodeRow(Console* console, const ConsoleRow* back, const ConsoleRow* front, int y, int start, int end)
+{
+    int x = Console_findChangedInRow(back, front, start, end);
+    while (x < end)
+    {
+        int runEnd = Console_findUnchangedInRow(back, front, x + 1, end);
+
+        int next = Console_findChangedInRow(back, front, runEnd, end);
+
+        // Carry on through the unchanged gap if rewriting it is no longer than moving the cursor over it
+        while (next < end)
+        {
+            char move[32];
+            int moveCost = Console_encodeCursorMove(console, next, y, move);
+            if (Console_gapCost(console, back, runEnd, next, moveCost) > moveCost) break;
+
+            runEnd = Console_findUnchangedInRow(back, front, next + 1, end);
+            next = Console_findChangedInRow(back, front, runEnd, end);
+        }
+
+        Console_appendCells(console, back, x, runEnd, y);
+        x = next;
+    }
+}
+
+// Scrolls whole rows of the window with a scroll region, then writes the rows the scroll exposed
+static void Console_scrollANSI(Console* console, ConsoleRect rect, int dy)
+{
+    const int width = console->consoleBuffer.width;
+
+    Console_appendString(console, "\x1b[");
+    Console_appendNumber(console, rect.top + 1);
+    Console_appendString(console, ";");
+    Console_appendNumber(console, rect.bottom);
+    Console_appendString(console, "r");
+
+    Console_reserveOutput(console, 16);
+    console->_outputSize += Console_encodeCSI(&console->_outputBuffer[console->_outputSize], abs(dy), dy < 0 ? 'S' : 'T');
+
+    // Setting the scroll region moves the cursor home
+    Console_appendString(console, "\x1b[r");
+    console->_cursorX = 0;
+    console->_cursorY = 0;
+
+    int top;
+    int bottom;
+    Console_scrollFrontBuffer(console, rect, dy, &top, &bottom);
+
+    for (int y = top; y < bottom; y++)
+    {
+        ConsoleRow row = Console_resolveRow(console, y, 0, width);
+        Console_appendCells(console, &row, 0, width, y);
+        Console_storeFrontRow(console, &row, y, 0, width);
+    }
+}
+
+static void Console_displayANSI(Console* console)
+{
+    const ConsoleBuffer* back = &console->consoleBuffer;
+    const int width = back->width;
+    const int height = back->height;
+
+    const uint32_t mark = console->_presentMark;
+    console->_presentMark = ConsoleBuffer_takeDirtyMark(&console->consoleBuffer);
+    Console_matchColourPlanes(console);
+
+    // Scroll regions span whole rows, narrower scrolls are left to the diff
+    ConsoleRect scrollRect;
+    int scrollDy;
+    if (Console_takeScroll(console, &scrollRect, &scrollDy) && scrollRect.left == 0 && scrollRect.right == width)
+    {
+        Console_scrollANSI(console, scrollRect, scrollDy);
+    }
+
+    if (!console->_diffPresent || !console->_frontBufferValid)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            ConsoleRow row = Console_resolveRow(console, y, 0, width);
+            Console_appendCells(console, &row, 0, width, y);
+            Console_storeFrontRow(console, &row, y, 0, width);
+        }
+
+        console->_frontBufferValid = 1;
+    }
+    else
+    {
+        for (int y = 0; y < height; y++)
+        {
+            const ConsoleRow frontRow = Console_getFrontRow(console, y);
+
+            int start;
+            int end = 0;
+            while (ConsoleBuffer_nextDirtySpan(back, mark, y, end, &start, &end))
+            {
+                // Colours are quantized only for the spans that were written
+                const ConsoleRow backRow = Console_resolveRow(console, y, start, end);
+                if (Console_rowSpansMatch(&backRow, &frontRow, start, end)) continue;
+
+                Console_encodeRow(console, &backRow, &frontRow, y, start, end);
+                Console_storeFrontRow(console, &backRow, y, start, end);
+            }
+        }
+    }
+
+    Console_flushOutput(console);
+}
+
+Console Console_createHeadless(int width, int height, ConsoleOutputFunc output, void* userData)
+{
+    Console console;
+    memset(&console, 0, sizeof(console));
+
+    console.consoleBuffer = ConsoleBuffer_create(width, height);
+    console._frontBuffer = ConsoleBuffer_create(width, height);
+    console._diffPresent = 1;
+    console._events = malloc(CONSOLE_EVENT_CAPACITY * sizeof(ConsoleEvent));
+    CONSOLE_PROFILE_ALLOCATION();
+    console._eventTimes = malloc(CONSOLE_EVENT_CAPACITY * sizeof(double));
+    CONSOLE_PROFILE_ALLOCATION();
+
+    console._headless = 1;
+    console._outputFunc = output;
+    console._outputUserData = userData;
+    console._currentForeground = -1;
+    console._currentBackground = -1;
+    console._repeatEnabled = 1;
+    console._colourMode = CONSOLE_COLOUR_MODE_RGB;
+
+    Console_clearWindow(&console, 0);
+    CONSOLE_PROFILE_INIT(&console);
+
+    return console;
+}
+
+void Console_clearWindow(Console* console, WORD attrib)
+{
+    if (console->_headless)
+    {
+        Console_clearWindowANSI(console, attrib);
+    }
+    else
+    {
+        Console_clearTerminal(console, attrib);
+    }
+
+    Console_invalidate(console);
+}
+
+#ifdef CONSOLE_PROFILE
+static void Console_initProfile(Console* console)
+{
+    memset(&console->_profile, 0, sizeof(console->_profile));
+    console->_profile._frameStart = Console_getTime();
+    console->_profile._allocationsAtStart = ConsoleAtomic_load(&Console_profileAllocations);
+}
+
+void Console_profileAllocation(void)
+{
+    ConsoleAtomic_fetchAdd(&Console_profileAllocations, 1);
+}
+
+static void Console_endProfileFrame(Console* console, double now)
+{
+    ConsoleProfile* profile = &console->_profile;
+    double* phases = profile->_phaseSeconds;
+
+    const int allocations = ConsoleAtomic_load(&Console_profileAllocations);
+    profile->_counters.allocations = (uint32_t)allocations - (uint32_t)profile->_allocationsAtStart;
+
+    // Whatever the console's own phases and waiting do not account for was spent by the program
+    const double frameSeconds = now - profile->_frameStart - phases[CONSOLE_PROFILE_WAIT];
+    phases[CONSOLE_PROFILE_DRAW] = max(frameSeconds - phases[CONSOLE_PROFILE_REFRESH] - phases[CONSOLE_PROFILE_POLL] -
+        phases[CONSOLE_PROFILE_ENCODE] - phases[CONSOLE_PROFILE_WRITE], 0.0);
+
+    ConsoleProfileStats* last = &profile->_last;
+    memcpy(last->phaseSeconds, phases, sizeof(last->phaseSeconds));
+    last->frameSeconds = frameSeconds;
+    last->counters = profile->_counters;
+    profile->_frameTimes[last->frames % CONSOLE_PROFILE_FRAMES] = (float)frameSeconds;
+    last->frames++;
+
+    memset(phases, 0, sizeof(profile->_phaseSeconds));
+    memset(&profile->_counters, 0, sizeof(profile->_counters));
+    profile->_frameStart = now;
+    profile->_allocationsAtStart = allocations;
+}
+
+static int Console_compareFloats(const void* a, const void* b)
+{
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+#endif
+
+void Console_display(Console* console)
+{
+#ifdef CONSOLE_PROFILE
+    const double profileStart = Console_getTime();
+    const double writeBefore = console->_profile._phaseSeconds[CONSOLE_PROFILE_WRITE];
+    console->_profile._displayDepth++;
+#endif
+
+    if (console->_presenter.present)
+    {
+        console->_presenter.present(console->_presenter.userData, console);
+    }
+    else if (console->_headless)
+    {
+        Console_displayANSI(console);
+    }
+    else
+    {
+        Console_presentFrame(console);
+    }
+
+#ifdef CONSOLE_PROFILE
+    if (--console->_profile._displayDepth == 0)
+    {
+        const double now = Console_getTime();
+        const double writeSeconds = console->_profile._phaseSeconds[CONSOLE_PROFILE_WRITE] - writeBefore;
+        console->_profile._phaseSeconds[CONSOLE_PROFILE_ENCODE] += now - profileStart - writeSeconds;
+        Console_endProfileFrame(console, now);
+    }
+#endif
+}
+
+ConsoleProfileStats Console_getProfileStats(const Console* console)
+{
+    ConsoleProfileStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+#ifdef CONSOLE_PROFILE
+    stats = console->_profile._last;
+
+    const int count = (int)min(stats.frames, (uint64_t)CONSOLE_PROFILE_FRAMES);
+    if (count > 0)
+    {
+        float sorted[CONSOLE_PROFILE_FRAMES];
+        memcpy(sorted, console->_profile._frameTimes, count * sizeof(float));
+        qsort(sorted, count, sizeof(float), Console_compareFloats);
+
+        stats.frameP50 = sorted[(count - 1) / 2];
+        stats.frameP99 = sorted[(count - 1) * 99 / 100];
+        stats.frameMax = sorted[count - 1];
+    }
+#else
+    (void)console;
+#endif
+
+    return stats;
+}
+
+void Console_drawProfileOverlay(Console* console, int x, int y)
+{
+#ifdef CONSOLE_PROFILE
+    const ConsoleProfileStats stats = Console_getProfileStats(console);
+    const double* phases = stats.phaseSeconds;
+    const ConsoleProfileCounters* counters = &stats.counters;
+    char lines[3][80];
+
+    snprintf(lines[0], sizeof(lines[0]), "frame %6.2fms  p50 %6.2f  p99 %6.2f  max %6.2f", stats.frameSeconds * 1e3,
+        stats.frameP50 * 1e3, stats.frameP99 * 1e3, stats.frameMax * 1e3);
+    snprintf(lines[1], sizeof(lines[1]), "refresh %5.2f  poll %5.2f  draw %5.2f  encode %5.2f  write %5.2f",
+        phases[CONSOLE_PROFILE_REFRESH] * 1e3, phases[CONSOLE_PROFILE_POLL] * 1e3, phases[CONSOLE_PROFILE_DRAW] * 1e3,
+        phases[CONSOLE_PROFILE_ENCODE] * 1e3, phases[CONSOLE_PROFILE_WRITE] * 1e3);
+    snprintf(lines[2], sizeof(lines[2]), "cells %llu  bytes %llu  syscalls %llu  events %llu  allocs %llu",
+        (unsigned long long)counters->cells, (unsigned long long)counters->bytes, (unsigned long long)counters->syscalls,
+        (unsigned long long)counters->events, (unsigned long long)counters->allocations);
+
+    int width = 0;
+    for (int i = 0; i < 3; i++) width = max(width, (int)strlen(lines[i]));
+
+    ConsoleBuffer_drawRect(&console->consoleBuffer, x, y, width + 2, 3, ' ', 0x1F);
+    for (int i = 0; i < 3; i++) ConsoleBuffer_drawText(&console->consoleBuffer, lines[i], x + 1, y + i, 0x1F);
+#else
+    (void)console;
+    (void)x;
+    (void)y;
+#endif
+}
+
+void Console_setPresenter(Console* console, const ConsolePresenter* presenter)
+{
+    if (presenter)
+    {
+        console->_presenter = *presenter;
+    }
+    else
+    {
+        memset(&console->_presenter, 0, sizeof(console->_presenter));
+    }
+}
+
+Console Console_forkPresenter(const Console* console)
+{
+    const int width = console->consoleBuffer.width;
+    const int height = console->consoleBuffer.height;
+
+    // Handles and settings are shared, everything the presenter writes to is its own. A presenter set on the original, e.g.
+    // a recorder, is copied with them and now runs on the presenter's side
+    Console presenter = *console;
+    presenter.consoleBuffer = ConsoleBuffer_create(width, height);
+    presenter._frontBuffer = ConsoleBuffer_copy(&console->_frontBuffer);
+    presenter._outputBuffer = NULL;
+    presenter._outputSize = 0;
+    presenter._outputCapacity = 0;
+    presenter._rowColours = NULL;
+#ifdef _WIN32
+    presenter._presentCells = malloc(width * height * sizeof(CHAR_INFO));
+    CONSOLE_PROFILE_ALLOCATION();
+#endif
+
+    // Events stay with the original
+    presenter._events = NULL;
+    presenter._eventTimes = NULL;
+    memset(&presenter._inputSource, 0, sizeof(presenter._inputSource));
+    CONSOLE_PROFILE_INIT(&presenter);
+
+    return presenter;
+}
+
+void Console_joinPresenter(Console* console, Console* presenter)
+{
+    // The presenter's front buffer is what the window shows now. Cells the original has not written since its last
+    // present match it, so diffing against it stays correct
+    ConsoleBuffer_destroy(&console->_frontBuffer);
+    console->_frontBuffer = presenter->_frontBuffer;
+    console->_frontBufferValid = presenter->_frontBufferValid;
+    console->_cursorX = presenter->_cursorX;
+    console->_cursorY = presenter->_cursorY;
+    console->_currentForeground = presenter->_currentForeground;
+    console->_currentBackground = presenter->_currentBackground;
+
+    ConsoleBuffer_destroy(&presenter->consoleBuffer);
+    free(presenter->_outputBuffer);
+    free(presenter->_rowColours);
+#ifdef _WIN32
+    free(presenter->_presentCells);
+#endif
+}
+
+double Console_getTime()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+static void Console_sleep(int milliseconds)
+{
+#ifdef _WIN32
+    Sleep(milliseconds);
+#else
+    struct timespec time = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+    while (nanosleep(&time, &time) != 0 && errno == EINTR);
+#endif
+}
+
+char Console_waitEvents(Console* console, int timeoutMs)
+{
+    if (Console_peekEvent(console)) return 1;
+
+    CONSOLE_PROFILE_BEGIN();
+    char ready = 0;
+
+    if (console->_inputSource.wait)
+    {
+        ready = console->_inputSource.wait(console->_inputSource.userData, timeoutMs);
+    }
+    else if (console->_headless)
+    {
+        // Nothing ever arrives on a headless console, so it only waits out a finite timeout
+        if (timeoutMs > 0) Console_sleep(timeoutMs);
+    }
+    else
+    {
+        ready = Console_waitInput(console, timeoutMs);
+        CONSOLE_PROFILE_COUNT(console, syscalls, 1);
+    }
+
+    CONSOLE_PROFILE_END(console, CONSOLE_PROFILE_WAIT);
+    return ready;
+}
+
+//
+// --- Frame pacer
+//
+
+// Longest stretch of time one wait can add, so a stall does not turn into a burst of catch-up updates
+#define CONSOLE_PACER_MAX_ELAPSED 0.25
+
+ConsolePacer ConsolePacer_create(double updatesPerSecond, double presentsPerSecond)
+{
+    ConsolePacer pacer;
+    pacer._updateStep = updatesPerSecond > 0 ? 1.0 / updatesPerSecond : 0;
+    pacer._presentInterval = presentsPerSecond > 0 ? 1.0 / presentsPerSecond : 0;
+    pacer._accumulator = 0;
+    pacer._lastTime = Console_getTime();
+    pacer._nextPresent = pacer._lastTime;
+    pacer._updatedSincePresent = 1;
+    return pacer;
+}
+
+static void ConsolePacer_advance(ConsolePacer* pacer, double now)
+{
+    if (pacer->_updateStep > 0) pacer->_accumulator += min(now - pacer->_lastTime, CONSOLE_PACER_MAX_ELAPSED);
+    pacer->_lastTime = now;
 }
 
-void ConsoleBuffer_drawLine(ConsoleBuffer* consoleBuffer, int x1, int y1, int x2, int y2, char c, WORD attrib)
+void ConsolePacer_wait(ConsolePacer* pacer, Console* console)
 {
-    if (x2 - x1 == 0)
-    {
-        ConsoleBuffer_drawRect(consoleBuffer, x1, y1, 1, y2 - y1, c, attrib);
-        return;
-    }
+    double now = Console_getTime();
+    ConsolePacer_advance(pacer, now);
 
-    if (y2 - y1 == 0)
+    // Without updates or a present rate there is no deadline, so only input ends the wait
+    int timeoutMs = -1;
+    if (pacer->_updateStep > 0 || pacer->_presentInterval > 0)
     {
-        ConsoleBuffer_drawRect(consoleBuffer, x1, y1, x2 - x1, 1, c, attrib);
-        return;
+        double deadline = pacer->_presentInterval > 0 ? pacer->_nextPresent : now + pacer->_updateStep;
+        if (pacer->_updateStep > 0) deadline = min(deadline, now + pacer->_updateStep - pacer->_accumulator);
+        timeoutMs = deadline > now ? (int)ceil((deadline - now) * 1000) : 0;
     }
 
-    float grad = (float)(y2 - y1) / (float)(x2 - x1);
-    int xSign = (x2 - x1) >= 0 ? 1 : -1;
-    float xStep = (float)xSign / (float)max(abs(y2 - y1), abs(x2 - x1));
-    for (float i = 0; abs(i) < abs(x2 - x1); i += xStep)
+    if (timeoutMs != 0)
     {
-        float x = x1 + i;
-        int y = y1 + i * grad;
-        ConsoleBuffer_setChar(consoleBuffer, x, y, c);
-        ConsoleBuffer_setAttrib(consoleBuffer, x, y, attrib);
+        Console_waitEvents(console, timeoutMs);
+        ConsolePacer_advance(pacer, Console_getTime());
     }
+
+    Console_refreshEvents(console);
 }
 
-void ConsoleBuffer_clear(ConsoleBuffer* consoleBuffer, char c, DWORD attrib)
+char ConsolePacer_update(ConsolePacer* pacer)
 {
-    int bufferSize = consoleBuffer->width * consoleBuffer->height;
+    if (pacer->_updateStep <= 0 || pacer->_accumulator < pacer->_updateStep) return 0;
+
+    pacer->_accumulator -= pacer->_updateStep;
+    pacer->_updatedSincePresent = 1;
+    return 1;
+}
 
-    if (c == 0 && attrib == 0)
+char ConsolePacer_present(ConsolePacer* pacer)
+{
+    // Without a present rate, frames follow the updates, or every wait when there are none
+    if (pacer->_presentInterval <= 0)
     {
-        memset(consoleBuffer->_buffer, 0, bufferSize * sizeof(CHAR_INFO));
-        return;
+        char present = pacer->_updatedSincePresent || pacer->_updateStep <= 0;
+        pacer->_updatedSincePresent = 0;
+        return present;
     }
 
-    CHAR_INFO charInfo;
-    charInfo.Char.AsciiChar = c;
-    charInfo.Attributes = attrib;
+    double now = Console_getTime();
+    if (now < pacer->_nextPresent) return 0;
 
-    for (int i = 0; i < bufferSize; i++)
-    {
-        consoleBuffer->_buffer[i] = charInfo;
-    }
+    // Falling more than an interval behind restarts the schedule instead of presenting back to back
+    pacer->_nextPresent += pacer->_presentInterval;
+    if (pacer->_nextPresent < now) pacer->_nextPresent = now + pacer->_presentInterval;
+
+    pacer->_updatedSincePresent = 0;
+    return 1;
 }
 
+double ConsolePacer_getAlpha(const ConsolePacer* pacer)
+{
+    return pacer->_updateStep > 0 ? pacer->_accumulator / pacer->_updateStep : 0;
+}
+
+#ifdef _WIN32
+
+//
+// --- Windows console backend
+//
+
 Console Console_create(int width, int height, const char* title)
 {
     Console console;
     memset(&console, 0, sizeof(console));
 
     console.consoleBuffer = ConsoleBuffer_create(width, height);
+    console._frontBuffer = ConsoleBuffer_create(width, height);
+    console._diffPresent = 1;
+    console._events = malloc(CONSOLE_EVENT_CAPACITY * sizeof(ConsoleEvent));
+    CONSOLE_PROFILE_ALLOCATION();
+    console._eventTimes = malloc(CONSOLE_EVENT_CAPACITY * sizeof(double));
+    CONSOLE_PROFILE_ALLOCATION();
+
+    console._presentCells = malloc(width * height * sizeof(CHAR_INFO));
+    CONSOLE_PROFILE_ALLOCATION();
 
     console._writeHandle = GetStdHandle(STD_OUTPUT_HANDLE);
     console._readHandle = GetStdHandle(STD_INPUT_HANDLE);
@@ -183,20 +2899,14 @@ Console Console_create(int width, int height, const char* title)
     SetConsoleWindowInfo(console._writeHandle, TRUE, &windowSize);
 
     Console_clearWindow(&console, 0);
+    CONSOLE_PROFILE_INIT(&console);
 
     return console;
 }
 
-void Console_destroy(Console* console)
+static void Console_restoreTerminal(Console* console)
 {
-    Console_clearWindow(console, 0);
-
-    ConsoleBuffer_destroy(&console->consoleBuffer);
-
-    if (console->_eventBuffer)
-    {
-        free(console->_eventBuffer);
-    }
+    free(console->_presentCells);
 
     SetConsoleScreenBufferSize(console->_writeHandle, console->_previousBufferSize);
     SetConsoleWindowInfo(console->_writeHandle, TRUE, &console->_previousWindowSize);
@@ -205,119 +2915,598 @@ void Console_destroy(Console* console)
     SetConsoleCursorInfo(console->_writeHandle, &console->_previousCursorInfo);
 }
 
-void Console_refreshEvents(Console* console)
+static void Console_readEvents(Console* console)
 {
     DWORD numEvents;
     GetNumberOfConsoleInputEvents(console->_readHandle, &numEvents);
-    if (numEvents > 0)
+    CONSOLE_PROFILE_COUNT(console, syscalls, 1);
+
+    // Reads straight into the free part of the ring, in up to two pieces where it wraps. Anything that
+    // does not fit stays queued by the console for the next frame
+    while (numEvents > 0 && console->_eventTail - console->_eventHead < CONSOLE_EVENT_CAPACITY)
     {
-        if (console->_eventBuffer)
+        uint32_t start = console->_eventTail & (CONSOLE_EVENT_CAPACITY - 1);
+        uint32_t space = CONSOLE_EVENT_CAPACITY - (console->_eventTail - console->_eventHead);
+        DWORD count = min(numEvents, min(space, CONSOLE_EVENT_CAPACITY - start));
+
+        DWORD numRead = 0;
+        CONSOLE_PROFILE_COUNT(console, syscalls, 1);
+        if (!ReadConsoleInput(console->_readHandle, &console->_events[start], count, &numRead) || numRead == 0) break;
+        double time = Console_getTime();
+        numEvents -= numRead;
+
+        // Moves the new events back into place one at a time, so mouse moves are merged as they are on POSIX
+        for (DWORD i = 0; i < numRead; i++)
         {
-            console->_eventBuffer = realloc(console->_eventBuffer, numEvents * sizeof(INPUT_RECORD));
+            ConsoleEvent event = console->_events[(start + i) & (CONSOLE_EVENT_CAPACITY - 1)];
+            Console_pushEvent(console, &event, time);
         }
-        else
+    }
+}
+
+static char Console_waitInput(Console* console, int timeoutMs)
+{
+    return WaitForSingleObject(console->_readHandle, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs) == WAIT_OBJECT_0;
+}
+
+static void Console_writeOutput(Console* console, const char* bytes, size_t size)
+{
+    DWORD written;
+    WriteFile(console->_writeHandle, bytes, (DWORD)size, &written, NULL);
+    CONSOLE_PROFILE_COUNT(console, syscalls, 1);
+}
+
+static void Console_clearTerminal(Console* console, WORD attrib)
+{
+    CONSOLE_SCREEN_BUFFER_INFO bufferInfo;
+    DWORD cellCount;
+    DWORD written;
+    COORD home = {0, 0};
+    
+    GetConsoleScreenBufferInfo(console->_writeHandle, &bufferInfo);
+    cellCount = bufferInfo.dwSize.X * bufferInfo.dwSize.Y;
+    FillConsoleOutputCharacter(console->_writeHandle, ' ', cellCount, home, &written);
+    FillConsoleOutputAttribute(console->_writeHandle, attrib, cellCount, home, &written);
+    SetConsoleCursorPosition(console->_writeHandle, home);
+}
+
+// Gaps of unchanged cells shorter than this are written as part of a run, as a write call costs more than a few cells
+#define CONSOLE_DIFF_GAP_MAX 8
+
+// Once a frame needs this many separate writes, the remaining rows are written in one call instead
+#define CONSOLE_DIFF_RUNS_MAX 64
+
+// Returns the index one past the end of the changed run starting at start, absorbing short unchanged gaps
+static int Console_findRunEnd(const ConsoleRow* back, const ConsoleRow* front, int start, int end)
+{
+    int runEnd = start + 1;
+    int i = runEnd;
+
+    while (i < end)
+    {
+        if (Console_rowCellDiffers(back, front, i))
         {
-            console->_eventBuffer = malloc(numEvents * sizeof(INPUT_RECORD));
+            runEnd = ++i;
+            continue;
         }
 
-        ReadConsoleInput(console->_readHandle, console->_eventBuffer, numEvents, &console->_numEvents);
-        console->_eventIter = 0;
+        int next = Console_findChangedInRow(back, front, i, min(end, i + CONSOLE_DIFF_GAP_MAX));
+        if (next == min(end, i + CONSOLE_DIFF_GAP_MAX)) break;
+        i = next;
     }
 
-    console->_leftMousePressedLastFrame = console->_leftMousePressed;
-    console->_rightMousePressedLastFrame = console->_rightMousePressed;
+    return runEnd;
 }
 
-int Console_pollEvent(Console* console, ConsoleEvent* consoleEvent)
+// Writes a region of the back buffer to the window and records it in the front buffer
+static void Console_writeRegion(Console* console, int left, int top, int right, int bottom)
 {
-    if (console->_eventIter >= console->_numEvents)
+    CHAR_INFO* charInfo = console->_presentCells;
+
+    // Cells are only widened to CHAR_INFO for the region being written, with colours quantized to attribute colours
+    for (int y = top; y < bottom; y++)
     {
-        return 0;
+        const ConsoleRow row = Console_resolveRow(console, y, left, right);
+        for (int x = left; x < right; x++)
+        {
+            charInfo->Char.UnicodeChar = row.cells[x] & 0xFF;
+            charInfo->Attributes = (WORD)(Console_getRowForeground(&row, x) | (Console_getRowBackground(&row, x) << 4));
+            charInfo++;
+        }
+
+        Console_storeFrontRow(console, &row, y, left, right);
+        Console_reportChange(console, y, left, right);
     }
 
-    *consoleEvent= console->_eventBuffer[console->_eventIter];
-    console->_eventIter++;
-    
-    if (consoleEvent->EventType == KEY_EVENT)
+    COORD charBufSize = {right - left, bottom - top};
+    COORD characterPos = {0, 0};
+    SMALL_RECT writeArea = {left, top, right - 1, bottom - 1};
+
+    CONSOLE_PROFILE_COUNT(console, cells, (right - left) * (bottom - top));
+    CONSOLE_PROFILE_COUNT(console, bytes, (right - left) * (bottom - top) * sizeof(CHAR_INFO));
+    CONSOLE_PROFILE_COUNT(console, syscalls, 1);
+
+    CONSOLE_PROFILE_BEGIN();
+    WriteConsoleOutputA(console->_writeHandle, console->_presentCells, charBufSize, characterPos, &writeArea);
+    CONSOLE_PROFILE_END(console, CONSOLE_PROFILE_WRITE);
+}
+
+// Scrolls a rect of the window, then writes the rows the scroll exposed
+static void Console_scrollWindow(Console* console, ConsoleRect rect, int dy)
+{
+    SMALL_RECT scrollArea = {rect.left, rect.top, rect.right - 1, rect.bottom - 1};
+    COORD destination = {rect.left, rect.top + dy};
+    CHAR_INFO fill;
+    fill.Char.UnicodeChar = ' ';
+    fill.Attributes = 0;
+
+    CONSOLE_PROFILE_COUNT(console, syscalls, 1);
+    CONSOLE_PROFILE_BEGIN();
+    ScrollConsoleScreenBufferA(console->_writeHandle, &scrollArea, &scrollArea, destination, &fill);
+    CONSOLE_PROFILE_END(console, CONSOLE_PROFILE_WRITE);
+
+    int top;
+    int bottom;
+    Console_scrollFrontBuffer(console, rect, dy, &top, &bottom);
+    Console_writeRegion(console, rect.left, top, rect.right, bottom);
+}
+
+static void Console_presentFrame(Console* console)
+{
+    const ConsoleBuffer* back = &console->consoleBuffer;
+    const int width = back->width;
+    const int height = back->height;
+
+    const uint32_t mark = console->_presentMark;
+    console->_presentMark = ConsoleBuffer_takeDirtyMark(&console->consoleBuffer);
+    Console_matchColourPlanes(console);
+
+    ConsoleRect scrollRect;
+    int scrollDy;
+    if (Console_takeScroll(console, &scrollRect, &scrollDy))
     {
-        console->_keysPressed[consoleEvent->Event.KeyEvent.wVirtualKeyCode] = consoleEvent->Event.KeyEvent.bKeyDown;
+        Console_scrollWindow(console, scrollRect, scrollDy);
     }
 
-    if (consoleEvent->EventType == MOUSE_EVENT)
+    if (!console->_diffPresent || !console->_frontBufferValid)
     {
-        console->_mousePos.X = min(consoleEvent->Event.MouseEvent.dwMousePosition.X, console->consoleBuffer.width - 1);
-        console->_mousePos.Y = min(consoleEvent->Event.MouseEvent.dwMousePosition.Y, console->consoleBuffer.height - 1);
-        console->_leftMousePressed = consoleEvent->Event.MouseEvent.dwButtonState & FROM_LEFT_1ST_BUTTON_PRESSED;
-        console->_rightMousePressed = consoleEvent->Event.MouseEvent.dwButtonState & RIGHTMOST_BUTTON_PRESSED;
+        Console_writeRegion(console, 0, 0, width, height);
+        console->_frontBufferValid = 1;
+        return;
     }
 
-    return 1;
+    int runCount = 0;
+
+    for (int y = 0; y < height; y++)
+    {
+        const ConsoleRow frontRow = Console_getFrontRow(console, y);
+
+        int start;
+        int end = 0;
+        while (ConsoleBuffer_nextDirtySpan(back, mark, y, end, &start, &end))
+        {
+            ConsoleRow backRow = Console_resolveRow(console, y, start, end);
+            if (Console_rowSpansMatch(&backRow, &frontRow, start, end)) continue;
+
+            if (runCount >= CONSOLE_DIFF_RUNS_MAX)
+            {
+                Console_writeRegion(console, 0, y, width, height);
+                return;
+            }
+
+            int x = Console_findChangedInRow(&backRow, &frontRow, start, end);
+            while (x < end)
+            {
+                int runEnd = Console_findRunEnd(&backRow, &frontRow, x, end);
+
+                // Writing resolves the run's colours again into the same row colours, so backRow stays valid
+                Console_writeRegion(console, x, y, runEnd, y + 1);
+                runCount++;
+
+                x = Console_findChangedInRow(&backRow, &frontRow, runEnd, end);
+            }
+        }
+    }
 }
 
-int Console_getMouseX(const Console* console)
+#else
+
+//
+// --- POSIX terminal backend (termios raw mode, VT escape sequences, xterm SGR mouse reporting)
+//
+
+Console Console_create(int width, int height, const char* title)
 {
-    return console->_mousePos.X;
+    Console console;
+    memset(&console, 0, sizeof(console));
+
+    console.consoleBuffer = ConsoleBuffer_create(width, height);
+    console._frontBuffer = ConsoleBuffer_create(width, height);
+    console._diffPresent = 1;
+    console._events = malloc(CONSOLE_EVENT_CAPACITY * sizeof(ConsoleEvent));
+    CONSOLE_PROFILE_ALLOCATION();
+    console._eventTimes = malloc(CONSOLE_EVENT_CAPACITY * sizeof(double));
+    CONSOLE_PROFILE_ALLOCATION();
+
+    console._writeFd = STDOUT_FILENO;
+    console._readFd = STDIN_FILENO;
+    console._currentForeground = -1;
+    console._currentBackground = -1;
+    console._repeatEnabled = 1;
+
+    // Terminals advertise 24-bit colour in COLORTERM, and the 256 colour palette in the name of their terminfo entry
+    const char* colourTerm = getenv("COLORTERM");
+    const char* term = getenv("TERM");
+    if (colourTerm && (strstr(colourTerm, "truecolor") || strstr(colourTerm, "24bit"))) console._colourMode = CONSOLE_COLOUR_MODE_RGB;
+    else if (term && strstr(term, "256color")) console._colourMode = CONSOLE_COLOUR_MODE_256;
+    else console._colourMode = CONSOLE_COLOUR_MODE_16;
+
+    tcgetattr(console._readFd, &console._previousTermios);
+
+    // Raw mode with non-blocking reads, so Console_refreshEvents never waits for input
+    struct termios rawTermios = console._previousTermios;
+    rawTermios.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    rawTermios.c_oflag &= ~(OPOST);
+    rawTermios.c_cflag |= CS8;
+    rawTermios.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    rawTermios.c_cc[VMIN] = 0;
+    rawTermios.c_cc[VTIME] = 0;
+    tcsetattr(console._readFd, TCSAFLUSH, &rawTermios);
+
+    // Alternate screen, hidden cursor, any-motion mouse tracking with SGR encoded reports
+    Console_appendString(&console, "\x1b[?1049h\x1b[?25l\x1b[?1003h\x1b[?1006h");
+
+    Console_appendString(&console, "\x1b]0;");
+    Console_appendString(&console, title);
+    Console_appendString(&console, "\x07");
+
+    Console_appendString(&console, "\x1b[8;");
+    Console_appendNumber(&console, height);
+    Console_appendString(&console, ";");
+    Console_appendNumber(&console, width);
+    Console_appendString(&console, "t");
+
+    Console_clearWindow(&console, 0);
+    CONSOLE_PROFILE_INIT(&console);
+
+    return console;
 }
 
-int Console_getMouseY(const Console* console)
+static void Console_restoreTerminal(Console* console)
 {
-    return console->_mousePos.Y;
+    Console_appendString(console, "\x1b[0m\x1b[?1006l\x1b[?1003l\x1b[?25h\x1b[?1049l");
+    Console_flushOutput(console);
+
+    tcsetattr(console->_readFd, TCSAFLUSH, &console->_previousTermios);
 }
 
-char Console_isLeftMousePressed(const Console* console)
+static void ConsoleInputDecoder_pushKeyEvent(ConsoleInputDecoder* decoder, WORD virtualKey, WCHAR c, BOOL keyDown, DWORD modifiers)
 {
-    return console->_leftMousePressed;
+    INPUT_RECORD event;
+    memset(&event, 0, sizeof(event));
+    event.EventType = KEY_EVENT;
+    event.Event.KeyEvent.bKeyDown = keyDown;
+    event.Event.KeyEvent.wRepeatCount = 1;
+    event.Event.KeyEvent.wVirtualKeyCode = virtualKey;
+    event.Event.KeyEvent.uChar.UnicodeChar = c;
+    event.Event.KeyEvent.dwControlKeyState = modifiers;
+
+    decoder->_sink(decoder->_sinkData, &event);
 }
 
-char Console_isLeftMouseJustPressed(const Console* console)
+// Reports modifier keys going down or up, so Console_isKeyPressed works for modifiers the terminal tells us about
+static void ConsoleInputDecoder_setModifiers(ConsoleInputDecoder* decoder, DWORD modifiers)
 {
-    return console->_leftMousePressed && !console->_leftMousePressedLastFrame;
+    static const DWORD modifierFlags[3] = {SHIFT_PRESSED, LEFT_CTRL_PRESSED, LEFT_ALT_PRESSED};
+    static const WORD modifierKeys[3] = {VK_SHIFT, VK_CONTROL, VK_MENU};
+
+    for (int i = 0; i < 3; i++)
+    {
+        if ((decoder->_modifiers ^ modifiers) & modifierFlags[i])
+        {
+            ConsoleInputDecoder_pushKeyEvent(decoder, modifierKeys[i], 0, (modifiers & modifierFlags[i]) != 0, modifiers);
+        }
+    }
+
+    decoder->_modifiers = modifiers;
 }
 
-char Console_isLeftMouseJustReleased(const Console* console)
+// Terminals do not report key releases, so each key press is reported as a press followed by a release
+static void ConsoleInputDecoder_pushKeyPress(ConsoleInputDecoder* decoder, WORD virtualKey, WCHAR c, DWORD modifiers)
 {
-    return !console->_leftMousePressed && console->_leftMousePressedLastFrame;
+    DWORD previousModifiers = decoder->_modifiers;
+
+    ConsoleInputDecoder_setModifiers(decoder, modifiers);
+    ConsoleInputDecoder_pushKeyEvent(decoder, virtualKey, c, TRUE, modifiers);
+    ConsoleInputDecoder_pushKeyEvent(decoder, virtualKey, c, FALSE, modifiers);
+    ConsoleInputDecoder_setModifiers(decoder, previousModifiers);
 }
 
-char Console_isRightMousePressed(const Console* console)
+// xterm encodes modifiers in CSI parameters as 1 + (shift | alt << 1 | ctrl << 2)
+static DWORD ConsoleInputDecoder_decodeModifierParam(int param)
 {
-    return console->_rightMousePressed;
+    DWORD modifiers = 0;
+    if (param <= 1) return modifiers;
+
+    param--;
+    if (param & 1) modifiers |= SHIFT_PRESSED;
+    if (param & 2) modifiers |= LEFT_ALT_PRESSED;
+    if (param & 4) modifiers |= LEFT_CTRL_PRESSED;
+    return modifiers;
 }
 
-char Console_isRightMouseJustPressed(const Console* console)
+static void ConsoleInputDecoder_decodeMouse(ConsoleInputDecoder* decoder, const int* params, int paramCount, char release)
 {
-    return console->_rightMousePressed && !console->_rightMousePressedLastFrame;
+    if (paramCount < 3) return;
+
+    int button = params[0];
+
+    DWORD modifiers = 0;
+    if (button & 4) modifiers |= SHIFT_PRESSED;
+    if (button & 8) modifiers |= LEFT_ALT_PRESSED;
+    if (button & 16) modifiers |= LEFT_CTRL_PRESSED;
+    ConsoleInputDecoder_setModifiers(decoder, modifiers);
+
+    INPUT_RECORD event;
+    memset(&event, 0, sizeof(event));
+    event.EventType = MOUSE_EVENT;
+    event.Event.MouseEvent.dwMousePosition.X = params[1] - 1;
+    event.Event.MouseEvent.dwMousePosition.Y = params[2] - 1;
+    event.Event.MouseEvent.dwControlKeyState = modifiers;
+
+    if (button & 64)
+    {
+        // Wheel delta is stored in the high word of the button state, as on Windows
+        int delta = (button & 1) ? -120 : 120;
+        event.Event.MouseEvent.dwEventFlags = MOUSE_WHEELED;
+        event.Event.MouseEvent.dwButtonState = decoder->_buttons | ((DWORD)(WORD)delta << 16);
+        decoder->_sink(decoder->_sinkData, &event);
+        return;
+    }
+
+    static const DWORD buttonFlags[3] = {FROM_LEFT_1ST_BUTTON_PRESSED, FROM_LEFT_2ND_BUTTON_PRESSED, RIGHTMOST_BUTTON_PRESSED};
+
+    if (button & 32)
+    {
+        event.Event.MouseEvent.dwEventFlags = MOUSE_MOVED;
+    }
+    else if ((button & 3) != 3)
+    {
+        if (release) decoder->_buttons &= ~buttonFlags[button & 3];
+        else decoder->_buttons |= buttonFlags[button & 3];
+    }
+
+    event.Event.MouseEvent.dwButtonState = decoder->_buttons;
+    decoder->_sink(decoder->_sinkData, &event);
 }
 
-char Console_isRightMouseJustReleased(const Console* console)
+// Decodes a CSI or SS3 sequence at the start of bytes, returning the number of bytes used or 0 if it is incomplete
+static int ConsoleInputDecoder_decodeEscape(ConsoleInputDecoder* decoder, const unsigned char* bytes, int size)
 {
-    return !console->_rightMousePressed && console->_rightMousePressedLastFrame;
+    if (size < 3) return 0;
+
+    if (bytes[1] == 'O')
+    {
+        static const char ss3Keys[] = "ABCDHF";
+        static const WORD ss3VirtualKeys[] = {VK_UP, VK_DOWN, VK_RIGHT, VK_LEFT, VK_HOME, VK_END};
+
+        const char* key = strchr(ss3Keys, bytes[2]);
+        if (key && bytes[2] != '\0') ConsoleInputDecoder_pushKeyPress(decoder, ss3VirtualKeys[key - ss3Keys], 0, 0);
+        return 3;
+    }
+
+    int params[4] = {0, 0, 0, 0};
+    int paramCount = 0;
+    char mouse = bytes[2] == '<';
+    int i = mouse ? 3 : 2;
+
+    for (; i < size; i++)
+    {
+        unsigned char c = bytes[i];
+        if (c >= '0' && c <= '9')
+        {
+            if (paramCount == 0) paramCount = 1;
+            if (paramCount <= 4) params[paramCount - 1] = params[paramCount - 1] * 10 + (c - '0');
+        }
+        else if (c == ';')
+        {
+            paramCount++;
+        }
+        else if (c >= 0x40 && c <= 0x7E)
+        {
+            break;
+        }
+    }
+
+    if (i >= size) return 0;
+
+    char final = bytes[i];
+    paramCount = min(paramCount, 4);
+
+    if (mouse)
+    {
+        if (final == 'M' || final == 'm') ConsoleInputDecoder_decodeMouse(decoder, params, paramCount, final == 'm');
+        return i + 1;
+    }
+
+    DWORD modifiers = ConsoleInputDecoder_decodeModifierParam(params[1]);
+
+    static const char csiKeys[] = "ABCDHFZ";
+    static const WORD csiVirtualKeys[] = {VK_UP, VK_DOWN, VK_RIGHT, VK_LEFT, VK_HOME, VK_END, VK_TAB};
+    const char* key = strchr(csiKeys, final);
+
+    if (key)
+    {
+        if (final == 'Z') modifiers |= SHIFT_PRESSED;
+        ConsoleInputDecoder_pushKeyPress(decoder, csiVirtualKeys[key - csiKeys], 0, modifiers);
+    }
+    else if (final == '~')
+    {
+        static const WORD tildeVirtualKeys[9] = {0, VK_HOME, VK_INSERT, VK_DELETE, VK_END, VK_PRIOR, VK_NEXT, VK_HOME, VK_END};
+        if (params[0] > 0 && params[0] < 9) ConsoleInputDecoder_pushKeyPress(decoder, tildeVirtualKeys[params[0]], 0, modifiers);
+    }
+
+    return i + 1;
 }
 
-char Console_isKeyPressed(const Console* console, uint8_t key)
+// Decodes a plain (non escape) key at the start of bytes, returning the number of bytes used or 0 if it is incomplete
+static int ConsoleInputDecoder_decodeKey(ConsoleInputDecoder* decoder, const unsigned char* bytes, int size, DWORD modifiers)
 {
-    return console->_keysPressed[key];
+    unsigned char c = bytes[0];
+
+    if (c == '\r' || c == '\n') ConsoleInputDecoder_pushKeyPress(decoder, VK_RETURN, '\r', modifiers);
+    else if (c == '\t') ConsoleInputDecoder_pushKeyPress(decoder, VK_TAB, '\t', modifiers);
+    else if (c == 0x7F || c == 0x08) ConsoleInputDecoder_pushKeyPress(decoder, VK_BACK, 0x08, modifiers);
+    else if (c == ' ') ConsoleInputDecoder_pushKeyPress(decoder, VK_SPACE, ' ', modifiers);
+    else if (c >= 0x01 && c <= 0x1A) ConsoleInputDecoder_pushKeyPress(decoder, 'A' + c - 1, c, modifiers | LEFT_CTRL_PRESSED);
+    else if (c >= 'a' && c <= 'z') ConsoleInputDecoder_pushKeyPress(decoder, c - 'a' + 'A', c, modifiers);
+    else if (c >= 'A' && c <= 'Z') ConsoleInputDecoder_pushKeyPress(decoder, c, c, modifiers | SHIFT_PRESSED);
+    else if (c >= '0' && c <= '9') ConsoleInputDecoder_pushKeyPress(decoder, c, c, modifiers);
+    else if (c >= 0x80)
+    {
+        // UTF-8 sequences are reported as characters without a virtual key code
+        int length = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+        if (size < length) return 0;
+
+        DWORD codePoint = c & (0x7F >> length);
+        for (int i = 1; i < length; i++)
+        {
+            codePoint = (codePoint << 6) | (bytes[i] & 0x3F);
+        }
+
+        ConsoleInputDecoder_pushKeyPress(decoder, 0, codePoint <= 0xFFFF ? codePoint : '?', modifiers);
+        return length;
+    }
+    else if (c >= 0x20) ConsoleInputDecoder_pushKeyPress(decoder, 0, c, modifiers);
+
+    return 1;
 }
 
-void Console_clearWindow(Console* console, WORD attrib)
+void ConsoleInputDecoder_decode(ConsoleInputDecoder* decoder, char idle)
 {
-    CONSOLE_SCREEN_BUFFER_INFO bufferInfo;
-    DWORD cellCount;
-    DWORD written;
-    COORD home = {0, 0};
-    
-    GetConsoleScreenBufferInfo(console->_writeHandle, &bufferInfo);
-    cellCount = bufferInfo.dwSize.X * bufferInfo.dwSize.Y;
-    FillConsoleOutputCharacter(console->_writeHandle, ' ', cellCount, home, &written);
-    FillConsoleOutputAttribute(console->_writeHandle, attrib, cellCount, home, &written);
-    SetConsoleCursorPosition(console->_writeHandle, home);
+    const unsigned char* bytes = decoder->_buffer;
+    int size = decoder->_size;
+    int i = 0;
+
+    while (i < size)
+    {
+        int used;
+
+        if (bytes[i] == 0x1B)
+        {
+            if (i + 1 >= size)
+            {
+                // A lone escape is the escape key once no more input follows it, otherwise it may start a split sequence
+                if (!idle) break;
+                ConsoleInputDecoder_pushKeyPress(decoder, VK_ESCAPE, 0x1B, 0);
+                used = 1;
+            }
+            else if (bytes[i + 1] == '[' || bytes[i + 1] == 'O')
+            {
+                used = ConsoleInputDecoder_decodeEscape(decoder, &bytes[i], size - i);
+            }
+            else if (bytes[i + 1] == 0x1B)
+            {
+                ConsoleInputDecoder_pushKeyPress(decoder, VK_ESCAPE, 0x1B, 0);
+                used = 1;
+            }
+            else
+            {
+                used = ConsoleInputDecoder_decodeKey(decoder, &bytes[i + 1], size - i - 1, LEFT_ALT_PRESSED);
+                if (used > 0) used++;
+            }
+        }
+        else
+        {
+            used = ConsoleInputDecoder_decodeKey(decoder, &bytes[i], size - i, 0);
+        }
+
+        if (used == 0) break;
+        i += used;
+    }
+
+    // Keep an incomplete sequence for the next read, unless it can never complete
+    if (i == 0 && size == sizeof(decoder->_buffer)) i = size;
+    memmove(decoder->_buffer, &bytes[i], size - i);
+    decoder->_size = size - i;
 }
 
-void Console_display(Console* console)
+char ConsoleInputDecoder_read(ConsoleInputDecoder* decoder, int fd)
 {
-    COORD charBufSize = {console->consoleBuffer.width, console->consoleBuffer.height};
-    COORD characterPos = {0, 0};
-    SMALL_RECT writeArea = {0, 0, console->consoleBuffer.width - 1, console->consoleBuffer.height - 1}; 
+    for (int reads = 0;; reads++)
+    {
+        int space = sizeof(decoder->_buffer) - decoder->_size;
+        ssize_t result = read(fd, &decoder->_buffer[decoder->_size], space);
+#ifdef CONSOLE_PROFILE
+        decoder->_reads++;
+#endif
+        if (result <= 0)
+        {
+            // Nothing on the first read is end of file, later it is a drained terminal with VMIN 0
+            if (decoder->_size > 0) ConsoleInputDecoder_decode(decoder, 1);
+            if (result == 0) return reads > 0;
+            return errno == EAGAIN || errno == EINTR;
+        }
+
+        decoder->_size += result;
+        ConsoleInputDecoder_decode(decoder, 0);
+
+        if (result < space) return 1;
+    }
+}
+
+static void Console_pushDecodedEvent(void* userData, const INPUT_RECORD* event)
+{
+    Console_pushEvent(userData, event, Console_getTime());
+}
+
+static void Console_readEvents(Console* console)
+{
+    // The console may have moved since the last refresh, being returned by value
+    console->_decoder._sink = Console_pushDecodedEvent;
+    console->_decoder._sinkData = console;
+    ConsoleInputDecoder_read(&console->_decoder, console->_readFd);
+
+#ifdef CONSOLE_PROFILE
+    CONSOLE_PROFILE_COUNT(console, syscalls, console->_decoder._reads);
+    console->_decoder._reads = 0;
+#endif
+}
+
+static char Console_waitInput(Console* console, int timeoutMs)
+{
+    // Bytes held back from the last read, like a lone escape, are resolved by the next refresh
+    if (console->_decoder._size > 0) return 1;
+
+    struct pollfd descriptor = {console->_readFd, POLLIN, 0};
+    return poll(&descriptor, 1, timeoutMs) > 0;
+}
+
+static void Console_writeOutput(Console* console, const char* bytes, size_t size)
+{
+    size_t written = 0;
+
+    while (written < size)
+    {
+        ssize_t result = write(console->_writeFd, &bytes[written], size - written);
+        CONSOLE_PROFILE_COUNT(console, syscalls, 1);
+        if (result < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            break;
+        }
+        written += result;
+    }
+}
+
+static void Console_clearTerminal(Console* console, WORD attrib)
+{
+    Console_clearWindowANSI(console, attrib);
+}
+
+static void Console_presentFrame(Console* console)
+{
+    Console_displayANSI(console);
+}
 
-    WriteConsoleOutputA(console->_writeHandle, console->consoleBuffer._buffer, charBufSize, characterPos, &writeArea);
-}
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -4,27 +4,269 @@
 
 #pragma once
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#else
+#include <termios.h>
+#endif
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include <math.h>
 
+#ifndef _WIN32
+//
+// --- Win32 console types and constants, so programs written against the Windows backend build unchanged
+//
+
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef uint16_t WCHAR;
+typedef char CHAR;
+typedef short SHORT;
+
+#define TRUE 1
+#define FALSE 0
+
+typedef struct _COORD
+{
+    SHORT X;
+    SHORT Y;
+} COORD;
+
+typedef struct _CHAR_INFO
+{
+    union
+    {
+        WCHAR UnicodeChar;
+        CHAR AsciiChar;
+    } Char;
+    WORD Attributes;
+} CHAR_INFO;
+
+typedef struct _KEY_EVENT_RECORD
+{
+    BOOL bKeyDown;
+    WORD wRepeatCount;
+    WORD wVirtualKeyCode;
+    WORD wVirtualScanCode;
+    union
+    {
+        WCHAR UnicodeChar;
+        CHAR AsciiChar;
+    } uChar;
+    DWORD dwControlKeyState;
+} KEY_EVENT_RECORD;
+
+typedef struct _MOUSE_EVENT_RECORD
+{
+    COORD dwMousePosition;
+    DWORD dwButtonState;
+    DWORD dwControlKeyState;
+    DWORD dwEventFlags;
+} MOUSE_EVENT_RECORD;
+
+typedef struct _WINDOW_BUFFER_SIZE_RECORD
+{
+    COORD dwSize;
+} WINDOW_BUFFER_SIZE_RECORD;
+
+typedef struct _INPUT_RECORD
+{
+    WORD EventType;
+    union
+    {
+        KEY_EVENT_RECORD KeyEvent;
+        MOUSE_EVENT_RECORD MouseEvent;
+        WINDOW_BUFFER_SIZE_RECORD WindowBufferSizeEvent;
+    } Event;
+} INPUT_RECORD;
+
+#define KEY_EVENT 0x0001
+#define MOUSE_EVENT 0x0002
+#define WINDOW_BUFFER_SIZE_EVENT 0x0004
+
+#define FROM_LEFT_1ST_BUTTON_PRESSED 0x0001
+#define RIGHTMOST_BUTTON_PRESSED 0x0002
+#define FROM_LEFT_2ND_BUTTON_PRESSED 0x0004
+
+#define MOUSE_MOVED 0x0001
+#define MOUSE_WHEELED 0x0004
+
+#define LEFT_ALT_PRESSED 0x0002
+#define LEFT_CTRL_PRESSED 0x0008
+#define SHIFT_PRESSED 0x0010
+
+#define FOREGROUND_BLUE 0x0001
+#define FOREGROUND_GREEN 0x0002
+#define FOREGROUND_RED 0x0004
+#define FOREGROUND_INTENSITY 0x0008
+#define BACKGROUND_BLUE 0x0010
+#define BACKGROUND_GREEN 0x0020
+#define BACKGROUND_RED 0x0040
+#define BACKGROUND_INTENSITY 0x0080
+
+#define VK_BACK 0x08
+#define VK_TAB 0x09
+#define VK_RETURN 0x0D
+#define VK_SHIFT 0x10
+#define VK_CONTROL 0x11
+#define VK_MENU 0x12
+#define VK_ESCAPE 0x1B
+#define VK_SPACE 0x20
+#define VK_PRIOR 0x21
+#define VK_NEXT 0x22
+#define VK_END 0x23
+#define VK_HOME 0x24
+#define VK_LEFT 0x25
+#define VK_UP 0x26
+#define VK_RIGHT 0x27
+#define VK_DOWN 0x28
+#define VK_INSERT 0x2D
+#define VK_DELETE 0x2E
+
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#endif
+
 typedef CHAR_INFO ConsolePixel;
 
+// Cells are packed into 16 bits, the character in the low byte and the colour attribute in the high byte.
+// They are only converted to CHAR_INFO or escape sequences when presented
+typedef uint16_t ConsoleCell;
+
+#define CONSOLE_CELL(c, attrib) ((ConsoleCell)((uint8_t)(c) | (((attrib) & 0xFF) << 8)))
+#define CONSOLE_CELL_CHAR(cell) ((char)((cell) & 0xFF))
+#define CONSOLE_CELL_ATTRIB(cell) ((WORD)((cell) >> 8))
+
+// Block characters of code page 437, which the Windows console uses. VT terminals are sent their UTF-8 equivalents
+#define CONSOLE_CHAR_SHADE_LIGHT ((char)0xB0)
+#define CONSOLE_CHAR_SHADE_MEDIUM ((char)0xB1)
+#define CONSOLE_CHAR_SHADE_DARK ((char)0xB2)
+#define CONSOLE_CHAR_BLOCK_FULL ((char)0xDB)
+#define CONSOLE_CHAR_BLOCK_LOWER ((char)0xDC)
+#define CONSOLE_CHAR_BLOCK_LEFT ((char)0xDD)
+#define CONSOLE_CHAR_BLOCK_RIGHT ((char)0xDE)
+#define CONSOLE_CHAR_BLOCK_UPPER ((char)0xDF)
+
+// 24-bit colours as 0xRRGGBB, for cells that need more than the 16 attribute colours
+typedef uint32_t ConsoleColour;
+
+#define CONSOLE_RGB(r, g, b) ((ConsoleColour)((((r) & 0xFF) << 16) | (((g) & 0xFF) << 8) | ((b) & 0xFF)))
+
+// Leaves the cell in the colour its attribute gives it
+#define CONSOLE_COLOUR_ATTRIB 0xFF000000u
+
+// Dirty tracking granularity, in cells
+#define CONSOLE_TILE_WIDTH 32
+#define CONSOLE_TILE_HEIGHT 8
+
+#define CONSOLE_CLIP_STACK_MAX 16
+
+typedef struct ConsoleArenaBlock ConsoleArenaBlock;
+
+// Bump allocator for per-frame scratch memory. Allocations stay valid until the next reset,
+// which keeps the memory so a steady workload stops allocating after its first frames
+typedef struct ConsoleArena
+{
+    ConsoleArenaBlock* _blocks;
+    size_t _capacity;
+} ConsoleArena;
+
+ConsoleArena ConsoleArena_create(size_t capacity);
+void* ConsoleArena_alloc(ConsoleArena* arena, size_t size);
+void ConsoleArena_reset(ConsoleArena* arena);
+void ConsoleArena_destroy(ConsoleArena* arena);
+
+// Right and bottom are exclusive
+typedef struct ConsoleRect
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+} ConsoleRect;
+
 typedef struct ConsoleBuffer
 {
     int width;
     int height;
 
-    CHAR_INFO* _buffer;
+    ConsoleCell* _cells;
+
+    // Foreground and background colour per cell, NULL until colour planes are enabled. A front buffer holds the colours
+    // as they were sent to the terminal instead
+    ConsoleColour* _foregrounds;
+    ConsoleColour* _backgrounds;
+
+    // With dirty tracking enabled, each write stamps the tiles it touches with _dirtyEpoch
+    uint32_t* _tileStamps;
+    int _tilesX;
+    int _tilesY;
+    uint32_t _dirtyEpoch;
+
+    // The draw functions only write inside _clip, which is always within the buffer
+    ConsoleRect _clip;
+    ConsoleRect _clipStack[CONSOLE_CLIP_STACK_MAX];
+    int _clipDepth;
+
+    // The last scroll since the buffer was presented, or a _scrollDy of 0. The console repeats it on the terminal and in
+    // its front buffer, so only the rows it exposed have to be sent
+    ConsoleRect _scrollRect;
+    int _scrollDy;
 } ConsoleBuffer;
 
 ConsoleBuffer ConsoleBuffer_create(int width, int height);
 ConsoleBuffer ConsoleBuffer_copy(const ConsoleBuffer* consoleBuffer);
+
+// Copies the contents of a buffer of the same size
+void ConsoleBuffer_copyInto(ConsoleBuffer* consoleBuffer, const ConsoleBuffer* source);
+
+// Copies a width x height region of source at (sourceX, sourceY) to (x, y), clipped to the source and the clip rect. The
+// source may be the buffer itself, with the regions overlapping
+void ConsoleBuffer_blit(ConsoleBuffer* consoleBuffer, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height);
+
+// As ConsoleBuffer_blit, but source cells equal to transparentCell are left out
+void ConsoleBuffer_blitMasked(ConsoleBuffer* consoleBuffer, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height, ConsoleCell transparentCell);
+
+// Moves the contents of a width x height region, clipped to the clip rect, dy rows down or -dy rows up, and fills the rows
+// it exposes with c and attrib. Console_display scrolls the terminal the same way instead of redrawing the region, on VT
+// terminals for regions as wide as the buffer
+void ConsoleBuffer_scroll(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, int dy, char c, WORD attrib);
 void ConsoleBuffer_destroy(ConsoleBuffer* consoleBuffer);
 
+// Dirty tracking records which tiles have been written, so Console_display only has to look at those
+void ConsoleBuffer_setDirtyTracking(ConsoleBuffer* consoleBuffer, char enabled);
+
+// For code that writes to _cells directly while dirty tracking is enabled
+void ConsoleBuffer_markDirty(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height);
+
+// Starts a new dirty period. Tiles written after this report dirty against the returned mark
+uint32_t ConsoleBuffer_takeDirtyMark(ConsoleBuffer* consoleBuffer);
+char ConsoleBuffer_isTileDirty(const ConsoleBuffer* consoleBuffer, int tileX, int tileY, uint32_t mark);
+
+// Narrows the clip rect to its intersection with the given rect until the matching pop.
+// Pushes beyond CONSOLE_CLIP_STACK_MAX deep are ignored along with their pops
+void ConsoleBuffer_pushClip(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height);
+void ConsoleBuffer_popClip(ConsoleBuffer* consoleBuffer);
+ConsoleRect ConsoleBuffer_getClip(const ConsoleBuffer* consoleBuffer);
+
+// Colour planes give each cell an RGB foreground and background on top of its attribute, shown as closely as the
+// console's colour mode allows. Cells start as CONSOLE_COLOUR_ATTRIB, and keep their colours until they are set again or
+// the buffer is cleared; blits, draw lists, recordings, streams and layers carry only the cells
+void ConsoleBuffer_setColourPlanes(ConsoleBuffer* consoleBuffer, char enabled);
+
+// Need colour planes. setColour is not clipped, like the other single cell setters, fillColour is
+void ConsoleBuffer_setColour(ConsoleBuffer* consoleBuffer, int x, int y, ConsoleColour foreground, ConsoleColour background);
+void ConsoleBuffer_fillColour(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, ConsoleColour foreground, ConsoleColour background);
+
 void ConsoleBuffer_setChar(ConsoleBuffer* consoleBuffer, int x, int y, char c);
 
 void ConsoleBuffer_setAttrib(ConsoleBuffer* consoleBuffer, int x, int y, DWORD attrib);
@@ -33,14 +275,206 @@ void ConsoleBuffer_setBackgroundAttrib(ConsoleBuffer* consoleBuffer, int x, int
 
 ConsolePixel ConsoleBuffer_getPixel(ConsoleBuffer* consoleBuffer, int x, int y);
 
+// The draw functions and blits are clipped to the clip rect, the single cell setters are not
 void ConsoleBuffer_drawText(ConsoleBuffer* consoleBuffer, const char* text, int x, int y, WORD attrib);
 void ConsoleBuffer_drawRect(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, char c, WORD attrib);
+// Both end points are drawn
 void ConsoleBuffer_drawLine(ConsoleBuffer* consoleBuffer, int x1, int y1, int x2, int y2, char c, WORD attrib);
 
+// Ellipses cover the cells whose centres are within the radii plus half a cell. The outlines are the edge cells of the
+// filled shapes, and everything is written as whole row spans
+void ConsoleBuffer_drawEllipse(ConsoleBuffer* consoleBuffer, int x, int y, int radiusX, int radiusY, char c, WORD attrib);
+void ConsoleBuffer_fillEllipse(ConsoleBuffer* consoleBuffer, int x, int y, int radiusX, int radiusY, char c, WORD attrib);
+void ConsoleBuffer_drawCircle(ConsoleBuffer* consoleBuffer, int x, int y, int radius, char c, WORD attrib);
+void ConsoleBuffer_fillCircle(ConsoleBuffer* consoleBuffer, int x, int y, int radius, char c, WORD attrib);
+
+typedef struct ConsolePoint
+{
+    int x;
+    int y;
+} ConsolePoint;
+
+// Polygons are closed. The fill uses the even-odd rule and includes the outline
+void ConsoleBuffer_drawPolygon(ConsoleBuffer* consoleBuffer, const ConsolePoint* points, int numPoints, char c, WORD attrib);
+void ConsoleBuffer_fillPolygon(ConsoleBuffer* consoleBuffer, const ConsolePoint* points, int numPoints, char c, WORD attrib);
+
+// Which parts of a cell ConsoleBuffer_floodFill compares with the seed cell. 0 compares both
+#define CONSOLE_FILL_MATCH_CHAR 1
+#define CONSOLE_FILL_MATCH_ATTRIB 2
+
+// Fills the cells connected to (x, y) across edges, within the clip rect, that match the cell at (x, y). Works a row span at
+// a time with an explicit stack allocated from scratch, which is left for the caller to reset. Returns the cells filled
+int ConsoleBuffer_floodFill(ConsoleBuffer* consoleBuffer, int x, int y, char c, WORD attrib, int match, ConsoleArena* scratch);
+
+typedef enum ConsoleImageFormat
+{
+    // 3 bytes per pixel, red, green and blue
+    CONSOLE_IMAGE_RGB,
+
+    // 1 byte per pixel
+    CONSOLE_IMAGE_GREY,
+} ConsoleImageFormat;
+
+typedef struct ConsoleImage
+{
+    const uint8_t* pixels;
+    int width;
+    int height;
+
+    // Bytes from the start of one row to the next
+    int stride;
+    ConsoleImageFormat format;
+} ConsoleImage;
+
+// Draws an image scaled to the width x height cells at (x, y), within the clip rect. The image is box filtered to width x
+// 2 * height pixels, and each cell shows two as an upper half block with the top pixel as foreground and the bottom one as
+// background. The colours go to the colour planes if they are enabled, and as the closest attribute colours to the cells
+// either way. Source rows are summed in scratch, which is left for the caller to reset
+void ConsoleBuffer_drawImage(ConsoleBuffer* consoleBuffer, int x, int y, int width, int height, const ConsoleImage* image, ConsoleArena* scratch);
+
 void ConsoleBuffer_clear(ConsoleBuffer* consoleBuffer, char c, DWORD attrib);
 
-typedef struct Console
+// Receives the escape sequences a headless console would have sent to a terminal
+typedef void (*ConsoleOutputFunc)(void* userData, const char* bytes, size_t size);
+
+typedef struct Console Console;
+
+// Takes over reading input from Console_refreshEvents and Console_waitEvents, e.g. to read on another thread.
+// read hands pending events to the console with Console_pushEvent, wait blocks like Console_waitEvents
+typedef struct ConsoleInputSource
+{
+    void (*read)(void* userData, Console* console);
+    char (*wait)(void* userData, int timeoutMs);
+    void* userData;
+} ConsoleInputSource;
+
+// Takes over Console_display, e.g. to present on another thread. present is handed the finished frame in consoleBuffer
+typedef struct ConsolePresenter
+{
+    void (*present)(void* userData, Console* console);
+    void* userData;
+} ConsolePresenter;
+
+// Told of each run of cells [start, end) on row y that presenting a frame writes to the window, or moves there with a scroll
+typedef void (*ConsoleChangeSink)(void* userData, int y, int start, int end);
+
+// How colours from colour planes are sent to the terminal. Colours are quantized to the palette through lookup tables
+typedef enum ConsoleColourMode
+{
+    // The 16 attribute colours, the only mode of the Windows console
+    CONSOLE_COLOUR_MODE_16,
+
+    // The 6x6x6 colour cube and grey ramp of the 256 colour palette
+    CONSOLE_COLOUR_MODE_256,
+
+    // 24-bit SGR colours
+    CONSOLE_COLOUR_MODE_RGB,
+} ConsoleColourMode;
+
+#ifndef _WIN32
+typedef void (*ConsoleEventSink)(void* userData, const INPUT_RECORD* event);
+
+// Turns VT terminal input into INPUT_RECORD events, handed to _sink as they are decoded
+typedef struct ConsoleInputDecoder
 {
+    // Input bytes not yet decoded, e.g. an escape sequence split across reads
+    unsigned char _buffer[256];
+    int _size;
+    DWORD _buttons;
+    DWORD _modifiers;
+
+    ConsoleEventSink _sink;
+    void* _sinkData;
+
+#ifdef CONSOLE_PROFILE
+    // read calls since the console last collected them
+    uint32_t _reads;
+#endif
+} ConsoleInputDecoder;
+
+// Reads whatever input is available on fd and decodes it. Returns 0 if fd failed or is at end of file
+char ConsoleInputDecoder_read(ConsoleInputDecoder* decoder, int fd);
+
+// Decodes the buffered bytes. Once idle, a trailing escape is taken as the escape key rather than the start of a sequence
+void ConsoleInputDecoder_decode(ConsoleInputDecoder* decoder, char idle);
+#endif
+
+// Building with CONSOLE_PROFILE defined times each phase of a frame and counts the work done in it. Without it the
+// instrumentation compiles away and the stats read as zero. A frame ends when Console_display returns
+typedef enum ConsoleProfilePhase
+{
+    CONSOLE_PROFILE_REFRESH,
+    CONSOLE_PROFILE_POLL,
+
+    // The rest of the frame, spent in the program's own update and drawing
+    CONSOLE_PROFILE_DRAW,
+
+    // Console_display apart from writing, e.g. diffing and building escape sequences
+    CONSOLE_PROFILE_ENCODE,
+    CONSOLE_PROFILE_WRITE,
+
+    // Sleeping in Console_waitEvents, not counted in the frame time
+    CONSOLE_PROFILE_WAIT,
+    CONSOLE_PROFILE_PHASE_COUNT
+} ConsoleProfilePhase;
+
+// Frames the frame time percentiles are taken over
+#define CONSOLE_PROFILE_FRAMES 256
+
+typedef struct ConsoleProfileCounters
+{
+    // Cells encoded for output and the bytes written for them
+    uint64_t cells;
+    uint64_t bytes;
+
+    // Reads, writes and waits on the terminal or console handles
+    uint64_t syscalls;
+    uint64_t events;
+
+    // Allocations made by the library on any thread while the frame ran
+    uint64_t allocations;
+} ConsoleProfileCounters;
+
+typedef struct ConsoleProfileStats
+{
+    // The last frame
+    double phaseSeconds[CONSOLE_PROFILE_PHASE_COUNT];
+    double frameSeconds;
+    ConsoleProfileCounters counters;
+
+    // Frame times over the last CONSOLE_PROFILE_FRAMES frames, or as many as there have been
+    double frameP50;
+    double frameP99;
+    double frameMax;
+    uint64_t frames;
+} ConsoleProfileStats;
+
+#ifdef CONSOLE_PROFILE
+typedef struct ConsoleProfile
+{
+    // The current frame, which started when the last one ended
+    double _frameStart;
+    double _phaseSeconds[CONSOLE_PROFILE_PHASE_COUNT];
+    ConsoleProfileCounters _counters;
+    int _allocationsAtStart;
+
+    // Presenters call Console_display again from inside it, only the outermost call ends the frame
+    int _displayDepth;
+
+    ConsoleProfileStats _last;
+    float _frameTimes[CONSOLE_PROFILE_FRAMES];
+} ConsoleProfile;
+
+// Counts one allocation toward the frame's counters, every module of the library calls it where it allocates
+void Console_profileAllocation(void);
+#define CONSOLE_PROFILE_ALLOCATION() Console_profileAllocation()
+#else
+#define CONSOLE_PROFILE_ALLOCATION() ((void)0)
+#endif
+
+struct Console
+{
+#ifdef _WIN32
     HANDLE _writeHandle;
     HANDLE _readHandle;
 
@@ -50,29 +484,106 @@ typedef struct Console
     SMALL_RECT _previousWindowSize;
     COORD _previousBufferSize;
 
+    // Regions are converted to CHAR_INFO here before being written
+    CHAR_INFO* _presentCells;
+#else
+    int _writeFd;
+    int _readFd;
+
+    struct termios _previousTermios;
+
+    ConsoleInputDecoder _decoder;
+#endif
+
+    // Escape sequences for a frame are batched here and sent with a single write
+    char* _outputBuffer;
+    size_t _outputSize;
+    size_t _outputCapacity;
+    int _cursorX;
+    int _cursorY;
+    int _currentForeground;
+    int _currentBackground;
+    char _repeatEnabled;
+    ConsoleColourMode _colourMode;
+
+    // Headless consoles render into memory and hand their escape sequences to _outputFunc, if set
+    char _headless;
+    ConsoleOutputFunc _outputFunc;
+    void* _outputUserData;
+
     ConsoleBuffer consoleBuffer;
 
-    INPUT_RECORD* _eventBuffer;
-    DWORD _numEvents;
-    DWORD _eventIter;
+    // Last frame written to the window, used to only present changed cells
+    ConsoleBuffer _frontBuffer;
+    char _frontBufferValid;
+    char _diffPresent;
+    uint32_t _presentMark;
+
+    // Colours of the row being presented as sent to the terminal, foregrounds then backgrounds, with colour planes only
+    ConsoleColour* _rowColours;
+
+    // Replaces presenting to the window when present is set
+    ConsolePresenter _presenter;
+
+    // Set around a call to Console_display by whoever wants the frame's changes without diffing it again
+    ConsoleChangeSink _changeSink;
+    void* _changeSinkData;
+
+    // Ring of events not yet polled, allocated once. Head and tail count up and wrap with the mask
+    INPUT_RECORD* _events;
+    double* _eventTimes;
+    uint32_t _eventHead;
+    uint32_t _eventTail;
+    uint32_t _droppedEvents;
+
+    // Replaces reading the terminal when read is set
+    ConsoleInputSource _inputSource;
 
     COORD _mousePos;
     char _leftMousePressed;
-    char _leftMousePressedLastFrame;
+    char _leftMouseJustPressed;
+    char _leftMouseJustReleased;
     char _rightMousePressed;
-    char _rightMousePressedLastFrame;
+    char _rightMouseJustPressed;
+    char _rightMouseJustReleased;
     char _keysPressed[256];
-} Console;
+
+#ifdef CONSOLE_PROFILE
+    ConsoleProfile _profile;
+#endif
+};
 
 typedef INPUT_RECORD ConsoleEvent;
 
+// Events the console can hold between polls, a power of two
+#define CONSOLE_EVENT_CAPACITY 1024
+
 Console Console_create(int width, int height, const char* title);
+
+// Creates a console without a window, for tests and benchmarks. output may be NULL
+Console Console_createHeadless(int width, int height, ConsoleOutputFunc output, void* userData);
 void Console_destroy(Console* console);
 
 // Call once per frame
 void Console_refreshEvents(Console* console);
 int Console_pollEvent(Console* console, ConsoleEvent* consoleEvent);
 
+// Zero-copy alternative to Console_pollEvent. The returned event stays valid until it is consumed or events are refreshed
+const ConsoleEvent* Console_peekEvent(const Console* console);
+void Console_consumeEvent(Console* console);
+
+// Time the event Console_peekEvent returns was read, on the Console_getTime clock
+double Console_getEventTime(const Console* console);
+
+// Adds an event as if it had been read from the terminal, e.g. from an input source or to script a headless console
+void Console_pushEvent(Console* console, const ConsoleEvent* event, double time);
+
+// Pass NULL to go back to reading the terminal directly
+void Console_setInputSource(Console* console, const ConsoleInputSource* source);
+
+// Events lost because the console already held CONSOLE_EVENT_CAPACITY unpolled events. Consecutive mouse moves are merged rather than counted
+uint32_t Console_getDroppedEventCount(const Console* console);
+
 int Console_getMouseX(const Console* console);
 int Console_getMouseY(const Console* console);
 char Console_isLeftMousePressed(const Console* console);
@@ -83,6 +594,77 @@ char Console_isRightMouseJustPressed(const Console* console);
 char Console_isRightMouseJustReleased(const Console* console);
 char Console_isKeyPressed(const Console* console, uint8_t key);
 
+// Sleeps until input is waiting or timeoutMs passes, or indefinitely for a negative timeout. Returns 1 if input is waiting,
+// which the next Console_refreshEvents picks up
+char Console_waitEvents(Console* console, int timeoutMs);
+
+// Monotonic time in seconds
+double Console_getTime();
+
 void Console_clearWindow(Console* console, WORD attrib);
 
-void Console_display(Console* console);
\ No newline at end of file
+// Diff presenting is enabled by default, only writing cells that changed since the last Console_display
+void Console_setDiffPresent(Console* console, char enabled);
+
+// Forces the next Console_display to redraw the whole window, e.g. after writing to the console directly
+void Console_invalidate(Console* console);
+
+// Repeated cells are sent with the REP escape sequence on VT terminals, disable for terminals that lack it
+void Console_setRepeatEnabled(Console* console, char enabled);
+
+// VT terminals start in the mode COLORTERM and TERM advertise, headless consoles in CONSOLE_COLOUR_MODE_RGB. Setting it
+// redraws the window on the next Console_display
+void Console_setColourMode(Console* console, ConsoleColourMode mode);
+ConsoleColourMode Console_getColourMode(const Console* console);
+
+void Console_display(Console* console);
+
+// Counts and times of the last frame and frame time percentiles, all zero unless built with CONSOLE_PROFILE.
+// Sorts the recent frame times, so it is meant to be called once a frame at most
+ConsoleProfileStats Console_getProfileStats(const Console* console);
+
+// Draws the profile stats of the last frame as a small panel with its top left corner at (x, y), e.g. just before
+// Console_display. Draws nothing unless built with CONSOLE_PROFILE
+void Console_drawProfileOverlay(Console* console, int x, int y);
+
+// Pass NULL to go back to presenting directly
+void Console_setPresenter(Console* console, const ConsolePresenter* presenter);
+
+// Copies the output side of a console into one that only presents, so frames can be displayed from another thread while
+// the original keeps drawing and reading input. The original must not write to the window until the presenter is joined.
+// The presenter keeps the original's ConsolePresenter, which then runs wherever the presenter is displayed
+Console Console_forkPresenter(const Console* console);
+
+// Takes back the window state from a forked presenter and frees it
+void Console_joinPresenter(Console* console, Console* presenter);
+
+// Paces a main loop: sleeps between frames, runs game updates at a fixed rate and limits how often frames are presented.
+//
+//     ConsolePacer_wait(&pacer, &console);
+//     while (Console_pollEvent(&console, &event)) { ... }
+//     while (ConsolePacer_update(&pacer)) { ... }
+//     if (ConsolePacer_present(&pacer)) { ...; Console_display(&console); }
+typedef struct ConsolePacer
+{
+    double _updateStep;
+    double _presentInterval;
+    double _accumulator;
+    double _lastTime;
+    double _nextPresent;
+    char _updatedSincePresent;
+} ConsolePacer;
+
+// A rate of 0 turns off fixed updates, or presents after every update (every wait, without updates)
+ConsolePacer ConsolePacer_create(double updatesPerSecond, double presentsPerSecond);
+
+// Sleeps until input arrives or the next update or present is due, then refreshes the console's events
+void ConsolePacer_wait(ConsolePacer* pacer, Console* console);
+
+// Returns 1 once for each fixed update that is due
+char ConsolePacer_update(ConsolePacer* pacer);
+
+// Returns 1 when a frame should be presented
+char ConsolePacer_present(ConsolePacer* pacer);
+
+// How far the time is between the last update and the next, from 0 to 1, for smoothing
+double ConsolePacer_getAlpha(const ConsolePacer* pacer);
\ No newline at end of file
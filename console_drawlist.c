@@ -0,0 +1,469 @@
+#include "console_drawlist.h"
+
+// Commands are recorded without knowing the target, so the default clip rect is effectively unbounded
+#define CONSOLE_DRAWLIST_UNBOUNDED (1 << 29)
+
+// Number of the largest opaque rects kept to cull earlier commands against
+#define CONSOLE_DRAWLIST_OCCLUDERS_MAX 32
+
+static char ConsoleRect_isEmpty(const ConsoleRect* rect)
+{
+    return rect->left >= rect->right || rect->top >= rect->bottom;
+}
+
+static ConsoleRect ConsoleRect_intersect(ConsoleRect a, ConsoleRect b)
+{
+    ConsoleRect rect;
+    rect.left = max(a.left, b.left);
+    rect.top = max(a.top, b.top);
+    rect.right = min(a.right, b.right);
+    rect.bottom = min(a.bottom, b.bottom);
+    return rect;
+}
+
+static char ConsoleRect_contains(const ConsoleRect* outer, const ConsoleRect* inner)
+{
+    return inner->left >= outer->left && inner->right <= outer->right && inner->top >= outer->top && inner->bottom <= outer->bottom;
+}
+
+static int64_t ConsoleRect_area(const ConsoleRect* rect)
+{
+    return (int64_t)(rect->right - rect->left) * (rect->bottom - rect->top);
+}
+
+ConsoleDrawList ConsoleDrawList_create()
+{
+    ConsoleDrawList drawList;
+
+    drawList._commandCapacity = 256;
+    drawList._commands = malloc(drawList._commandCapacity * sizeof(ConsoleDrawCommand));
+    CONSOLE_PROFILE_ALLOCATION();
+    drawList._numCommands = 0;
+
+    drawList._arena = ConsoleArena_create(4096);
+
+    drawList._clip = (ConsoleRect){-CONSOLE_DRAWLIST_UNBOUNDED, -CONSOLE_DRAWLIST_UNBOUNDED, CONSOLE_DRAWLIST_UNBOUNDED, CONSOLE_DRAWLIST_UNBOUNDED};
+    drawList._clipDepth = 0;
+
+    drawList._bandStarts = NULL;
+    drawList._bandCommands = NULL;
+    drawList._bandCapacity = 0;
+    drawList._bandCommandCapacity = 0;
+
+    drawList._stats = (ConsoleDrawListStats){0};
+
+    return drawList;
+}
+
+void ConsoleDrawList_destroy(ConsoleDrawList* drawList)
+{
+    free(drawList->_commands);
+    free(drawList->_bandStarts);
+    free(drawList->_bandCommands);
+    ConsoleArena_destroy(&drawList->_arena);
+
+    drawList->_commands = NULL;
+    drawList->_bandStarts = NULL;
+    drawList->_bandCommands = NULL;
+}
+
+void ConsoleDrawList_reset(ConsoleDrawList* drawList)
+{
+    drawList->_numCommands = 0;
+    ConsoleArena_reset(&drawList->_arena);
+
+    drawList->_clip = (ConsoleRect){-CONSOLE_DRAWLIST_UNBOUNDED, -CONSOLE_DRAWLIST_UNBOUNDED, CONSOLE_DRAWLIST_UNBOUNDED, CONSOLE_DRAWLIST_UNBOUNDED};
+    drawList->_clipDepth = 0;
+}
+
+void ConsoleDrawList_pushClip(ConsoleDrawList* drawList, int x, int y, int width, int height)
+{
+    int depth = drawList->_clipDepth++;
+    if (depth >= CONSOLE_CLIP_STACK_MAX) return;
+
+    ConsoleRect* clip = &drawList->_clip;
+    drawList->_clipStack[depth] = *clip;
+
+    clip->left = max(clip->left, x);
+    clip->top = max(clip->top, y);
+    clip->right = max(min(clip->right, x + width), clip->left);
+    clip->bottom = max(min(clip->bottom, y + height), clip->top);
+}
+
+void ConsoleDrawList_popClip(ConsoleDrawList* drawList)
+{
+    if (drawList->_clipDepth == 0) return;
+
+    int depth = --drawList->_clipDepth;
+    if (depth >= CONSOLE_CLIP_STACK_MAX) return;
+
+    drawList->_clip = drawList->_clipStack[depth];
+}
+
+static ConsoleDrawCommand* ConsoleDrawList_push(ConsoleDrawList* drawList, ConsoleDrawCommandType type)
+{
+    if (drawList->_numCommands == drawList->_commandCapacity)
+    {
+        drawList->_commandCapacity *= 2;
+        drawList->_commands = realloc(drawList->_commands, drawList->_commandCapacity * sizeof(ConsoleDrawCommand));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+
+    ConsoleDrawCommand* command = &drawList->_commands[drawList->_numCommands++];
+    command->type = type;
+    command->cell = 0;
+    command->attrib = 0;
+    command->clip = drawList->_clip;
+    return command;
+}
+
+void ConsoleDrawList_clear(ConsoleDrawList* drawList, char c, WORD attrib)
+{
+    ConsoleDrawCommand* command = ConsoleDrawList_push(drawList, CONSOLE_DRAW_FILL);
+    command->cell = CONSOLE_CELL(c, attrib);
+    command->rect = drawList->_clip;
+}
+
+void ConsoleDrawList_drawRect(ConsoleDrawList* drawList, int x, int y, int width, int height, char c, WORD attrib)
+{
+    // Negative sizes extend left or up from one before x or y, as in ConsoleBuffer_drawRect
+    if (width < 0)
+    {
+        x += width - 1;
+        width = 1 - width;
+    }
+    if (height < 0)
+    {
+        y += height - 1;
+        height = 1 - height;
+    }
+
+    ConsoleDrawCommand* command = ConsoleDrawList_push(drawList, CONSOLE_DRAW_FILL);
+    command->cell = CONSOLE_CELL(c, attrib);
+    command->rect = (ConsoleRect){x, y, x + width, y + height};
+}
+
+void ConsoleDrawList_drawLine(ConsoleDrawList* drawList, int x1, int y1, int x2, int y2, char c, WORD attrib)
+{
+    ConsoleDrawCommand* command = ConsoleDrawList_push(drawList, CONSOLE_DRAW_LINE);
+    command->cell = CONSOLE_CELL(c, attrib);
+    command->line.x1 = x1;
+    command->line.y1 = y1;
+    command->line.x2 = x2;
+    command->line.y2 = y2;
+}
+
+void ConsoleDrawList_drawText(ConsoleDrawList* drawList, const char* text, int x, int y, WORD attrib)
+{
+    size_t length = strlen(text);
+    char* copy = ConsoleArena_alloc(&drawList->_arena, length + 1);
+    memcpy(copy, text, length + 1);
+
+    ConsoleDrawCommand* command = ConsoleDrawList_push(drawList, CONSOLE_DRAW_TEXT);
+    command->attrib = attrib;
+    command->text.text = copy;
+    command->text.length = (int)min(length, (size_t)CONSOLE_DRAWLIST_UNBOUNDED);
+    command->text.x = x;
+    command->text.y = y;
+}
+
+void ConsoleDrawList_blit(ConsoleDrawList* drawList, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height)
+{
+    ConsoleDrawCommand* command = ConsoleDrawList_push(drawList, CONSOLE_DRAW_BLIT);
+    command->blit.source = source;
+    command->blit.x = x;
+    command->blit.y = y;
+    command->blit.sourceX = sourceX;
+    command->blit.sourceY = sourceY;
+    command->blit.width = width;
+    command->blit.height = height;
+}
+
+void ConsoleDrawList_blitMasked(ConsoleDrawList* drawList, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height, ConsoleCell transparentCell)
+{
+    ConsoleDrawList_blit(drawList, source, x, y, sourceX, sourceY, width, height);
+
+    ConsoleDrawCommand* command = &drawList->_commands[drawList->_numCommands - 1];
+    command->type = CONSOLE_DRAW_BLIT_MASKED;
+    command->cell = transparentCell;
+}
+
+// The cells a command can write, before clipping
+static ConsoleRect ConsoleDrawList_commandExtent(const ConsoleDrawCommand* command)
+{
+    switch (command->type)
+    {
+    case CONSOLE_DRAW_FILL:
+        return command->rect;
+
+    case CONSOLE_DRAW_LINE:
+        return (ConsoleRect){min(command->line.x1, command->line.x2), min(command->line.y1, command->line.y2),
+            max(command->line.x1, command->line.x2) + 1, max(command->line.y1, command->line.y2) + 1};
+
+    case CONSOLE_DRAW_TEXT:
+        return (ConsoleRect){command->text.x, command->text.y, command->text.x + command->text.length, command->text.y + 1};
+
+    default:
+    {
+        // Blits also clip against their source
+        const ConsoleBuffer* source = command->blit.source;
+        int left = max(-command->blit.sourceX, 0);
+        int top = max(-command->blit.sourceY, 0);
+        int right = min(command->blit.width, source->width - command->blit.sourceX);
+        int bottom = min(command->blit.height, source->height - command->blit.sourceY);
+        return (ConsoleRect){command->blit.x + left, command->blit.y + top, command->blit.x + right, command->blit.y + bottom};
+    }
+    }
+}
+
+// Trims a fill by an opaque rect covering it along one whole side, which still leaves a single rect
+static void ConsoleDrawList_trimFill(ConsoleRect* fill, const ConsoleRect* occluder)
+{
+    if (occluder->top <= fill->top && occluder->bottom >= fill->bottom)
+    {
+        if (occluder->left <= fill->left && occluder->right > fill->left) fill->left = occluder->right;
+        else if (occluder->right >= fill->right && occluder->left < fill->right) fill->right = occluder->left;
+    }
+    else if (occluder->left <= fill->left && occluder->right >= fill->right)
+    {
+        if (occluder->top <= fill->top && occluder->bottom > fill->top) fill->top = occluder->bottom;
+        else if (occluder->bottom >= fill->bottom && occluder->top < fill->bottom) fill->bottom = occluder->top;
+    }
+}
+
+// Walks the commands back to front, culling any that later opaque commands completely cover
+static void ConsoleDrawList_cull(ConsoleDrawList* drawList, ConsoleRect target)
+{
+    ConsoleRect occluders[CONSOLE_DRAWLIST_OCCLUDERS_MAX];
+    int numOccluders = 0;
+
+    for (int i = drawList->_numCommands - 1; i >= 0; i--)
+    {
+        ConsoleDrawCommand* command = &drawList->_commands[i];
+        ConsoleRect bounds = ConsoleRect_intersect(ConsoleRect_intersect(command->clip, target), ConsoleDrawList_commandExtent(command));
+
+        for (int j = 0; j < numOccluders && !ConsoleRect_isEmpty(&bounds); j++)
+        {
+            if (ConsoleRect_contains(&occluders[j], &bounds))
+            {
+                bounds.right = bounds.left;
+
+                // Neighbouring commands tend to be hidden by the same rect, so it moves to the front
+                ConsoleRect occluder = occluders[j];
+                memmove(&occluders[1], &occluders[0], j * sizeof(ConsoleRect));
+                occluders[0] = occluder;
+            }
+            else if (command->type == CONSOLE_DRAW_FILL)
+            {
+                ConsoleDrawList_trimFill(&bounds, &occluders[j]);
+            }
+        }
+
+        command->bounds = bounds;
+        if (ConsoleRect_isEmpty(&bounds))
+        {
+            drawList->_stats.culled++;
+            continue;
+        }
+
+        if (command->type != CONSOLE_DRAW_FILL && command->type != CONSOLE_DRAW_BLIT) continue;
+
+        // When full, the new rect replaces the smallest occluder if it is larger
+        if (numOccluders < CONSOLE_DRAWLIST_OCCLUDERS_MAX)
+        {
+            occluders[numOccluders++] = bounds;
+            continue;
+        }
+
+        int smallest = 0;
+        for (int j = 1; j < numOccluders; j++)
+        {
+            if (ConsoleRect_area(&occluders[j]) < ConsoleRect_area(&occluders[smallest])) smallest = j;
+        }
+        if (ConsoleRect_area(&bounds) > ConsoleRect_area(&occluders[smallest])) occluders[smallest] = bounds;
+    }
+}
+
+// Joins fills of the same cell that follow each other and share an edge
+static void ConsoleDrawList_merge(ConsoleDrawList* drawList)
+{
+    ConsoleDrawCommand* previous = NULL;
+
+    for (int i = 0; i < drawList->_numCommands; i++)
+    {
+        ConsoleDrawCommand* command = &drawList->_commands[i];
+        if (ConsoleRect_isEmpty(&command->bounds)) continue;
+
+        if (previous && command->type == CONSOLE_DRAW_FILL && command->cell == previous->cell)
+        {
+            ConsoleRect* a = &previous->bounds;
+            ConsoleRect* b = &command->bounds;
+
+            char sameRows = a->top == b->top && a->bottom == b->bottom;
+            char sameColumns = a->left == b->left && a->right == b->right;
+            if ((sameRows && (a->right == b->left || b->right == a->left)) || (sameColumns && (a->bottom == b->top || b->bottom == a->top)))
+            {
+                a->left = min(a->left, b->left);
+                a->top = min(a->top, b->top);
+                a->right = max(a->right, b->right);
+                a->bottom = max(a->bottom, b->bottom);
+                b->right = b->left;
+                drawList->_stats.merged++;
+                continue;
+            }
+        }
+
+        previous = command->type == CONSOLE_DRAW_FILL ? command : NULL;
+    }
+}
+
+// Buckets the remaining commands by the bands of CONSOLE_TILE_HEIGHT rows they touch, keeping their order
+static int ConsoleDrawList_bucket(ConsoleDrawList* drawList, int height)
+{
+    int numBands = (height + CONSOLE_TILE_HEIGHT - 1) / CONSOLE_TILE_HEIGHT;
+    if (numBands + 1 > drawList->_bandCapacity)
+    {
+        drawList->_bandCapacity = numBands + 1;
+        drawList->_bandStarts = realloc(drawList->_bandStarts, drawList->_bandCapacity * sizeof(int));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+
+    int* starts = drawList->_bandStarts;
+    memset(starts, 0, (numBands + 1) * sizeof(int));
+
+    for (int i = 0; i < drawList->_numCommands; i++)
+    {
+        const ConsoleRect* bounds = &drawList->_commands[i].bounds;
+        if (ConsoleRect_isEmpty(bounds)) continue;
+
+        for (int band = bounds->top / CONSOLE_TILE_HEIGHT; band <= (bounds->bottom - 1) / CONSOLE_TILE_HEIGHT; band++)
+        {
+            starts[band + 1]++;
+        }
+    }
+
+    for (int band = 0; band < numBands; band++)
+    {
+        starts[band + 1] += starts[band];
+    }
+
+    if (starts[numBands] > drawList->_bandCommandCapacity)
+    {
+        drawList->_bandCommandCapacity = starts[numBands] * 2;
+        drawList->_bandCommands = realloc(drawList->_bandCommands, drawList->_bandCommandCapacity * sizeof(int));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+
+    // Fills each band from its start, shifting the starts down by one band, then shifts them back
+    for (int i = 0; i < drawList->_numCommands; i++)
+    {
+        const ConsoleRect* bounds = &drawList->_commands[i].bounds;
+        if (ConsoleRect_isEmpty(bounds)) continue;
+
+        for (int band = bounds->top / CONSOLE_TILE_HEIGHT; band <= (bounds->bottom - 1) / CONSOLE_TILE_HEIGHT; band++)
+        {
+            drawList->_bandCommands[starts[band]++] = i;
+        }
+    }
+
+    for (int band = numBands; band > 0; band--)
+    {
+        starts[band] = starts[band - 1];
+    }
+    starts[0] = 0;
+
+    return numBands;
+}
+
+static void ConsoleDrawList_execute(const ConsoleDrawCommand* command, ConsoleBuffer* consoleBuffer, ConsoleRect clip)
+{
+    ConsoleRect bounds = ConsoleRect_intersect(command->bounds, clip);
+    if (ConsoleRect_isEmpty(&bounds)) return;
+
+    ConsoleBuffer_pushClip(consoleBuffer, bounds.left, bounds.top, bounds.right - bounds.left, bounds.bottom - bounds.top);
+
+    switch (command->type)
+    {
+    case CONSOLE_DRAW_FILL:
+        ConsoleBuffer_drawRect(consoleBuffer, bounds.left, bounds.top, bounds.right - bounds.left, bounds.bottom - bounds.top,
+            CONSOLE_CELL_CHAR(command->cell), CONSOLE_CELL_ATTRIB(command->cell));
+        break;
+
+    case CONSOLE_DRAW_LINE:
+        ConsoleBuffer_drawLine(consoleBuffer, command->line.x1, command->line.y1, command->line.x2, command->line.y2,
+            CONSOLE_CELL_CHAR(command->cell), CONSOLE_CELL_ATTRIB(command->cell));
+        break;
+
+    case CONSOLE_DRAW_TEXT:
+        ConsoleBuffer_drawText(consoleBuffer, command->text.text, command->text.x, command->text.y, command->attrib);
+        break;
+
+    case CONSOLE_DRAW_BLIT:
+        ConsoleBuffer_blit(consoleBuffer, command->blit.source, command->blit.x, command->blit.y,
+            command->blit.sourceX, command->blit.sourceY, command->blit.width, command->blit.height);
+        break;
+
+    case CONSOLE_DRAW_BLIT_MASKED:
+        ConsoleBuffer_blitMasked(consoleBuffer, command->blit.source, command->blit.x, command->blit.y,
+            command->blit.sourceX, command->blit.sourceY, command->blit.width, command->blit.height, command->cell);
+        break;
+    }
+
+    ConsoleBuffer_popClip(consoleBuffer);
+}
+
+typedef struct ConsoleBandJob
+{
+    const ConsoleDrawList* drawList;
+    const ConsoleBuffer* consoleBuffer;
+} ConsoleBandJob;
+
+// Draws one band through its own copy of the buffer header, which shares the cells and dirty stamps but has its own clip
+// stack. Bands are whole tile rows, so bands on different threads never write the same cell or stamp
+static void ConsoleDrawList_rasterizeBand(void* userData, int band)
+{
+    const ConsoleBandJob* job = userData;
+    const ConsoleDrawList* drawList = job->drawList;
+
+    ConsoleBuffer bandBuffer = *job->consoleBuffer;
+    ConsoleRect bandRect = {0, band * CONSOLE_TILE_HEIGHT, bandBuffer.width, (band + 1) * CONSOLE_TILE_HEIGHT};
+
+    for (int i = drawList->_bandStarts[band]; i < drawList->_bandStarts[band + 1]; i++)
+    {
+        ConsoleDrawList_execute(&drawList->_commands[drawList->_bandCommands[i]], &bandBuffer, bandRect);
+    }
+}
+
+static int ConsoleDrawList_prepare(ConsoleDrawList* drawList, const ConsoleBuffer* consoleBuffer)
+{
+    drawList->_stats = (ConsoleDrawListStats){drawList->_numCommands, 0, 0};
+
+    ConsoleDrawList_cull(drawList, ConsoleBuffer_getClip(consoleBuffer));
+    ConsoleDrawList_merge(drawList);
+
+    return ConsoleDrawList_bucket(drawList, consoleBuffer->height);
+}
+
+void ConsoleDrawList_submit(ConsoleDrawList* drawList, ConsoleBuffer* consoleBuffer)
+{
+    int numBands = ConsoleDrawList_prepare(drawList, consoleBuffer);
+
+    ConsoleBandJob job = {drawList, consoleBuffer};
+    for (int band = 0; band < numBands; band++)
+    {
+        ConsoleDrawList_rasterizeBand(&job, band);
+    }
+}
+
+void ConsoleDrawList_submitParallel(ConsoleDrawList* drawList, ConsoleBuffer* consoleBuffer, ConsoleWorkerPool* pool)
+{
+    int numBands = ConsoleDrawList_prepare(drawList, consoleBuffer);
+
+    ConsoleBandJob job = {drawList, consoleBuffer};
+    ConsoleWorkerPool_run(pool, ConsoleDrawList_rasterizeBand, &job, numBands);
+}
+
+ConsoleDrawListStats ConsoleDrawList_getStats(const ConsoleDrawList* drawList)
+{
+    return drawList->_stats;
+}
\ No newline at end of file
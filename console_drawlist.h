@@ -0,0 +1,121 @@
+//
+// --- Draw lists, recorded ConsoleBuffer drawing that is culled, merged and rasterized on submit
+//
+
+#pragma once
+
+#include "console.h"
+#include "console_thread.h"
+
+typedef enum ConsoleDrawCommandType
+{
+    CONSOLE_DRAW_FILL,
+    CONSOLE_DRAW_LINE,
+    CONSOLE_DRAW_TEXT,
+    CONSOLE_DRAW_BLIT,
+    CONSOLE_DRAW_BLIT_MASKED
+} ConsoleDrawCommandType;
+
+typedef struct ConsoleDrawCommand
+{
+    ConsoleDrawCommandType type;
+
+    // Fill and line cell, or the transparent cell of a masked blit
+    ConsoleCell cell;
+    WORD attrib;
+
+    // Clip rect at record time
+    ConsoleRect clip;
+
+    // Set on submit: the cells the command can still write after culling and merging, empty if none
+    ConsoleRect bounds;
+
+    union
+    {
+        ConsoleRect rect;
+        struct
+        {
+            int x1;
+            int y1;
+            int x2;
+            int y2;
+        } line;
+        struct
+        {
+            const char* text;
+            int length;
+            int x;
+            int y;
+        } text;
+        struct
+        {
+            const ConsoleBuffer* source;
+            int x;
+            int y;
+            int sourceX;
+            int sourceY;
+            int width;
+            int height;
+        } blit;
+    };
+} ConsoleDrawCommand;
+
+typedef struct ConsoleDrawListStats
+{
+    int commands;
+    int culled;
+    int merged;
+} ConsoleDrawListStats;
+
+// A draw list owns everything it records except blit sources, which must stay alive until it is submitted and must not be the target buffer.
+// It can be recorded on one thread and submitted on another
+typedef struct ConsoleDrawList
+{
+    ConsoleDrawCommand* _commands;
+    int _numCommands;
+    int _commandCapacity;
+
+    // Text is copied into the arena, which is reset with the list
+    ConsoleArena _arena;
+
+    ConsoleRect _clip;
+    ConsoleRect _clipStack[CONSOLE_CLIP_STACK_MAX];
+    int _clipDepth;
+
+    // Per band command indices, kept between submits
+    int* _bandStarts;
+    int* _bandCommands;
+    int _bandCapacity;
+    int _bandCommandCapacity;
+
+    ConsoleDrawListStats _stats;
+} ConsoleDrawList;
+
+ConsoleDrawList ConsoleDrawList_create();
+void ConsoleDrawList_destroy(ConsoleDrawList* drawList);
+
+// Drops all recorded commands, keeping the memory for the next frame
+void ConsoleDrawList_reset(ConsoleDrawList* drawList);
+
+// Same rules as the ConsoleBuffer clip stack
+void ConsoleDrawList_pushClip(ConsoleDrawList* drawList, int x, int y, int width, int height);
+void ConsoleDrawList_popClip(ConsoleDrawList* drawList);
+
+// Fills the current clip rect
+void ConsoleDrawList_clear(ConsoleDrawList* drawList, char c, WORD attrib);
+void ConsoleDrawList_drawRect(ConsoleDrawList* drawList, int x, int y, int width, int height, char c, WORD attrib);
+void ConsoleDrawList_drawLine(ConsoleDrawList* drawList, int x1, int y1, int x2, int y2, char c, WORD attrib);
+void ConsoleDrawList_drawText(ConsoleDrawList* drawList, const char* text, int x, int y, WORD attrib);
+void ConsoleDrawList_blit(ConsoleDrawList* drawList, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height);
+void ConsoleDrawList_blitMasked(ConsoleDrawList* drawList, const ConsoleBuffer* source, int x, int y, int sourceX, int sourceY, int width, int height, ConsoleCell transparentCell);
+
+// Rasterizes the recorded commands into the buffer, within its clip rect, with the same result as drawing them in order.
+// Commands hidden by later opaque fills and blits are culled, adjacent fills merged and the rest drawn one band of rows at a time.
+// The list keeps its commands, so it can be submitted again or reset
+void ConsoleDrawList_submit(ConsoleDrawList* drawList, ConsoleBuffer* consoleBuffer);
+
+// As ConsoleDrawList_submit, with the bands spread over the pool's threads. The result is identical
+void ConsoleDrawList_submitParallel(ConsoleDrawList* drawList, ConsoleBuffer* consoleBuffer, ConsoleWorkerPool* pool);
+
+// Counts from the last submit
+ConsoleDrawListStats ConsoleDrawList_getStats(const ConsoleDrawList* drawList);
\ No newline at end of file
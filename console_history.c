@@ -0,0 +1,274 @@
+#include "console_history.h"
+
+#define CONSOLE_HISTORY_TILE_CELLS (CONSOLE_TILE_WIDTH * CONSOLE_TILE_HEIGHT)
+
+typedef struct ConsoleHistoryTile
+{
+    int refs;
+
+    // Row major with a stride of CONSOLE_TILE_WIDTH, tiles on the right and bottom edges only use part of it
+    ConsoleCell cells[CONSOLE_HISTORY_TILE_CELLS];
+} ConsoleHistoryTile;
+
+struct ConsoleHistoryState
+{
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+
+    // Each snapshot is tilesX * tilesY tile pointers. snapshots[current] matches the buffer apart from edits since
+    ConsoleHistoryTile*** snapshots;
+    int count;
+    int current;
+    int maxSnapshots;
+    int tileCount;
+
+    // Dirty mark taken from markCells at the last snapshot or restore, as for the recorder
+    uint32_t mark;
+    const ConsoleCell* markCells;
+};
+
+static void ConsoleHistory_getTileSize(const ConsoleHistoryState* state, int tileX, int tileY, int* width, int* height)
+{
+    *width = min(CONSOLE_TILE_WIDTH, state->width - tileX * CONSOLE_TILE_WIDTH);
+    *height = min(CONSOLE_TILE_HEIGHT, state->height - tileY * CONSOLE_TILE_HEIGHT);
+}
+
+static ConsoleHistoryTile* ConsoleHistory_createTile(ConsoleHistoryState* state, const ConsoleBuffer* consoleBuffer, int tileX, int tileY)
+{
+    int width;
+    int height;
+    ConsoleHistory_getTileSize(state, tileX, tileY, &width, &height);
+
+    ConsoleHistoryTile* tile = malloc(sizeof(ConsoleHistoryTile));
+    CONSOLE_PROFILE_ALLOCATION();
+    tile->refs = 1;
+
+    const ConsoleCell* source = &consoleBuffer->_cells[tileY * CONSOLE_TILE_HEIGHT * state->width + tileX * CONSOLE_TILE_WIDTH];
+    for (int y = 0; y < height; y++)
+    {
+        memcpy(&tile->cells[y * CONSOLE_TILE_WIDTH], &source[y * state->width], width * sizeof(ConsoleCell));
+    }
+
+    state->tileCount++;
+    return tile;
+}
+
+static void ConsoleHistory_releaseTile(ConsoleHistoryState* state, ConsoleHistoryTile* tile)
+{
+    if (--tile->refs > 0) return;
+
+    free(tile);
+    state->tileCount--;
+}
+
+static char ConsoleHistory_tileMatches(const ConsoleHistoryState* state, const ConsoleHistoryTile* tile, const ConsoleBuffer* consoleBuffer, int tileX, int tileY)
+{
+    int width;
+    int height;
+    ConsoleHistory_getTileSize(state, tileX, tileY, &width, &height);
+
+    const ConsoleCell* cells = &consoleBuffer->_cells[tileY * CONSOLE_TILE_HEIGHT * state->width + tileX * CONSOLE_TILE_WIDTH];
+    for (int y = 0; y < height; y++)
+    {
+        if (memcmp(&tile->cells[y * CONSOLE_TILE_WIDTH], &cells[y * state->width], width * sizeof(ConsoleCell)) != 0) return 0;
+    }
+
+    return 1;
+}
+
+static void ConsoleHistory_releaseSnapshot(ConsoleHistoryState* state, ConsoleHistoryTile** snapshot)
+{
+    for (int i = 0; i < state->tilesX * state->tilesY; i++)
+    {
+        ConsoleHistory_releaseTile(state, snapshot[i]);
+    }
+}
+
+// Tiles written since the mark, or every tile if the mark does not apply to the buffer
+static char ConsoleHistory_isTileEdited(const ConsoleHistoryState* state, const ConsoleBuffer* consoleBuffer, int tileX, int tileY)
+{
+    if (state->markCells != consoleBuffer->_cells) return 1;
+    return ConsoleBuffer_isTileDirty(consoleBuffer, tileX, tileY, state->mark);
+}
+
+static void ConsoleHistory_takeMark(ConsoleHistoryState* state, ConsoleBuffer* consoleBuffer)
+{
+    state->mark = ConsoleBuffer_takeDirtyMark(consoleBuffer);
+    state->markCells = consoleBuffer->_cells;
+}
+
+ConsoleHistory ConsoleHistory_create(ConsoleBuffer* consoleBuffer, int maxSnapshots)
+{
+    ConsoleHistory history;
+
+    ConsoleHistoryState* state = malloc(sizeof(ConsoleHistoryState));
+    CONSOLE_PROFILE_ALLOCATION();
+    memset(state, 0, sizeof(ConsoleHistoryState));
+    state->width = consoleBuffer->width;
+    state->height = consoleBuffer->height;
+    state->tilesX = (state->width + CONSOLE_TILE_WIDTH - 1) / CONSOLE_TILE_WIDTH;
+    state->tilesY = (state->height + CONSOLE_TILE_HEIGHT - 1) / CONSOLE_TILE_HEIGHT;
+    state->maxSnapshots = max(maxSnapshots, 1);
+    state->snapshots = malloc(state->maxSnapshots * sizeof(ConsoleHistoryTile**));
+    CONSOLE_PROFILE_ALLOCATION();
+
+    ConsoleHistoryTile** snapshot = malloc(state->tilesX * state->tilesY * sizeof(ConsoleHistoryTile*));
+    CONSOLE_PROFILE_ALLOCATION();
+    for (int tileY = 0; tileY < state->tilesY; tileY++)
+    {
+        for (int tileX = 0; tileX < state->tilesX; tileX++)
+        {
+            snapshot[tileY * state->tilesX + tileX] = ConsoleHistory_createTile(state, consoleBuffer, tileX, tileY);
+        }
+    }
+
+    state->snapshots[0] = snapshot;
+    state->count = 1;
+    state->current = 0;
+    ConsoleHistory_takeMark(state, consoleBuffer);
+
+    history._state = state;
+    return history;
+}
+
+void ConsoleHistory_destroy(ConsoleHistory* history)
+{
+    ConsoleHistoryState* state = history->_state;
+    if (!state) return;
+
+    for (int i = 0; i < state->count; i++)
+    {
+        ConsoleHistory_releaseSnapshot(state, state->snapshots[i]);
+        free(state->snapshots[i]);
+    }
+    free(state->snapshots);
+    free(state);
+
+    history->_state = NULL;
+}
+
+void ConsoleHistory_snapshot(ConsoleHistory* history, ConsoleBuffer* consoleBuffer)
+{
+    ConsoleHistoryState* state = history->_state;
+    const int numTiles = state->tilesX * state->tilesY;
+
+    // The tile array of a discarded snapshot is reused for the new one
+    ConsoleHistoryTile** snapshot = NULL;
+
+    while (state->count > state->current + 1)
+    {
+        ConsoleHistoryTile** discarded = state->snapshots[--state->count];
+        ConsoleHistory_releaseSnapshot(state, discarded);
+        free(snapshot);
+        snapshot = discarded;
+    }
+
+    if (!snapshot)
+    {
+        snapshot = malloc(numTiles * sizeof(ConsoleHistoryTile*));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+    ConsoleHistoryTile* const* previous = state->snapshots[state->current];
+
+    for (int tileY = 0; tileY < state->tilesY; tileY++)
+    {
+        for (int tileX = 0; tileX < state->tilesX; tileX++)
+        {
+            const int i = tileY * state->tilesX + tileX;
+            ConsoleHistoryTile* tile = previous[i];
+
+            // Written tiles are only copied if their contents actually changed
+            if (ConsoleHistory_isTileEdited(state, consoleBuffer, tileX, tileY) && !ConsoleHistory_tileMatches(state, tile, consoleBuffer, tileX, tileY))
+            {
+                snapshot[i] = ConsoleHistory_createTile(state, consoleBuffer, tileX, tileY);
+            }
+            else
+            {
+                tile->refs++;
+                snapshot[i] = tile;
+            }
+        }
+    }
+
+    // The oldest snapshot is only dropped once the new one holds its tiles, as with one snapshot it is the current one
+    if (state->count == state->maxSnapshots)
+    {
+        ConsoleHistoryTile** oldest = state->snapshots[0];
+        ConsoleHistory_releaseSnapshot(state, oldest);
+        free(oldest);
+
+        memmove(&state->snapshots[0], &state->snapshots[1], (state->count - 1) * sizeof(ConsoleHistoryTile**));
+        state->count--;
+    }
+
+    state->snapshots[state->count++] = snapshot;
+    state->current = state->count - 1;
+    ConsoleHistory_takeMark(state, consoleBuffer);
+}
+
+// Writes the tiles of snapshot target that differ from the buffer. Tiles shared with the current snapshot are only
+// written if the buffer was edited there since
+static void ConsoleHistory_restore(ConsoleHistoryState* state, ConsoleBuffer* consoleBuffer, int target)
+{
+    ConsoleHistoryTile** current = state->snapshots[state->current];
+    ConsoleHistoryTile** snapshot = state->snapshots[target];
+
+    for (int tileY = 0; tileY < state->tilesY; tileY++)
+    {
+        for (int tileX = 0; tileX < state->tilesX; tileX++)
+        {
+            const ConsoleHistoryTile* tile = snapshot[tileY * state->tilesX + tileX];
+            if (tile == current[tileY * state->tilesX + tileX] && !ConsoleHistory_isTileEdited(state, consoleBuffer, tileX, tileY)) continue;
+
+            int width;
+            int height;
+            ConsoleHistory_getTileSize(state, tileX, tileY, &width, &height);
+
+            ConsoleCell* cells = &consoleBuffer->_cells[tileY * CONSOLE_TILE_HEIGHT * state->width + tileX * CONSOLE_TILE_WIDTH];
+            for (int y = 0; y < height; y++)
+            {
+                memcpy(&cells[y * state->width], &tile->cells[y * CONSOLE_TILE_WIDTH], width * sizeof(ConsoleCell));
+            }
+            ConsoleBuffer_markDirty(consoleBuffer, tileX * CONSOLE_TILE_WIDTH, tileY * CONSOLE_TILE_HEIGHT, width, height);
+        }
+    }
+
+    // The restore itself is not an edit
+    state->current = target;
+    ConsoleHistory_takeMark(state, consoleBuffer);
+}
+
+char ConsoleHistory_undo(ConsoleHistory* history, ConsoleBuffer* consoleBuffer)
+{
+    ConsoleHistoryState* state = history->_state;
+    if (state->current == 0) return 0;
+
+    ConsoleHistory_restore(state, consoleBuffer, state->current - 1);
+    return 1;
+}
+
+char ConsoleHistory_redo(ConsoleHistory* history, ConsoleBuffer* consoleBuffer)
+{
+    ConsoleHistoryState* state = history->_state;
+    if (state->current + 1 >= state->count) return 0;
+
+    ConsoleHistory_restore(state, consoleBuffer, state->current + 1);
+    return 1;
+}
+
+int ConsoleHistory_getUndoCount(const ConsoleHistory* history)
+{
+    return history->_state->current;
+}
+
+int ConsoleHistory_getRedoCount(const ConsoleHistory* history)
+{
+    return history->_state->count - history->_state->current - 1;
+}
+
+int ConsoleHistory_getTileCount(const ConsoleHistory* history)
+{
+    return history->_state->tileCount;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+//
+// --- Snapshot history, undo and redo for a ConsoleBuffer with copy-on-write tiles
+//
+
+#pragma once
+
+#include "console.h"
+
+typedef struct ConsoleHistoryState ConsoleHistoryState;
+
+// Snapshots are grids of reference counted CONSOLE_TILE_WIDTH x CONSOLE_TILE_HEIGHT tiles. A snapshot shares every
+// tile that did not change since the one before it, so memory grows with the tiles edited rather than with history depth
+typedef struct ConsoleHistory
+{
+    ConsoleHistoryState* _state;
+} ConsoleHistory;
+
+// Takes the buffer's current contents as the first snapshot. Once more than maxSnapshots are kept, the oldest is dropped.
+// With dirty tracking enabled on the buffer only tiles written since the last snapshot are compared
+ConsoleHistory ConsoleHistory_create(ConsoleBuffer* consoleBuffer, int maxSnapshots);
+void ConsoleHistory_destroy(ConsoleHistory* history);
+
+// Records the buffer's contents after an edit as a new snapshot, copying only the tiles that changed. Snapshots that
+// were undone are discarded
+void ConsoleHistory_snapshot(ConsoleHistory* history, ConsoleBuffer* consoleBuffer);
+
+// Step back or forward one snapshot, writing only the tiles that differ into the buffer. Edits made since the last
+// snapshot are reverted too. Return 0 if there is nothing to undo or redo
+char ConsoleHistory_undo(ConsoleHistory* history, ConsoleBuffer* consoleBuffer);
+char ConsoleHistory_redo(ConsoleHistory* history, ConsoleBuffer* consoleBuffer);
+
+int ConsoleHistory_getUndoCount(const ConsoleHistory* history);
+int ConsoleHistory_getRedoCount(const ConsoleHistory* history);
+
+// Tiles currently held across all snapshots
+int ConsoleHistory_getTileCount(const ConsoleHistory* history);
\ No newline at end of file
@@ -0,0 +1,276 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "console_input.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#endif
+
+// One slot is always left empty, so the queue holds one event less than this
+#define CONSOLE_INPUT_QUEUE_CAPACITY 1024
+
+// How long a lone escape waits for the rest of a sequence before it is taken as the escape key
+#define CONSOLE_INPUT_ESCAPE_TIMEOUT_MS 25
+
+typedef struct ConsoleInputItem
+{
+    INPUT_RECORD event;
+    double time;
+} ConsoleInputItem;
+
+struct ConsoleInputShared
+{
+    // Single producer, single consumer: only the input thread moves tail and only the main loop moves head
+    ConsoleInputItem items[CONSOLE_INPUT_QUEUE_CAPACITY];
+    ConsoleAtomicInt head;
+    ConsoleAtomicInt tail;
+    ConsoleAtomicInt dropped;
+
+    // Only used to sleep in Console_waitEvents, the queue itself takes no lock
+    ConsoleMutex mutex;
+    ConsoleCondition ready;
+
+    ConsoleThread thread;
+    ConsoleAtomicInt quit;
+
+#ifdef _WIN32
+    HANDLE readHandle;
+    HANDLE stopEvent;
+#else
+    int readFd;
+    int wakePipe[2];
+    ConsoleInputDecoder decoder;
+#endif
+};
+
+static void ConsoleInputThread_push(ConsoleInputShared* shared, const INPUT_RECORD* event, double time)
+{
+    int tail = ConsoleAtomic_load(&shared->tail);
+    int next = (tail + 1) & (CONSOLE_INPUT_QUEUE_CAPACITY - 1);
+
+    if (next == ConsoleAtomic_load(&shared->head))
+    {
+        ConsoleAtomic_fetchAdd(&shared->dropped, 1);
+        return;
+    }
+
+    shared->items[tail].event = *event;
+    shared->items[tail].time = time;
+    ConsoleAtomic_store(&shared->tail, next);
+}
+
+// Wakes Console_waitEvents. Taking the mutex orders this after a waiter's check of the queue
+static void ConsoleInputThread_signal(ConsoleInputShared* shared)
+{
+    ConsoleMutex_lock(&shared->mutex);
+    ConsoleCondition_broadcast(&shared->ready);
+    ConsoleMutex_unlock(&shared->mutex);
+}
+
+#ifdef _WIN32
+static void ConsoleInputThread_main(void* userData)
+{
+    ConsoleInputShared* shared = userData;
+    HANDLE handles[2] = {shared->readHandle, shared->stopEvent};
+    INPUT_RECORD records[64];
+
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0)
+    {
+        DWORD numEvents = 0;
+        DWORD numRead = 0;
+        if (!GetNumberOfConsoleInputEvents(shared->readHandle, &numEvents)) break;
+        if (numEvents == 0) continue;
+        if (!ReadConsoleInput(shared->readHandle, records, min(numEvents, (DWORD)64), &numRead)) break;
+
+        double time = Console_getTime();
+        for (DWORD i = 0; i < numRead; i++)
+        {
+            ConsoleInputThread_push(shared, &records[i], time);
+        }
+        ConsoleInputThread_signal(shared);
+    }
+}
+#else
+static void ConsoleInputThread_pushDecodedEvent(void* userData, const INPUT_RECORD* event)
+{
+    ConsoleInputThread_push(userData, event, Console_getTime());
+}
+
+static void ConsoleInputThread_main(void* userData)
+{
+    ConsoleInputShared* shared = userData;
+    struct pollfd descriptors[2] = {{shared->readFd, POLLIN, 0}, {shared->wakePipe[0], POLLIN, 0}};
+
+    // Set while undecoded bytes have not yet had their timeout, so an incomplete sequence does not keep waking the thread
+    char pending = shared->decoder._size > 0;
+
+    while (!ConsoleAtomic_load(&shared->quit))
+    {
+        int result = poll(descriptors, 2, pending ? CONSOLE_INPUT_ESCAPE_TIMEOUT_MS : -1);
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (result == 0)
+        {
+            ConsoleInputDecoder_decode(&shared->decoder, 1);
+            pending = 0;
+        }
+        else if (descriptors[0].revents & POLLIN)
+        {
+            if (!ConsoleInputDecoder_read(&shared->decoder, shared->readFd)) descriptors[0].fd = -1;
+            pending = shared->decoder._size > 0;
+        }
+        else if (descriptors[0].revents)
+        {
+            // Hung up or closed, poll skips negative descriptors
+            descriptors[0].fd = -1;
+        }
+
+        ConsoleInputThread_signal(shared);
+    }
+}
+#endif
+
+static void ConsoleInputThread_read(void* userData, Console* console)
+{
+    ConsoleInputShared* shared = userData;
+    int head = ConsoleAtomic_load(&shared->head);
+    int tail = ConsoleAtomic_load(&shared->tail);
+
+    while (head != tail)
+    {
+        Console_pushEvent(console, &shared->items[head].event, shared->items[head].time);
+        head = (head + 1) & (CONSOLE_INPUT_QUEUE_CAPACITY - 1);
+    }
+    ConsoleAtomic_store(&shared->head, head);
+
+    int dropped = ConsoleAtomic_load(&shared->dropped);
+    if (dropped > 0)
+    {
+        ConsoleAtomic_fetchAdd(&shared->dropped, -dropped);
+        console->_droppedEvents += dropped;
+    }
+}
+
+static char ConsoleInputThread_wait(void* userData, int timeoutMs)
+{
+    ConsoleInputShared* shared = userData;
+    double deadline = Console_getTime() + timeoutMs / 1000.0;
+
+    ConsoleMutex_lock(&shared->mutex);
+    while (ConsoleAtomic_load(&shared->head) == ConsoleAtomic_load(&shared->tail))
+    {
+        if (timeoutMs < 0)
+        {
+            ConsoleCondition_wait(&shared->ready, &shared->mutex);
+            continue;
+        }
+
+        int remainingMs = (int)ceil((deadline - Console_getTime()) * 1000.0);
+        if (remainingMs <= 0) break;
+        ConsoleCondition_waitTimeout(&shared->ready, &shared->mutex, remainingMs);
+    }
+    char ready = ConsoleAtomic_load(&shared->head) != ConsoleAtomic_load(&shared->tail);
+    ConsoleMutex_unlock(&shared->mutex);
+
+    return ready;
+}
+
+static void ConsoleInputThread_free(ConsoleInputShared* shared)
+{
+#ifdef _WIN32
+    CloseHandle(shared->stopEvent);
+#else
+    close(shared->wakePipe[0]);
+    close(shared->wakePipe[1]);
+#endif
+    ConsoleCondition_destroy(&shared->ready);
+    ConsoleMutex_destroy(&shared->mutex);
+    free(shared);
+}
+
+ConsoleInputThread ConsoleInputThread_start(Console* console)
+{
+    ConsoleInputThread inputThread;
+    inputThread._shared = NULL;
+
+    if (console->_headless) return inputThread;
+
+    ConsoleInputShared* shared = malloc(sizeof(ConsoleInputShared));
+    CONSOLE_PROFILE_ALLOCATION();
+    shared->head = 0;
+    shared->tail = 0;
+    shared->dropped = 0;
+    shared->quit = 0;
+
+#ifdef _WIN32
+    shared->readHandle = console->_readHandle;
+    shared->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!shared->stopEvent)
+    {
+        free(shared);
+        return inputThread;
+    }
+#else
+    shared->readFd = console->_readFd;
+    if (pipe(shared->wakePipe) != 0)
+    {
+        free(shared);
+        return inputThread;
+    }
+
+    // Bytes of a sequence split across the handover carry over
+    shared->decoder = console->_decoder;
+    shared->decoder._sink = ConsoleInputThread_pushDecodedEvent;
+    shared->decoder._sinkData = shared;
+#endif
+
+    ConsoleMutex_init(&shared->mutex);
+    ConsoleCondition_init(&shared->ready);
+
+    if (!ConsoleThread_start(&shared->thread, ConsoleInputThread_main, shared))
+    {
+        ConsoleInputThread_free(shared);
+        return inputThread;
+    }
+
+    ConsoleInputSource source;
+    source.read = ConsoleInputThread_read;
+    source.wait = ConsoleInputThread_wait;
+    source.userData = shared;
+    Console_setInputSource(console, &source);
+
+    inputThread._shared = shared;
+    return inputThread;
+}
+
+void ConsoleInputThread_stop(ConsoleInputThread* inputThread, Console* console)
+{
+    ConsoleInputShared* shared = inputThread->_shared;
+    if (!shared) return;
+
+    ConsoleAtomic_store(&shared->quit, 1);
+#ifdef _WIN32
+    SetEvent(shared->stopEvent);
+#else
+    char wake = 0;
+    while (write(shared->wakePipe[1], &wake, 1) < 0 && errno == EINTR);
+#endif
+    ConsoleThread_join(&shared->thread);
+
+    ConsoleInputThread_read(shared, console);
+    Console_setInputSource(console, NULL);
+#ifndef _WIN32
+    console->_decoder = shared->decoder;
+#endif
+
+    ConsoleInputThread_free(shared);
+    inputThread->_shared = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+//
+// --- Input thread, reads and decodes input as it arrives and queues it for the main loop
+//
+
+#pragma once
+
+#include "console.h"
+#include "console_thread.h"
+
+typedef struct ConsoleInputShared ConsoleInputShared;
+
+// While running, the thread is the console's input source. Events are stamped when they are read rather than when
+// the frame gets to them, and Console_refreshEvents only drains a lock-free queue instead of calling into the OS
+typedef struct ConsoleInputThread
+{
+    ConsoleInputShared* _shared;
+} ConsoleInputThread;
+
+// Leaves _shared NULL for headless consoles or if the thread could not be started, the console then reads input itself
+ConsoleInputThread ConsoleInputThread_start(Console* console);
+
+// Hands queued events and decoder state back to the console, which reads input itself again
+void ConsoleInputThread_stop(ConsoleInputThread* inputThread, Console* console);
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include "console_layer.h"
+
+// Columns of one layer visible in a range of rows, or of the background when layer is -1
+typedef struct ConsoleLayerPiece
+{
+    int layer;
+    int left;
+    int right;
+} ConsoleLayerPiece;
+
+// Columns covered by opaque layers, sorted and disjoint
+typedef struct ConsoleLayerSpan
+{
+    int left;
+    int right;
+} ConsoleLayerSpan;
+
+static const ConsoleRect ConsoleLayer_emptyRect = {0, 0, 0, 0};
+
+static char ConsoleLayer_sameRect(ConsoleRect a, ConsoleRect b)
+{
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+// The part of the target the layer covers, empty when hidden
+static ConsoleRect ConsoleCompositor_layerRect(const ConsoleCompositor* compositor, const ConsoleLayer* layer)
+{
+    if (!layer->_visible) return ConsoleLayer_emptyRect;
+
+    ConsoleRect rect;
+    rect.left = (int)max((int64_t)layer->_x, (int64_t)0);
+    rect.top = (int)max((int64_t)layer->_y, (int64_t)0);
+    rect.right = (int)min((int64_t)layer->_x + layer->_buffer->width, (int64_t)compositor->width);
+    rect.bottom = (int)min((int64_t)layer->_y + layer->_buffer->height, (int64_t)compositor->height);
+
+    if (rect.left >= rect.right || rect.top >= rect.bottom) return ConsoleLayer_emptyRect;
+    return rect;
+}
+
+static void ConsoleCompositor_markRect(ConsoleCompositor* compositor, int left, int top, int right, int bottom)
+{
+    left = max(left, 0);
+    top = max(top, 0);
+    right = min(right, compositor->width);
+    bottom = min(bottom, compositor->height);
+    if (left >= right || top >= bottom) return;
+
+    for (int tileY = top / CONSOLE_TILE_HEIGHT; tileY <= (bottom - 1) / CONSOLE_TILE_HEIGHT; tileY++)
+    {
+        uint8_t* dirty = &compositor->_dirtyTiles[tileY * compositor->_tilesX];
+        for (int tileX = left / CONSOLE_TILE_WIDTH; tileX <= (right - 1) / CONSOLE_TILE_WIDTH; tileX++)
+        {
+            dirty[tileX] = 1;
+        }
+    }
+}
+
+ConsoleCompositor ConsoleCompositor_create(int width, int height, ConsoleCell background)
+{
+    ConsoleCompositor compositor;
+    memset(&compositor, 0, sizeof(compositor));
+
+    compositor.width = width;
+    compositor.height = height;
+    compositor.background = background;
+
+    compositor._tilesX = (width + CONSOLE_TILE_WIDTH - 1) / CONSOLE_TILE_WIDTH;
+    compositor._tilesY = (height + CONSOLE_TILE_HEIGHT - 1) / CONSOLE_TILE_HEIGHT;
+    compositor._dirtyTiles = malloc(max(compositor._tilesX * compositor._tilesY, 1));
+    CONSOLE_PROFILE_ALLOCATION();
+    memset(compositor._dirtyTiles, 1, compositor._tilesX * compositor._tilesY);
+
+    compositor._scratch = ConsoleArena_create(4096);
+
+    return compositor;
+}
+
+void ConsoleCompositor_destroy(ConsoleCompositor* compositor)
+{
+    free(compositor->_layers);
+    free(compositor->_dirtyTiles);
+    ConsoleArena_destroy(&compositor->_scratch);
+    memset(compositor, 0, sizeof(*compositor));
+}
+
+int ConsoleCompositor_addLayer(ConsoleCompositor* compositor, ConsoleBuffer* buffer, int x, int y)
+{
+    if (compositor->_numLayers == compositor->_layerCapacity)
+    {
+        compositor->_layerCapacity = max(compositor->_layerCapacity * 2, 4);
+        compositor->_layers = realloc(compositor->_layers, compositor->_layerCapacity * sizeof(ConsoleLayer));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+
+    ConsoleLayer* layer = &compositor->_layers[compositor->_numLayers];
+    memset(layer, 0, sizeof(*layer));
+    layer->_buffer = buffer;
+    layer->_x = x;
+    layer->_y = y;
+    layer->_visible = 1;
+
+    // Never composed, so the next compose marks all of it
+    layer->_markCells = NULL;
+    layer->_shownRect = ConsoleLayer_emptyRect;
+
+    ConsoleBuffer_setDirtyTracking(buffer, 1);
+
+    return compositor->_numLayers++;
+}
+
+void ConsoleCompositor_setLayerPosition(ConsoleCompositor* compositor, int layer, int x, int y)
+{
+    if (layer < 0 || layer >= compositor->_numLayers) return;
+
+    compositor->_layers[layer]._x = x;
+    compositor->_layers[layer]._y = y;
+}
+
+void ConsoleCompositor_setLayerVisible(ConsoleCompositor* compositor, int layer, char visible)
+{
+    if (layer < 0 || layer >= compositor->_numLayers) return;
+
+    compositor->_layers[layer]._visible = visible != 0;
+}
+
+void ConsoleCompositor_setLayerTransparency(ConsoleCompositor* compositor, int layer, char enabled, ConsoleCell transparentCell)
+{
+    if (layer < 0 || layer >= compositor->_numLayers) return;
+
+    compositor->_layers[layer]._keyed = enabled != 0;
+    compositor->_layers[layer]._transparentCell = transparentCell;
+}
+
+void ConsoleCompositor_invalidate(ConsoleCompositor* compositor)
+{
+    memset(compositor->_dirtyTiles, 1, compositor->_tilesX * compositor->_tilesY);
+}
+
+// Marks the target tiles under every layer that changed since the last compose. Layers that were moved, shown, hidden,
+// rekeyed or had their buffer replaced mark both where they were and where they are, the rest only their dirty tiles
+static void ConsoleCompositor_collectChanges(ConsoleCompositor* compositor)
+{
+    for (int i = 0; i < compositor->_numLayers; i++)
+    {
+        ConsoleLayer* layer = &compositor->_layers[i];
+        ConsoleBuffer* buffer = layer->_buffer;
+        const ConsoleRect rect = ConsoleCompositor_layerRect(compositor, layer);
+
+        // Moves change what is shown even when the part inside the target stays the same
+        char changed = layer->_markCells != buffer->_cells || !ConsoleLayer_sameRect(rect, layer->_shownRect) || layer->_x != layer->_shownX || layer->_y != layer->_shownY;
+        changed = changed || layer->_keyed != layer->_shownKeyed || (layer->_keyed && layer->_transparentCell != layer->_shownTransparentCell);
+
+        if (changed)
+        {
+            const ConsoleRect shown = layer->_shownRect;
+            ConsoleCompositor_markRect(compositor, shown.left, shown.top, shown.right, shown.bottom);
+            ConsoleCompositor_markRect(compositor, rect.left, rect.top, rect.right, rect.bottom);
+        }
+        else if (rect.left < rect.right)
+        {
+            // The layer's tiles inside the target, which land on up to four target tiles each unless its offset is tile aligned
+            for (int tileY = (rect.top - layer->_y) / CONSOLE_TILE_HEIGHT; tileY <= (rect.bottom - 1 - layer->_y) / CONSOLE_TILE_HEIGHT; tileY++)
+            {
+                for (int tileX = (rect.left - layer->_x) / CONSOLE_TILE_WIDTH; tileX <= (rect.right - 1 - layer->_x) / CONSOLE_TILE_WIDTH; tileX++)
+                {
+                    if (!ConsoleBuffer_isTileDirty(buffer, tileX, tileY, layer->_mark)) continue;
+
+                    int left = layer->_x + tileX * CONSOLE_TILE_WIDTH;
+                    int top = layer->_y + tileY * CONSOLE_TILE_HEIGHT;
+                    ConsoleCompositor_markRect(compositor, left, top, left + CONSOLE_TILE_WIDTH, top + CONSOLE_TILE_HEIGHT);
+                }
+            }
+        }
+
+        layer->_mark = ConsoleBuffer_takeDirtyMark(buffer);
+        layer->_markCells = buffer->_cells;
+        layer->_shownRect = rect;
+        layer->_shownX = layer->_x;
+        layer->_shownY = layer->_y;
+        layer->_shownKeyed = layer->_keyed;
+        layer->_shownTransparentCell = layer->_transparentCell;
+    }
+}
+
+// Appends the parts of left to right not in covered as pieces of the given layer, returning how many
+static int ConsoleCompositor_uncovered(const ConsoleLayerSpan* covered, int numCovered, int layer, int left, int right, ConsoleLayerPiece* pieces)
+{
+    int numPieces = 0;
+    for (int i = 0; i < numCovered && left < right; i++)
+    {
+        if (covered[i].right <= left) continue;
+        if (covered[i].left >= right) break;
+
+        if (covered[i].left > left) pieces[numPieces++] = (ConsoleLayerPiece){layer, left, covered[i].left};
+        left = covered[i].right;
+    }
+
+    if (left < right) pieces[numPieces++] = (ConsoleLayerPiece){layer, left, right};
+    return numPieces;
+}
+
+// Adds left to right to covered, merging the spans it overlaps or touches. Returns the new span count
+static int ConsoleCompositor_cover(ConsoleLayerSpan* covered, int numCovered, int left, int right)
+{
+    int first = 0;
+    while (first < numCovered && covered[first].right < left) first++;
+
+    int last = first;
+    while (last < numCovered && covered[last].left <= right)
+    {
+        left = min(left, covered[last].left);
+        right = max(right, covered[last].right);
+        last++;
+    }
+
+    memmove(&covered[first + 1], &covered[last], (numCovered - last) * sizeof(ConsoleLayerSpan));
+    covered[first] = (ConsoleLayerSpan){left, right};
+    return numCovered - (last - first) + 1;
+}
+
+// Composes columns left to right of rows top to bottom, which every layer either spans completely or not at all
+static void ConsoleCompositor_composeRows(ConsoleCompositor* compositor, ConsoleBuffer* target, int left, int right, int top, int bottom, ConsoleLayerSpan* covered, ConsoleLayerPiece* pieces)
+{
+    const int rows = bottom - top;
+    int numCovered = 0;
+    int numPieces = 0;
+
+    // Top down, each layer only gets the columns no opaque layer above it covers
+    for (int i = compositor->_numLayers - 1; i >= 0; i--)
+    {
+        const ConsoleLayer* layer = &compositor->_layers[i];
+        const ConsoleRect rect = layer->_shownRect;
+        if (rect.top > top || rect.bottom < bottom) continue;
+
+        int from = max(rect.left, left);
+        int to = min(rect.right, right);
+        if (from >= to) continue;
+
+        int added = ConsoleCompositor_uncovered(covered, numCovered, i, from, to, &pieces[numPieces]);
+        int visible = 0;
+        for (int p = numPieces; p < numPieces + added; p++) visible += pieces[p].right - pieces[p].left;
+
+        compositor->_stats.occluded += (to - from - visible) * rows;
+        numPieces += added;
+
+        if (!layer->_keyed) numCovered = ConsoleCompositor_cover(covered, numCovered, from, to);
+    }
+
+    numPieces += ConsoleCompositor_uncovered(covered, numCovered, -1, left, right, &pieces[numPieces]);
+
+    // Drawn bottom up, so keyed layers land on whatever is below them
+    for (int p = numPieces - 1; p >= 0; p--)
+    {
+        const ConsoleLayerPiece* piece = &pieces[p];
+        const int width = piece->right - piece->left;
+        compositor->_stats.cells += width * rows;
+
+        if (piece->layer < 0)
+        {
+            ConsoleBuffer_drawRect(target, piece->left, top, width, rows, CONSOLE_CELL_CHAR(compositor->background), CONSOLE_CELL_ATTRIB(compositor->background));
+            continue;
+        }
+
+        const ConsoleLayer* layer = &compositor->_layers[piece->layer];
+        if (layer->_keyed)
+        {
+            ConsoleBuffer_blitMasked(target, layer->_buffer, piece->left, top, piece->left - layer->_x, top - layer->_y, width, rows, layer->_transparentCell);
+        }
+        else
+        {
+            ConsoleBuffer_blit(target, layer->_buffer, piece->left, top, piece->left - layer->_x, top - layer->_y, width, rows);
+        }
+    }
+}
+
+void ConsoleCompositor_compose(ConsoleCompositor* compositor, ConsoleBuffer* target)
+{
+    memset(&compositor->_stats, 0, sizeof(compositor->_stats));
+
+    if (target->_cells != compositor->_targetCells)
+    {
+        ConsoleCompositor_invalidate(compositor);
+        compositor->_targetCells = target->_cells;
+    }
+
+    ConsoleCompositor_collectChanges(compositor);
+
+    // Each opaque layer adds at most one covered span, and each layer's pieces fit in the gaps between them
+    const int numLayers = compositor->_numLayers;
+    ConsoleLayerSpan* covered = ConsoleArena_alloc(&compositor->_scratch, (numLayers + 1) * sizeof(ConsoleLayerSpan));
+    ConsoleLayerPiece* pieces = ConsoleArena_alloc(&compositor->_scratch, (size_t)(numLayers + 1) * (numLayers + 1) * sizeof(ConsoleLayerPiece));
+
+    for (int tileY = 0; tileY < compositor->_tilesY; tileY++)
+    {
+        uint8_t* dirty = &compositor->_dirtyTiles[tileY * compositor->_tilesX];
+        const int rowTop = tileY * CONSOLE_TILE_HEIGHT;
+        const int rowBottom = min(rowTop + CONSOLE_TILE_HEIGHT, compositor->height);
+
+        for (int tileX = 0; tileX < compositor->_tilesX;)
+        {
+            if (!dirty[tileX])
+            {
+                tileX++;
+                continue;
+            }
+
+            int tileEnd = tileX + 1;
+            while (tileEnd < compositor->_tilesX && dirty[tileEnd]) tileEnd++;
+
+            const int left = tileX * CONSOLE_TILE_WIDTH;
+            const int right = min(tileEnd * CONSOLE_TILE_WIDTH, compositor->width);
+            compositor->_stats.tiles += tileEnd - tileX;
+
+            // Split the rows where layers start or end, so every layer spans each range completely or not at all
+            for (int y = rowTop; y < rowBottom;)
+            {
+                int next = rowBottom;
+                for (int i = 0; i < numLayers; i++)
+                {
+                    const ConsoleRect rect = compositor->_layers[i]._shownRect;
+                    if (rect.top > y) next = min(next, rect.top);
+                    if (rect.bottom > y) next = min(next, rect.bottom);
+                }
+
+                ConsoleCompositor_composeRows(compositor, target, left, right, y, next, covered, pieces);
+                y = next;
+            }
+
+            memset(&dirty[tileX], 0, tileEnd - tileX);
+            tileX = tileEnd;
+        }
+    }
+
+    ConsoleArena_reset(&compositor->_scratch);
+}
+
+void ConsoleCompositor_display(ConsoleCompositor* compositor, Console* console)
+{
+    ConsoleCompositor_compose(compositor, &console->consoleBuffer);
+    Console_display(console);
+}
+
+ConsoleCompositorStats ConsoleCompositor_getStats(const ConsoleCompositor* compositor)
+{
+    return compositor->_stats;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+//
+// --- Layer compositor, stacks ConsoleBuffers and recomposes only the tiles whose layers changed
+//
+
+#pragma once
+
+#include "console.h"
+
+typedef struct ConsoleLayer
+{
+    // Not owned, must stay alive while the layer is in the compositor
+    ConsoleBuffer* _buffer;
+    int _x;
+    int _y;
+    char _visible;
+
+    // Keyed layers leave out cells equal to _transparentCell, showing the layers below through them
+    char _keyed;
+    ConsoleCell _transparentCell;
+
+    // What was composed last time, compared on the next compose to find what changed
+    uint32_t _mark;
+    const ConsoleCell* _markCells;
+    ConsoleRect _shownRect;
+    int _shownX;
+    int _shownY;
+    char _shownKeyed;
+    ConsoleCell _shownTransparentCell;
+} ConsoleLayer;
+
+typedef struct ConsoleCompositorStats
+{
+    // Tiles recomposed, cells written to the target, and cells of lower layers skipped because an opaque layer covered them
+    int tiles;
+    int cells;
+    int occluded;
+} ConsoleCompositorStats;
+
+// Layers are composed in the order they were added, later layers on top, onto a background cell where no opaque layer
+// covers the target
+typedef struct ConsoleCompositor
+{
+    int width;
+    int height;
+
+    // Call ConsoleCompositor_invalidate after changing it
+    ConsoleCell background;
+
+    ConsoleLayer* _layers;
+    int _numLayers;
+    int _layerCapacity;
+
+    // Tiles of the target to recompose, in CONSOLE_TILE_WIDTH x CONSOLE_TILE_HEIGHT tiles
+    uint8_t* _dirtyTiles;
+    int _tilesX;
+    int _tilesY;
+
+    // The target composed into last, anything else gets a full compose
+    const ConsoleCell* _targetCells;
+
+    // Visible pieces of each layer per row range, reset every compose
+    ConsoleArena _scratch;
+
+    ConsoleCompositorStats _stats;
+} ConsoleCompositor;
+
+// Composes width x height targets
+ConsoleCompositor ConsoleCompositor_create(int width, int height, ConsoleCell background);
+void ConsoleCompositor_destroy(ConsoleCompositor* compositor);
+
+// Adds a visible, opaque layer on top of the others with its top left corner at (x, y), returning its index. Enables dirty
+// tracking on the buffer, so writes to it mark only the tiles they touch. The buffer must not be a compose target
+int ConsoleCompositor_addLayer(ConsoleCompositor* compositor, ConsoleBuffer* buffer, int x, int y);
+
+void ConsoleCompositor_setLayerPosition(ConsoleCompositor* compositor, int layer, int x, int y);
+void ConsoleCompositor_setLayerVisible(ConsoleCompositor* compositor, int layer, char visible);
+
+// Keys out cells equal to transparentCell when enabled. Opaque layers are cheaper, cells below them are never composed
+void ConsoleCompositor_setLayerTransparency(ConsoleCompositor* compositor, int layer, char enabled, ConsoleCell transparentCell);
+
+// Recomposes everything on the next compose, e.g. after writing to the target directly
+void ConsoleCompositor_invalidate(ConsoleCompositor* compositor);
+
+// Recomposes the tiles covered by layers that were written, moved, shown, hidden or rekeyed since the last compose into
+// the target, which must be the compositor's size. Tiles that did not change are left alone, so with dirty tracking on
+// the target Console_display only looks at the recomposed ones
+void ConsoleCompositor_compose(ConsoleCompositor* compositor, ConsoleBuffer* target);
+
+// Composes into the console's buffer and displays it
+void ConsoleCompositor_display(ConsoleCompositor* compositor, Console* console);
+
+// Counts from the last compose
+ConsoleCompositorStats ConsoleCompositor_getStats(const ConsoleCompositor* compositor);
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "console_present.h"
+
+typedef struct ConsolePresentFrame
+{
+    ConsoleBuffer buffer;
+    double submitTime;
+
+    // Set when the console was invalidated, so the window is redrawn in full
+    char redraw;
+} ConsolePresentFrame;
+
+struct ConsolePresentShared
+{
+    ConsoleMutex mutex;
+    ConsoleCondition ready;
+    ConsoleThread thread;
+
+    // Writes to the window from the output thread, with its own front buffer and output state
+    Console presenter;
+
+    // Presenter the console had before the thread started, restored when it stops
+    ConsolePresenter previous;
+
+    // The caller fills one frame, one holds the latest finished frame and the output thread writes the third,
+    // so neither side waits for the other. Indices are swapped under the mutex
+    ConsolePresentFrame frames[3];
+    int filling;
+    int pending;
+    int writing;
+    char hasPending;
+    char quit;
+
+    ConsolePresentStats stats;
+    double totalLatency;
+};
+
+static void ConsolePresentThread_present(void* userData, Console* console)
+{
+    ConsolePresentShared* shared = userData;
+    const ConsoleBuffer* back = &console->consoleBuffer;
+
+    // The caller owns the filling frame, so the copy happens outside the lock. Colour planes go with the cells
+    ConsolePresentFrame* frame = &shared->frames[shared->filling];
+    ConsoleBuffer_copyInto(&frame->buffer, back);
+    frame->submitTime = Console_getTime();
+
+    // The scroll moves to the frame, so it is repeated on the window only once
+    frame->buffer._scrollRect = back->_scrollRect;
+    frame->buffer._scrollDy = back->_scrollDy;
+    console->consoleBuffer._scrollDy = 0;
+    frame->redraw = !console->_frontBufferValid;
+    console->_frontBufferValid = 1;
+
+    ConsoleMutex_lock(&shared->mutex);
+    if (shared->hasPending)
+    {
+        // The frame being replaced is dropped, but a redraw it asked for still has to happen
+        const ConsolePresentFrame* dropped = &shared->frames[shared->pending];
+        frame->redraw |= dropped->redraw;
+        shared->stats.droppedFrames++;
+
+        // Its scroll happened first, and adds to one of the same rect. Otherwise the later one is kept
+        ConsoleBuffer* buffer = &frame->buffer;
+        const char sameRect = memcmp(&buffer->_scrollRect, &dropped->buffer._scrollRect, sizeof(ConsoleRect)) == 0;
+        if (dropped->buffer._scrollDy != 0 && (buffer->_scrollDy == 0 || sameRect))
+        {
+            buffer->_scrollRect = dropped->buffer._scrollRect;
+            buffer->_scrollDy += dropped->buffer._scrollDy;
+            if (abs(buffer->_scrollDy) >= buffer->_scrollRect.bottom - buffer->_scrollRect.top) buffer->_scrollDy = 0;
+        }
+    }
+
+    int swap = shared->pending;
+    shared->pending = shared->filling;
+    shared->filling = swap;
+    shared->hasPending = 1;
+    ConsoleCondition_signal(&shared->ready);
+    ConsoleMutex_unlock(&shared->mutex);
+}
+
+static void ConsolePresentThread_main(void* userData)
+{
+    ConsolePresentShared* shared = userData;
+    Console* presenter = &shared->presenter;
+
+    ConsoleMutex_lock(&shared->mutex);
+    while (1)
+    {
+        while (!shared->hasPending && !shared->quit)
+        {
+            ConsoleCondition_wait(&shared->ready, &shared->mutex);
+        }
+
+        // A frame handed over before stopping is still written
+        if (!shared->hasPending) break;
+
+        int swap = shared->writing;
+        shared->writing = shared->pending;
+        shared->pending = swap;
+        shared->hasPending = 0;
+        ConsoleMutex_unlock(&shared->mutex);
+
+        ConsolePresentFrame* frame = &shared->frames[shared->writing];
+        ConsoleBuffer buffer = presenter->consoleBuffer;
+        presenter->consoleBuffer = frame->buffer;
+        frame->buffer = buffer;
+
+        if (frame->redraw) Console_invalidate(presenter);
+        Console_display(presenter);
+
+        double latency = Console_getTime() - frame->submitTime;
+
+        ConsoleMutex_lock(&shared->mutex);
+        shared->stats.presentedFrames++;
+        shared->stats.lastLatency = latency;
+        shared->stats.maxLatency = max(shared->stats.maxLatency, latency);
+        shared->totalLatency += latency;
+        shared->stats.averageLatency = shared->totalLatency / shared->stats.presentedFrames;
+    }
+    ConsoleMutex_unlock(&shared->mutex);
+}
+
+ConsolePresentThread ConsolePresentThread_start(Console* console)
+{
+    ConsolePresentThread presentThread;
+    presentThread._shared = NULL;
+
+    const int width = console->consoleBuffer.width;
+    const int height = console->consoleBuffer.height;
+
+    ConsolePresentShared* shared = malloc(sizeof(ConsolePresentShared));
+    CONSOLE_PROFILE_ALLOCATION();
+    memset(shared, 0, sizeof(ConsolePresentShared));
+    ConsoleMutex_init(&shared->mutex);
+    ConsoleCondition_init(&shared->ready);
+
+    shared->presenter = Console_forkPresenter(console);
+    shared->previous = console->_presenter;
+    for (int i = 0; i < 3; i++)
+    {
+        shared->frames[i].buffer = ConsoleBuffer_create(width, height);
+    }
+    shared->filling = 0;
+    shared->pending = 1;
+    shared->writing = 2;
+
+    if (!ConsoleThread_start(&shared->thread, ConsolePresentThread_main, shared))
+    {
+        Console_joinPresenter(console, &shared->presenter);
+        for (int i = 0; i < 3; i++)
+        {
+            ConsoleBuffer_destroy(&shared->frames[i].buffer);
+        }
+        ConsoleCondition_destroy(&shared->ready);
+        ConsoleMutex_destroy(&shared->mutex);
+        free(shared);
+        return presentThread;
+    }
+
+    ConsolePresenter presenter;
+    presenter.present = ConsolePresentThread_present;
+    presenter.userData = shared;
+    Console_setPresenter(console, &presenter);
+
+    presentThread._shared = shared;
+    return presentThread;
+}
+
+void ConsolePresentThread_stop(ConsolePresentThread* presentThread, Console* console)
+{
+    ConsolePresentShared* shared = presentThread->_shared;
+    if (!shared) return;
+
+    ConsoleMutex_lock(&shared->mutex);
+    shared->quit = 1;
+    ConsoleCondition_signal(&shared->ready);
+    ConsoleMutex_unlock(&shared->mutex);
+    ConsoleThread_join(&shared->thread);
+
+    Console_setPresenter(console, shared->previous.present ? &shared->previous : NULL);
+    Console_joinPresenter(console, &shared->presenter);
+
+    for (int i = 0; i < 3; i++)
+    {
+        ConsoleBuffer_destroy(&shared->frames[i].buffer);
+    }
+    ConsoleCondition_destroy(&shared->ready);
+    ConsoleMutex_destroy(&shared->mutex);
+    free(shared);
+
+    presentThread->_shared = NULL;
+}
+
+ConsolePresentStats ConsolePresentThread_getStats(const ConsolePresentThread* presentThread)
+{
+    ConsolePresentShared* shared = presentThread->_shared;
+
+    ConsolePresentStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!shared) return stats;
+
+    ConsoleMutex_lock(&shared->mutex);
+    stats = shared->stats;
+    ConsoleMutex_unlock(&shared->mutex);
+
+    return stats;
+}
\ No newline at end of file
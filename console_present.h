@@ -0,0 +1,41 @@
+//
+// --- Present thread, encodes and writes frames off the main thread with triple buffering
+//
+
+#pragma once
+
+#include "console.h"
+#include "console_thread.h"
+
+typedef struct ConsolePresentStats
+{
+    uint32_t presentedFrames;
+
+    // Frames replaced by a newer one before the output thread got to them
+    uint32_t droppedFrames;
+
+    // Seconds from Console_display to the frame being written out
+    double lastLatency;
+    double averageLatency;
+    double maxLatency;
+} ConsolePresentStats;
+
+typedef struct ConsolePresentShared ConsolePresentShared;
+
+// While running, Console_display copies the frame into a free buffer and returns, and the output thread writes the latest
+// finished frame. Frames the thread has not started on are replaced rather than queued, so a slow terminal drops frames
+// instead of holding up the caller. Stop it before Console_clearWindow, changing present settings or destroying the console.
+// A presenter set before starting, like a recorder, runs on the output thread for each frame that is written
+typedef struct ConsolePresentThread
+{
+    ConsolePresentShared* _shared;
+} ConsolePresentThread;
+
+// Leaves _shared NULL if the thread could not be started, Console_display then presents directly
+ConsolePresentThread ConsolePresentThread_start(Console* console);
+
+// Writes out the last frame, then hands the window back to the console
+void ConsolePresentThread_stop(ConsolePresentThread* presentThread, Console* console);
+
+// All zero if the thread did not start or has been stopped
+ConsolePresentStats ConsolePresentThread_getStats(const ConsolePresentThread* presentThread);
\ No newline at end of file
@@ -0,0 +1,818 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "console_record.h"
+#include "console_thread.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// File layout, in the byte order of the machine that recorded it:
+//   ConsoleRecordHeader
+//   per frame a ConsoleRecordFrameHeader, then width * height cells for a keyframe, or for a delta
+//   runs of changed cells, each a ConsoleRecordRun followed by its cells
+//   the keyframe index as ConsoleRecordIndexEntry records, then a ConsoleRecordTrailer, written when the recorder is closed
+
+#define CONSOLE_RECORD_VERSION 1
+
+// Unchanged gaps shorter than a run header are stored as cells rather than starting a new run
+#define CONSOLE_RECORD_GAP_MAX ((int)(sizeof(ConsoleRecordRun) / sizeof(ConsoleCell)))
+
+// Queued frames go to the writer thread in lots of about this many bytes
+#define CONSOLE_RECORD_QUEUE_SIZE (1 << 16)
+
+enum
+{
+    CONSOLE_RECORD_KEYFRAME,
+    CONSOLE_RECORD_DELTA
+};
+
+typedef struct ConsoleRecordHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+} ConsoleRecordHeader;
+
+typedef struct ConsoleRecordFrameHeader
+{
+    double time;
+    uint32_t type;
+    uint32_t size;
+} ConsoleRecordFrameHeader;
+
+typedef struct ConsoleRecordRun
+{
+    uint32_t offset;
+    uint32_t count;
+} ConsoleRecordRun;
+
+typedef struct ConsoleRecordIndexEntry
+{
+    uint64_t offset;
+    uint32_t frame;
+    uint32_t reserved;
+} ConsoleRecordIndexEntry;
+
+typedef struct ConsoleRecordTrailer
+{
+    uint64_t indexOffset;
+    uint32_t numKeyframes;
+    uint32_t numFrames;
+    char magic[4];
+    uint32_t reserved;
+} ConsoleRecordTrailer;
+
+// Frames queued for the writer thread, one after another as they go in the file but with every frame a delta
+typedef struct ConsoleRecordQueue
+{
+    uint8_t* bytes;
+    size_t size;
+    size_t capacity;
+} ConsoleRecordQueue;
+
+struct ConsoleRecorderState
+{
+    int width;
+    int height;
+
+    // Last frame queued, deltas are taken against it, and the dirty mark taken when it was queued from markCells.
+    // Frames queued from the console's own diff leave previous stale until a frame is queued in full again
+    ConsoleCell* previous;
+    char previousStale;
+    uint32_t mark;
+    const ConsoleCell* markCells;
+
+    // Frames are queued into filling on the caller's side. Once enough are queued they are handed to the writer
+    // thread as pending, unless it is still busy writing the last lot
+    ConsoleRecordQueue filling;
+    ConsoleRecordQueue pending;
+    size_t frameStart;
+    char hasPending;
+    char quit;
+    char threaded;
+    ConsoleMutex mutex;
+    ConsoleCondition ready;
+    ConsoleCondition written;
+    ConsoleThread thread;
+
+    // Owned by the writer thread: the file, the frame the queued deltas build up, from which keyframes are written,
+    // and the keyframe index
+    FILE* file;
+    uint64_t offset;
+    ConsoleCell* cells;
+    int numFrames;
+    int sinceKeyframe;
+    size_t deltaBytes;
+    ConsoleRecordIndexEntry* keyframes;
+    int numKeyframes;
+    int keyframeCapacity;
+
+    // Presenter that was set when the recorder was attached, and the time frames are measured from
+    ConsolePresenter next;
+    double startTime;
+
+    // Whether the last frame queued is the last one the attached console showed, and the cells its changes are taken from
+    char matchesWindow;
+    const ConsoleCell* changeCells;
+};
+
+//
+// --- Recorder
+//
+
+static void ConsoleRecorder_addKeyframe(ConsoleRecorderState* state)
+{
+    if (state->numKeyframes == state->keyframeCapacity)
+    {
+        state->keyframeCapacity = max(state->keyframeCapacity * 2, 16);
+        state->keyframes = realloc(state->keyframes, state->keyframeCapacity * sizeof(ConsoleRecordIndexEntry));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+
+    ConsoleRecordIndexEntry entry = {state->offset, (uint32_t)state->numFrames, 0};
+    state->keyframes[state->numKeyframes++] = entry;
+    state->sinceKeyframe = 0;
+    state->deltaBytes = 0;
+}
+
+// Applies each queued delta to cells and writes it, or cells as a keyframe when one is due or the delta is no smaller
+static void ConsoleRecorder_writeFrames(ConsoleRecorderState* state, const ConsoleRecordQueue* queue)
+{
+    const size_t frameSize = state->width * state->height * sizeof(ConsoleCell);
+
+    size_t position = 0;
+    while (position < queue->size)
+    {
+        ConsoleRecordFrameHeader header;
+        memcpy(&header, &queue->bytes[position], sizeof(header));
+        const uint8_t* frame = &queue->bytes[position];
+        position += sizeof(header) + header.size;
+
+        size_t runPosition = sizeof(header);
+        while (runPosition < sizeof(header) + header.size)
+        {
+            ConsoleRecordRun run;
+            memcpy(&run, &frame[runPosition], sizeof(run));
+            memcpy(&state->cells[run.offset], &frame[runPosition + sizeof(run)], run.count * sizeof(ConsoleCell));
+            runPosition += sizeof(run) + run.count * sizeof(ConsoleCell);
+        }
+
+        // Keyframes wait until the deltas since the last one add up to one, so a mostly still screen is not written out
+        // in full every interval
+        const char keyframeDue = state->sinceKeyframe >= CONSOLE_RECORD_KEYFRAME_INTERVAL && state->deltaBytes >= frameSize;
+        if (state->numFrames > 0 && !keyframeDue && header.size < frameSize)
+        {
+            fwrite(frame, 1, sizeof(header) + header.size, state->file);
+            state->offset += sizeof(header) + header.size;
+            state->deltaBytes += sizeof(header) + header.size;
+        }
+        else
+        {
+            ConsoleRecorder_addKeyframe(state);
+            header.type = CONSOLE_RECORD_KEYFRAME;
+            header.size = (uint32_t)frameSize;
+            fwrite(&header, sizeof(header), 1, state->file);
+            fwrite(state->cells, 1, frameSize, state->file);
+            state->offset += sizeof(header) + frameSize;
+        }
+
+        state->numFrames++;
+        state->sinceKeyframe++;
+    }
+}
+
+static void ConsoleRecorder_main(void* userData)
+{
+    ConsoleRecorderState* state = userData;
+
+    ConsoleMutex_lock(&state->mutex);
+    while (1)
+    {
+        while (!state->hasPending && !state->quit)
+        {
+            ConsoleCondition_wait(&state->ready, &state->mutex);
+        }
+
+        // Frames handed over before stopping are still written
+        if (!state->hasPending) break;
+        ConsoleMutex_unlock(&state->mutex);
+
+        ConsoleRecorder_writeFrames(state, &state->pending);
+        state->pending.size = 0;
+
+        ConsoleMutex_lock(&state->mutex);
+        state->hasPending = 0;
+        ConsoleCondition_signal(&state->written);
+    }
+    ConsoleMutex_unlock(&state->mutex);
+}
+
+// Hands the queued frames to the writer thread if it is idle, or writes them here without one
+static void ConsoleRecorder_flush(ConsoleRecorderState* state)
+{
+    if (!state->threaded)
+    {
+        ConsoleRecorder_writeFrames(state, &state->filling);
+        state->filling.size = 0;
+        return;
+    }
+
+    ConsoleMutex_lock(&state->mutex);
+    if (!state->hasPending)
+    {
+        ConsoleRecordQueue swap = state->pending;
+        state->pending = state->filling;
+        state->filling = swap;
+        state->hasPending = 1;
+        ConsoleCondition_signal(&state->ready);
+    }
+    ConsoleMutex_unlock(&state->mutex);
+}
+
+ConsoleRecorder ConsoleRecorder_create(const char* path, int width, int height)
+{
+    ConsoleRecorder recorder;
+    recorder._state = NULL;
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return recorder;
+
+    // Deltas are small and frequent, a large buffer gathers them into fewer writes
+    setvbuf(file, NULL, _IOFBF, 1 << 16);
+
+    ConsoleRecordHeader header = {{'C', 'R', 'E', 'C'}, CONSOLE_RECORD_VERSION, (uint32_t)width, (uint32_t)height};
+    fwrite(&header, sizeof(header), 1, file);
+
+    ConsoleRecorderState* state = malloc(sizeof(ConsoleRecorderState));
+    CONSOLE_PROFILE_ALLOCATION();
+    memset(state, 0, sizeof(ConsoleRecorderState));
+    state->file = file;
+    state->width = width;
+    state->height = height;
+    state->offset = sizeof(header);
+    state->previous = malloc(width * height * sizeof(ConsoleCell));
+    CONSOLE_PROFILE_ALLOCATION();
+    state->previousStale = 1;
+    state->cells = malloc(width * height * sizeof(ConsoleCell));
+    CONSOLE_PROFILE_ALLOCATION();
+
+    // Without a thread the frames are written as they are queued
+    ConsoleMutex_init(&state->mutex);
+    ConsoleCondition_init(&state->ready);
+    ConsoleCondition_init(&state->written);
+    state->threaded = ConsoleThread_start(&state->thread, ConsoleRecorder_main, state);
+
+    recorder._state = state;
+    return recorder;
+}
+
+void ConsoleRecorder_destroy(ConsoleRecorder* recorder)
+{
+    ConsoleRecorderState* state = recorder->_state;
+    if (!state) return;
+
+    if (state->threaded)
+    {
+        // The last frames are handed over once the writer has finished the ones before them
+        ConsoleMutex_lock(&state->mutex);
+        while (state->hasPending)
+        {
+            ConsoleCondition_wait(&state->written, &state->mutex);
+        }
+        ConsoleMutex_unlock(&state->mutex);
+        ConsoleRecorder_flush(state);
+
+        ConsoleMutex_lock(&state->mutex);
+        state->quit = 1;
+        ConsoleCondition_signal(&state->ready);
+        ConsoleMutex_unlock(&state->mutex);
+        ConsoleThread_join(&state->thread);
+    }
+    else
+    {
+        ConsoleRecorder_flush(state);
+    }
+
+    ConsoleRecordTrailer trailer = {state->offset, (uint32_t)state->numKeyframes, (uint32_t)state->numFrames, {'C', 'I', 'D', 'X'}, 0};
+    fwrite(state->keyframes, sizeof(ConsoleRecordIndexEntry), state->numKeyframes, state->file);
+    fwrite(&trailer, sizeof(trailer), 1, state->file);
+    fclose(state->file);
+
+    ConsoleCondition_destroy(&state->ready);
+    ConsoleCondition_destroy(&state->written);
+    ConsoleMutex_destroy(&state->mutex);
+    free(state->previous);
+    free(state->cells);
+    free(state->keyframes);
+    free(state->filling.bytes);
+    free(state->pending.bytes);
+    free(state);
+
+    recorder->_state = NULL;
+}
+
+static void ConsoleRecorder_reserve(ConsoleRecorderState* state, size_t size)
+{
+    ConsoleRecordQueue* queue = &state->filling;
+    if (queue->size + size > queue->capacity)
+    {
+        queue->capacity = max(queue->capacity * 2, queue->size + size);
+        queue->bytes = realloc(queue->bytes, queue->capacity);
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+}
+
+static void ConsoleRecorder_appendRun(ConsoleRecorderState* state, int offset, const ConsoleCell* cells, int count)
+{
+    size_t size = sizeof(ConsoleRecordRun) + count * sizeof(ConsoleCell);
+    ConsoleRecorder_reserve(state, size);
+
+    ConsoleRecordQueue* queue = &state->filling;
+    ConsoleRecordRun run = {(uint32_t)offset, (uint32_t)count};
+    memcpy(&queue->bytes[queue->size], &run, sizeof(run));
+    memcpy(&queue->bytes[queue->size + sizeof(run)], cells, count * sizeof(ConsoleCell));
+    queue->size += size;
+}
+
+// Starts a frame in the queue, its runs follow and ConsoleRecorder_endFrame fills in the header
+static void ConsoleRecorder_beginFrame(ConsoleRecorderState* state)
+{
+    ConsoleRecorder_reserve(state, sizeof(ConsoleRecordFrameHeader));
+    state->frameStart = state->filling.size;
+    state->filling.size += sizeof(ConsoleRecordFrameHeader);
+}
+
+static void ConsoleRecorder_endFrame(ConsoleRecorderState* state, double time)
+{
+    ConsoleRecordQueue* queue = &state->filling;
+    ConsoleRecordFrameHeader header = {time, CONSOLE_RECORD_DELTA, (uint32_t)(queue->size - state->frameStart - sizeof(header))};
+    memcpy(&queue->bytes[state->frameStart], &header, sizeof(header));
+
+    if (queue->size >= CONSOLE_RECORD_QUEUE_SIZE) ConsoleRecorder_flush(state);
+}
+
+// Queues the cells of row y within [start, end) that differ from the previous frame, updating previous as it goes
+static void ConsoleRecorder_encodeSpan(ConsoleRecorderState* state, const ConsoleCell* cells, int y, int start, int end)
+{
+    const ConsoleCell* row = &cells[y * state->width];
+    ConsoleCell* previousRow = &state->previous[y * state->width];
+    if (memcmp(&row[start], &previousRow[start], (end - start) * sizeof(ConsoleCell)) == 0) return;
+
+    int x = start;
+    while (1)
+    {
+        while (x < end && row[x] == previousRow[x]) x++;
+        if (x >= end) break;
+
+        int runEnd = x + 1;
+        while (runEnd < end)
+        {
+            if (row[runEnd] != previousRow[runEnd])
+            {
+                runEnd++;
+                continue;
+            }
+
+            int gapEnd = runEnd;
+            while (gapEnd < end && gapEnd - runEnd <= CONSOLE_RECORD_GAP_MAX && row[gapEnd] == previousRow[gapEnd]) gapEnd++;
+            if (gapEnd >= end || gapEnd - runEnd > CONSOLE_RECORD_GAP_MAX) break;
+            runEnd = gapEnd;
+        }
+
+        ConsoleRecorder_appendRun(state, y * state->width + x, &row[x], runEnd - x);
+        memcpy(&previousRow[x], &row[x], (runEnd - x) * sizeof(ConsoleCell));
+        x = runEnd;
+    }
+}
+
+// Queues the frame as a delta against the previous one. With useMark only tiles written since mark are compared
+static void ConsoleRecorder_encodeDelta(ConsoleRecorderState* state, const ConsoleBuffer* consoleBuffer, uint32_t mark, char useMark)
+{
+    if (!useMark || !consoleBuffer->_tileStamps)
+    {
+        for (int y = 0; y < state->height; y++)
+        {
+            ConsoleRecorder_encodeSpan(state, consoleBuffer->_cells, y, 0, state->width);
+        }
+        return;
+    }
+
+    // Spans of dirty tiles are found once per row of tiles, then compared row by row
+    for (int tileY = 0; tileY < consoleBuffer->_tilesY; tileY++)
+    {
+        const int top = tileY * CONSOLE_TILE_HEIGHT;
+        const int bottom = min(top + CONSOLE_TILE_HEIGHT, state->height);
+
+        int tileX = 0;
+        while (tileX < consoleBuffer->_tilesX)
+        {
+            if (!ConsoleBuffer_isTileDirty(consoleBuffer, tileX, tileY, mark))
+            {
+                tileX++;
+                continue;
+            }
+
+            int tileEnd = tileX + 1;
+            while (tileEnd < consoleBuffer->_tilesX && ConsoleBuffer_isTileDirty(consoleBuffer, tileEnd, tileY, mark)) tileEnd++;
+
+            const int start = tileX * CONSOLE_TILE_WIDTH;
+            const int end = min(tileEnd * CONSOLE_TILE_WIDTH, state->width);
+            for (int y = top; y < bottom; y++)
+            {
+                ConsoleRecorder_encodeSpan(state, consoleBuffer->_cells, y, start, end);
+            }
+            tileX = tileEnd;
+        }
+    }
+}
+
+
+// Queues every cell, for the first frame and whenever the frame before is not known
+static void ConsoleRecorder_queueCells(ConsoleRecorderState* state, const ConsoleCell* cells, double time)
+{
+    ConsoleRecorder_beginFrame(state);
+    ConsoleRecorder_appendRun(state, 0, cells, state->width * state->height);
+    ConsoleRecorder_endFrame(state, time);
+}
+
+static void ConsoleRecorder_record(ConsoleRecorderState* state, ConsoleBuffer* consoleBuffer, double time)
+{
+    // A mark only says what changed in the buffer it was taken from, e.g. not after moving to a present thread
+    const uint32_t mark = state->mark;
+    const char useMark = state->markCells == consoleBuffer->_cells;
+    state->mark = ConsoleBuffer_takeDirtyMark(consoleBuffer);
+    state->markCells = consoleBuffer->_cells;
+
+    if (state->previousStale)
+    {
+        memcpy(state->previous, consoleBuffer->_cells, state->width * state->height * sizeof(ConsoleCell));
+        state->previousStale = 0;
+        ConsoleRecorder_queueCells(state, consoleBuffer->_cells, time);
+        return;
+    }
+
+    ConsoleRecorder_beginFrame(state);
+    ConsoleRecorder_encodeDelta(state, consoleBuffer, mark, useMark);
+    ConsoleRecorder_endFrame(state, time);
+}
+
+void ConsoleRecorder_addFrame(ConsoleRecorder* recorder, ConsoleBuffer* consoleBuffer, double time)
+{
+    ConsoleRecorder_record(recorder->_state, consoleBuffer, time);
+    recorder->_state->matchesWindow = 0;
+}
+
+// Queues a run the console wrote while presenting as part of the frame
+static void ConsoleRecorder_addChange(void* userData, int y, int start, int end)
+{
+    ConsoleRecorderState* state = userData;
+    const int offset = y * state->width + start;
+    ConsoleRecorder_appendRun(state, offset, &state->changeCells[offset], end - start);
+}
+
+static void ConsoleRecorder_present(void* userData, Console* console)
+{
+    ConsoleRecorderState* state = userData;
+    const ConsoleCell* cells = console->consoleBuffer._cells;
+    const double time = Console_getTime() - state->startTime;
+
+    // A console presenting the frame itself diffs it against the last frame it showed. When that is the last frame
+    // queued, the runs it writes are the delta and the frame is not compared twice
+    const char selfPresented = !state->next.present;
+    const char useChanges = selfPresented && state->matchesWindow && console->_diffPresent && console->_frontBufferValid;
+
+    if (useChanges)
+    {
+        ConsoleRecorder_beginFrame(state);
+        state->changeCells = cells;
+        console->_changeSink = ConsoleRecorder_addChange;
+        console->_changeSinkData = state;
+    }
+    else if (selfPresented)
+    {
+        ConsoleRecorder_queueCells(state, cells, time);
+    }
+    else
+    {
+        ConsoleRecorder_record(state, &console->consoleBuffer, time);
+    }
+
+    // Hand the frame on as if the recorder were not there
+    ConsolePresenter self = console->_presenter;
+    console->_presenter = state->next;
+    Console_display(console);
+    console->_presenter = self;
+    console->_changeSink = NULL;
+
+    // previous is only kept up to date by frames the recorder compares itself
+    if (selfPresented) state->previousStale = 1;
+    if (useChanges) ConsoleRecorder_endFrame(state, time);
+    state->matchesWindow = 1;
+}
+
+void ConsoleRecorder_attach(ConsoleRecorder* recorder, Console* console)
+{
+    ConsoleRecorderState* state = recorder->_state;
+    state->next = console->_presenter;
+    state->startTime = Console_getTime();
+    state->matchesWindow = 0;
+
+    ConsolePresenter presenter;
+    presenter.present = ConsoleRecorder_present;
+    presenter.userData = state;
+    Console_setPresenter(console, &presenter);
+}
+
+void ConsoleRecorder_detach(ConsoleRecorder* recorder, Console* console)
+{
+    ConsoleRecorderState* state = recorder->_state;
+    Console_setPresenter(console, state->next.present ? &state->next : NULL);
+}
+
+//
+// --- Recording
+//
+
+static char ConsoleRecording_map(ConsoleRecording* recording, const char* path)
+{
+#ifdef _WIN32
+    recording->_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (recording->_file == INVALID_HANDLE_VALUE) return 0;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(recording->_file, &size) || size.QuadPart == 0) return 0;
+
+    recording->_mapping = CreateFileMappingA(recording->_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!recording->_mapping) return 0;
+
+    recording->_data = MapViewOfFile(recording->_mapping, FILE_MAP_READ, 0, 0, 0);
+    recording->_size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+
+    recording->_data = data;
+    recording->_size = status.st_size;
+#endif
+
+    return recording->_data != NULL;
+}
+
+static void ConsoleRecording_unmap(ConsoleRecording* recording)
+{
+#ifdef _WIN32
+    if (recording->_data) UnmapViewOfFile(recording->_data);
+    if (recording->_mapping) CloseHandle(recording->_mapping);
+    if (recording->_file && recording->_file != INVALID_HANDLE_VALUE) CloseHandle(recording->_file);
+    recording->_mapping = NULL;
+    recording->_file = NULL;
+#else
+    if (recording->_data) munmap((void*)recording->_data, recording->_size);
+#endif
+
+    recording->_data = NULL;
+    recording->_size = 0;
+}
+
+static void ConsoleRecording_addKeyframe(ConsoleRecording* recording, int frame, size_t offset, int* capacity)
+{
+    if (recording->_numKeyframes == *capacity)
+    {
+        *capacity = max(*capacity * 2, 16);
+        recording->_keyframes = realloc(recording->_keyframes, *capacity * sizeof(ConsoleRecordingKeyframe));
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+
+    recording->_keyframes[recording->_numKeyframes].frame = frame;
+    recording->_keyframes[recording->_numKeyframes].offset = offset;
+    recording->_numKeyframes++;
+}
+
+// Whether an index entry points at a whole keyframe within the frames, checked like ConsoleRecording_scanFrames checks frames
+static char ConsoleRecording_isKeyframeAt(const ConsoleRecording* recording, uint64_t offset, uint64_t end)
+{
+    const size_t keyframeSize = (size_t)recording->width * recording->height * sizeof(ConsoleCell);
+    if (offset < sizeof(ConsoleRecordHeader) || offset + sizeof(ConsoleRecordFrameHeader) > end) return 0;
+
+    ConsoleRecordFrameHeader header;
+    memcpy(&header, &recording->_data[offset], sizeof(header));
+    return header.type == CONSOLE_RECORD_KEYFRAME && header.size == keyframeSize && offset + sizeof(header) + header.size <= end;
+}
+
+// Reads the index written on close. Returns 0 if there is none or it does not hold up, leaving no keyframes
+static char ConsoleRecording_readIndex(ConsoleRecording* recording)
+{
+    ConsoleRecordTrailer trailer;
+    if (recording->_size < sizeof(ConsoleRecordHeader) + sizeof(trailer)) return 0;
+
+    memcpy(&trailer, &recording->_data[recording->_size - sizeof(trailer)], sizeof(trailer));
+    if (memcmp(trailer.magic, "CIDX", 4) != 0) return 0;
+    if (trailer.numKeyframes == 0 || trailer.numFrames > INT32_MAX || trailer.indexOffset > recording->_size) return 0;
+    if (trailer.indexOffset + (uint64_t)trailer.numKeyframes * sizeof(ConsoleRecordIndexEntry) + sizeof(trailer) != recording->_size) return 0;
+    if (trailer.indexOffset < sizeof(ConsoleRecordHeader) || trailer.numFrames > (trailer.indexOffset - sizeof(ConsoleRecordHeader)) / sizeof(ConsoleRecordFrameHeader)) return 0;
+
+    // Keyframes start at frame 0 and are in order of both frame and offset
+    int capacity = 0;
+    for (uint32_t i = 0; i < trailer.numKeyframes; i++)
+    {
+        ConsoleRecordIndexEntry entry;
+        memcpy(&entry, &recording->_data[trailer.indexOffset + i * sizeof(entry)], sizeof(entry));
+
+        const ConsoleRecordingKeyframe* previous = i > 0 ? &recording->_keyframes[i - 1] : NULL;
+        char valid = entry.frame < trailer.numFrames && ConsoleRecording_isKeyframeAt(recording, entry.offset, trailer.indexOffset);
+        if (previous) valid = valid && (int)entry.frame > previous->frame && entry.offset > previous->offset;
+        else valid = valid && entry.frame == 0;
+
+        if (!valid)
+        {
+            recording->_numKeyframes = 0;
+            return 0;
+        }
+
+        ConsoleRecording_addKeyframe(recording, entry.frame, entry.offset, &capacity);
+    }
+
+    recording->numFrames = trailer.numFrames;
+    return 1;
+}
+
+// Rebuilds the index by walking the frames, for recordings that were never closed
+static void ConsoleRecording_scanFrames(ConsoleRecording* recording)
+{
+    const size_t keyframeSize = (size_t)recording->width * recording->height * sizeof(ConsoleCell);
+    size_t offset = sizeof(ConsoleRecordHeader);
+    int capacity = recording->_numKeyframes;
+
+    recording->_numKeyframes = 0;
+    recording->numFrames = 0;
+
+    while (offset + sizeof(ConsoleRecordFrameHeader) <= recording->_size)
+    {
+        ConsoleRecordFrameHeader header;
+        memcpy(&header, &recording->_data[offset], sizeof(header));
+
+        if (offset + sizeof(header) + header.size > recording->_size) break;
+        if (header.type == CONSOLE_RECORD_KEYFRAME && header.size != keyframeSize) break;
+        if (header.type != CONSOLE_RECORD_KEYFRAME && header.type != CONSOLE_RECORD_DELTA) break;
+
+        // Deltas before the first keyframe have nothing to apply to
+        if (header.type == CONSOLE_RECORD_KEYFRAME)
+        {
+            ConsoleRecording_addKeyframe(recording, recording->numFrames, offset, &capacity);
+        }
+        else if (recording->_numKeyframes == 0)
+        {
+            break;
+        }
+
+        recording->numFrames++;
+        offset += sizeof(header) + header.size;
+    }
+}
+
+ConsoleRecording ConsoleRecording_open(const char* path)
+{
+    ConsoleRecording recording;
+    memset(&recording, 0, sizeof(recording));
+    recording._frame = -1;
+
+    ConsoleRecordHeader header;
+    if (!ConsoleRecording_map(&recording, path) || recording._size < sizeof(header))
+    {
+        ConsoleRecording_unmap(&recording);
+        return recording;
+    }
+
+    // Sizes past what a console can be, or with a keyframe larger than the file, are taken as corruption rather than
+    // allocating a frame for them
+    memcpy(&header, recording._data, sizeof(header));
+    if (memcmp(header.magic, "CREC", 4) != 0 || header.version != CONSOLE_RECORD_VERSION || header.width == 0 ||
+        header.height == 0 || header.width > 0xFFFF || header.height > 0xFFFF ||
+        (size_t)header.width * header.height * sizeof(ConsoleCell) > recording._size)
+    {
+        ConsoleRecording_unmap(&recording);
+        return recording;
+    }
+
+    recording.width = header.width;
+    recording.height = header.height;
+
+    if (!ConsoleRecording_readIndex(&recording))
+    {
+        ConsoleRecording_scanFrames(&recording);
+    }
+
+    recording._cells = malloc((size_t)recording.width * recording.height * sizeof(ConsoleCell));
+    CONSOLE_PROFILE_ALLOCATION();
+    if (!recording._cells) ConsoleRecording_close(&recording);
+    return recording;
+}
+
+void ConsoleRecording_close(ConsoleRecording* recording)
+{
+    ConsoleRecording_unmap(recording);
+
+    free(recording->_keyframes);
+    free(recording->_cells);
+    memset(recording, 0, sizeof(ConsoleRecording));
+}
+
+// Applies the frame at offset to _cells and returns the offset of the next frame
+static size_t ConsoleRecording_decodeFrame(ConsoleRecording* recording, size_t offset, double* time)
+{
+    const size_t numCells = (size_t)recording->width * recording->height;
+
+    // A frame running past the end, as an index can claim, is left out without moving on
+    ConsoleRecordFrameHeader header;
+    if (offset + sizeof(header) > recording->_size) return offset;
+    memcpy(&header, &recording->_data[offset], sizeof(header));
+    if (offset + sizeof(header) + header.size > recording->_size) return offset;
+    *time = header.time;
+
+    const uint8_t* payload = &recording->_data[offset + sizeof(header)];
+    if (header.type == CONSOLE_RECORD_KEYFRAME)
+    {
+        if (header.size != numCells * sizeof(ConsoleCell)) return offset + sizeof(header) + header.size;
+
+        memcpy(recording->_cells, payload, numCells * sizeof(ConsoleCell));
+        return offset + sizeof(header) + header.size;
+    }
+
+    size_t position = 0;
+    while (position + sizeof(ConsoleRecordRun) <= header.size)
+    {
+        ConsoleRecordRun run;
+        memcpy(&run, &payload[position], sizeof(run));
+        position += sizeof(run);
+
+        size_t runSize = run.count * sizeof(ConsoleCell);
+        if (run.offset + (size_t)run.count > numCells || position + runSize > header.size) break;
+
+        memcpy(&recording->_cells[run.offset], &payload[position], runSize);
+        position += runSize;
+    }
+
+    return offset + sizeof(header) + header.size;
+}
+
+double ConsoleRecording_readFrame(ConsoleRecording* recording, int frame, ConsoleBuffer* consoleBuffer)
+{
+    if (frame < 0 || frame >= recording->numFrames || recording->_numKeyframes == 0) return -1;
+
+    // Last keyframe at or before the frame
+    int low = 0;
+    int high = recording->_numKeyframes - 1;
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+        if (recording->_keyframes[middle].frame <= frame) low = middle;
+        else high = middle - 1;
+    }
+    const ConsoleRecordingKeyframe* keyframe = &recording->_keyframes[low];
+
+    // Carry on from the last decoded frame when it lies between the keyframe and the target
+    int current = keyframe->frame;
+    size_t offset = keyframe->offset;
+    double time = recording->_time;
+    if (recording->_frame >= keyframe->frame && recording->_frame <= frame)
+    {
+        current = recording->_frame + 1;
+        offset = recording->_nextOffset;
+    }
+
+    // Frames past one that could not be decoded cannot be reached either
+    for (; current <= frame; current++)
+    {
+        size_t next = ConsoleRecording_decodeFrame(recording, offset, &time);
+        if (next == offset) break;
+        offset = next;
+    }
+
+    recording->_frame = frame;
+    recording->_nextOffset = offset;
+    recording->_time = time;
+
+    memcpy(consoleBuffer->_cells, recording->_cells, (size_t)recording->width * recording->height * sizeof(ConsoleCell));
+    ConsoleBuffer_markDirty(consoleBuffer, 0, 0, recording->width, recording->height);
+
+    return time;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+//
+// --- Frame recording, keyframes and cell deltas in a compact binary file, and a memory mapped reader to replay them
+//
+
+#pragma once
+
+#include "console.h"
+
+// Keyframes are at least this many frames apart, and after that written once the deltas since the last one add up to a
+// keyframe's size. A seek applies this many deltas, or about a keyframe's worth of bytes of them, whichever is more
+#define CONSOLE_RECORD_KEYFRAME_INTERVAL 120
+
+typedef struct ConsoleRecorderState ConsoleRecorderState;
+
+typedef struct ConsoleRecorder
+{
+    ConsoleRecorderState* _state;
+} ConsoleRecorder;
+
+// Leaves _state NULL if the file could not be created. Frames are queued and written to the file by a thread of the
+// recorder's own, or as they are queued if it cannot be started
+ConsoleRecorder ConsoleRecorder_create(const char* path, int width, int height);
+
+// Writes the frames still queued and the keyframe index, and closes the file
+void ConsoleRecorder_destroy(ConsoleRecorder* recorder);
+
+// Appends a frame the size of the recording. time is in seconds and should not go backwards.
+// When consecutive frames come from the same buffer with dirty tracking enabled, only the tiles written in between are compared
+void ConsoleRecorder_addFrame(ConsoleRecorder* recorder, ConsoleBuffer* consoleBuffer, double time);
+
+// Records every frame the console displays, timed from now, then hands it to whichever presenter was set before.
+// With none set, the runs the console writes as it presents the frame are recorded rather than comparing the frame again.
+// Detach before stopping a presenter attached earlier, and before destroying the recorder. Attached before a
+// ConsolePresentThread starts, the recorder runs on the output thread and records the frames that are written
+void ConsoleRecorder_attach(ConsoleRecorder* recorder, Console* console);
+void ConsoleRecorder_detach(ConsoleRecorder* recorder, Console* console);
+
+typedef struct ConsoleRecordingKeyframe
+{
+    int frame;
+    size_t offset;
+} ConsoleRecordingKeyframe;
+
+// Read only view of a recording file. Frames can be read in any order, each seek starts from the nearest keyframe
+typedef struct ConsoleRecording
+{
+    int width;
+    int height;
+    int numFrames;
+
+    const uint8_t* _data;
+    size_t _size;
+#ifdef _WIN32
+    HANDLE _file;
+    HANDLE _mapping;
+#endif
+
+    ConsoleRecordingKeyframe* _keyframes;
+    int _numKeyframes;
+
+    // Last decoded frame, so reading frames in order only applies one delta each
+    ConsoleCell* _cells;
+    int _frame;
+    size_t _nextOffset;
+    double _time;
+} ConsoleRecording;
+
+// width and height are 0 if the file could not be read or its header is corrupt. Recordings that were not closed, e.g.
+// after a crash, are read up to their last complete frame
+ConsoleRecording ConsoleRecording_open(const char* path);
+void ConsoleRecording_close(ConsoleRecording* recording);
+
+// Decodes a frame into a buffer of the recording's size and returns its time, or a negative time if frame is out of range
+double ConsoleRecording_readFrame(ConsoleRecording* recording, int frame, ConsoleBuffer* consoleBuffer);
\ No newline at end of file
@@ -0,0 +1,318 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "console_shm.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+struct ConsoleSharedFrameState
+{
+    char* name;
+    void* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+
+    ConsoleSharedFrameHeader* header;
+    uint32_t* rowFrames;
+    uint64_t* dirtyRows;
+    ConsoleCell* cells;
+
+    // Dirty mark taken from markCells at the last publish, as for the recorder
+    uint32_t mark;
+    const ConsoleCell* markCells;
+
+    // Rows found to differ before the seqlock is taken, so readers are only held off while they are copied
+    int* changedRows;
+
+    ConsolePresenter next;
+};
+
+static size_t ConsoleSharedFrame_getSize(int width, int height, size_t* rowFramesOffset, size_t* dirtyRowsOffset, size_t* cellsOffset)
+{
+    *rowFramesOffset = sizeof(ConsoleSharedFrameHeader);
+    *dirtyRowsOffset = (*rowFramesOffset + height * sizeof(uint32_t) + 7) & ~(size_t)7;
+    *cellsOffset = *dirtyRowsOffset + (height + 63) / 64 * sizeof(uint64_t);
+    return *cellsOffset + width * height * sizeof(ConsoleCell);
+}
+
+// Finds the rows of the buffer that differ from the segment. With dirty tracking only rows of written tiles are compared
+static int ConsoleSharedFrame_findChangedRows(ConsoleSharedFrameState* state, ConsoleBuffer* consoleBuffer)
+{
+    const int width = consoleBuffer->width;
+    const uint32_t mark = state->mark;
+    const char useMark = state->markCells == consoleBuffer->_cells && consoleBuffer->_tileStamps;
+    state->mark = ConsoleBuffer_takeDirtyMark(consoleBuffer);
+    state->markCells = consoleBuffer->_cells;
+
+    int count = 0;
+    for (int y = 0; y < consoleBuffer->height; y++)
+    {
+        if (useMark && y % CONSOLE_TILE_HEIGHT == 0)
+        {
+            char dirty = 0;
+            for (int tileX = 0; tileX < consoleBuffer->_tilesX && !dirty; tileX++)
+            {
+                dirty = ConsoleBuffer_isTileDirty(consoleBuffer, tileX, y / CONSOLE_TILE_HEIGHT, mark);
+            }
+
+            if (!dirty)
+            {
+                y += CONSOLE_TILE_HEIGHT - 1;
+                continue;
+            }
+        }
+
+        if (memcmp(&consoleBuffer->_cells[y * width], &state->cells[y * width], width * sizeof(ConsoleCell)) != 0)
+        {
+            state->changedRows[count++] = y;
+        }
+    }
+
+    return count;
+}
+
+static void ConsoleSharedFrame_publish(ConsoleSharedFrameState* state, ConsoleBuffer* consoleBuffer)
+{
+    const int width = consoleBuffer->width;
+    const int count = ConsoleSharedFrame_findChangedRows(state, consoleBuffer);
+    if (count == 0) return;
+
+    ConsoleSharedFrameHeader* header = state->header;
+    const uint32_t sequence = (uint32_t)ConsoleAtomic_load(&header->sequence);
+    const uint32_t frame = header->frame + 1;
+
+    ConsoleAtomic_store(&header->sequence, (int)(sequence + 1));
+    ConsoleAtomic_fence();
+
+    memset(state->dirtyRows, 0, (consoleBuffer->height + 63) / 64 * sizeof(uint64_t));
+    for (int i = 0; i < count; i++)
+    {
+        const int y = state->changedRows[i];
+        memcpy(&state->cells[y * width], &consoleBuffer->_cells[y * width], width * sizeof(ConsoleCell));
+        state->rowFrames[y] = frame;
+        state->dirtyRows[y / 64] |= (uint64_t)1 << (y % 64);
+    }
+    header->frame = frame;
+
+    ConsoleAtomic_fence();
+    ConsoleAtomic_store(&header->sequence, (int)(sequence + 2));
+}
+
+static void ConsoleSharedFrame_present(void* userData, Console* console)
+{
+    ConsoleSharedFrameState* state = userData;
+    ConsoleSharedFrame_publish(state, &console->consoleBuffer);
+
+    ConsolePresenter self = console->_presenter;
+    console->_presenter = state->next;
+    Console_display(console);
+    console->_presenter = self;
+}
+
+static void* ConsoleSharedFrame_map(ConsoleSharedFrameState* state, size_t size)
+{
+#ifdef _WIN32
+    // Local\ names are per session, like POSIX names are per machine; the leading slash is dropped
+    state->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, state->name + (state->name[0] == '/'));
+    if (!state->mapping) return NULL;
+    return MapViewOfFile(state->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+    int fd = shm_open(state->name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) return NULL;
+
+    void* data = NULL;
+    if (ftruncate(fd, size) == 0)
+    {
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+    }
+    close(fd);
+
+    if (!data) shm_unlink(state->name);
+    return data;
+#endif
+}
+
+ConsoleSharedFrame ConsoleSharedFrame_create(Console* console, const char* name)
+{
+    ConsoleSharedFrame sharedFrame;
+    sharedFrame._state = NULL;
+
+    const int width = console->consoleBuffer.width;
+    const int height = console->consoleBuffer.height;
+
+    ConsoleSharedFrameState* state = malloc(sizeof(ConsoleSharedFrameState));
+    CONSOLE_PROFILE_ALLOCATION();
+    memset(state, 0, sizeof(ConsoleSharedFrameState));
+    state->name = malloc(strlen(name) + 1);
+    CONSOLE_PROFILE_ALLOCATION();
+    strcpy(state->name, name);
+
+    size_t rowFramesOffset;
+    size_t dirtyRowsOffset;
+    size_t cellsOffset;
+    state->size = ConsoleSharedFrame_getSize(width, height, &rowFramesOffset, &dirtyRowsOffset, &cellsOffset);
+    state->data = ConsoleSharedFrame_map(state, state->size);
+    if (!state->data)
+    {
+#ifdef _WIN32
+        if (state->mapping) CloseHandle(state->mapping);
+#endif
+        free(state->name);
+        free(state);
+        return sharedFrame;
+    }
+
+    uint8_t* data = state->data;
+    memset(data, 0, state->size);
+    state->header = (ConsoleSharedFrameHeader*)data;
+    state->rowFrames = (uint32_t*)&data[rowFramesOffset];
+    state->dirtyRows = (uint64_t*)&data[dirtyRowsOffset];
+    state->cells = (ConsoleCell*)&data[cellsOffset];
+    state->changedRows = malloc(height * sizeof(int));
+    CONSOLE_PROFILE_ALLOCATION();
+
+    state->header->width = width;
+    state->header->height = height;
+    ConsoleAtomic_fence();
+    memcpy(state->header->magic, "CSHM", 4);
+
+    state->next = console->_presenter;
+    ConsolePresenter presenter;
+    presenter.present = ConsoleSharedFrame_present;
+    presenter.userData = state;
+    Console_setPresenter(console, &presenter);
+
+    sharedFrame._state = state;
+    return sharedFrame;
+}
+
+void ConsoleSharedFrame_destroy(ConsoleSharedFrame* sharedFrame, Console* console)
+{
+    ConsoleSharedFrameState* state = sharedFrame->_state;
+    if (!state) return;
+
+    Console_setPresenter(console, state->next.present ? &state->next : NULL);
+
+#ifdef _WIN32
+    UnmapViewOfFile(state->data);
+    CloseHandle(state->mapping);
+#else
+    munmap(state->data, state->size);
+    shm_unlink(state->name);
+#endif
+
+    free(state->changedRows);
+    free(state->name);
+    free(state);
+    sharedFrame->_state = NULL;
+}
+
+ConsoleSharedFrameView ConsoleSharedFrameView_open(const char* name)
+{
+    ConsoleSharedFrameView view;
+    memset(&view, 0, sizeof(view));
+
+    const uint8_t* data = NULL;
+    size_t size = 0;
+
+#ifdef _WIN32
+    view._mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name + (name[0] == '/'));
+    if (!view._mapping) return view;
+
+    data = MapViewOfFile(view._mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data)
+    {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(data, &info, sizeof(info));
+        size = info.RegionSize;
+    }
+#else
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return view;
+
+    struct stat status;
+    if (fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(ConsoleSharedFrameHeader))
+    {
+        size = status.st_size;
+        data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+    }
+    close(fd);
+#endif
+
+    view.header = (const ConsoleSharedFrameHeader*)data;
+    view._size = size;
+
+    size_t rowFramesOffset;
+    size_t dirtyRowsOffset;
+    size_t cellsOffset;
+    if (!data || size < sizeof(ConsoleSharedFrameHeader) || memcmp(view.header->magic, "CSHM", 4) != 0 ||
+        ConsoleSharedFrame_getSize(view.header->width, view.header->height, &rowFramesOffset, &dirtyRowsOffset, &cellsOffset) > size)
+    {
+        ConsoleSharedFrameView_close(&view);
+        return view;
+    }
+
+    view.width = view.header->width;
+    view.height = view.header->height;
+    view.rowFrames = (const uint32_t*)&data[rowFramesOffset];
+    view.dirtyRows = (const uint64_t*)&data[dirtyRowsOffset];
+    view.cells = (const ConsoleCell*)&data[cellsOffset];
+    return view;
+}
+
+void ConsoleSharedFrameView_close(ConsoleSharedFrameView* view)
+{
+#ifdef _WIN32
+    if (view->header) UnmapViewOfFile(view->header);
+    if (view->_mapping) CloseHandle(view->_mapping);
+#else
+    if (view->header) munmap((void*)view->header, view->_size);
+#endif
+
+    memset(view, 0, sizeof(ConsoleSharedFrameView));
+}
+
+uint32_t ConsoleSharedFrameView_beginRead(const ConsoleSharedFrameView* view)
+{
+    return (uint32_t)ConsoleAtomic_load((ConsoleAtomicInt*)&view->header->sequence);
+}
+
+char ConsoleSharedFrameView_endRead(const ConsoleSharedFrameView* view, uint32_t sequence)
+{
+    ConsoleAtomic_fence();
+    return !(sequence & 1) && (uint32_t)ConsoleAtomic_load((ConsoleAtomicInt*)&view->header->sequence) == sequence;
+}
+
+char ConsoleSharedFrameView_read(const ConsoleSharedFrameView* view, ConsoleBuffer* consoleBuffer, uint32_t* frame)
+{
+    const uint32_t sequence = ConsoleSharedFrameView_beginRead(view);
+    if (sequence & 1) return 0;
+
+    const uint32_t latest = view->header->frame;
+    if (latest == *frame) return 0;
+
+    const int width = view->width;
+    for (int y = 0; y < view->height; y++)
+    {
+        // Stamps only grow, so a row is new to this reader if it changed after the reader's last frame
+        if (view->rowFrames[y] - *frame - 1 >= latest - *frame) continue;
+
+        memcpy(&consoleBuffer->_cells[y * width], &view->cells[y * width], width * sizeof(ConsoleCell));
+        ConsoleBuffer_markDirty(consoleBuffer, 0, y, width, 1);
+    }
+
+    if (!ConsoleSharedFrameView_endRead(view, sequence)) return 0;
+
+    *frame = latest;
+    return 1;
+}
\ No newline at end of file
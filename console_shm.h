@@ -0,0 +1,71 @@
+//
+// --- Shared memory framebuffer, publishes presented frames for viewers in other processes
+//
+
+#pragma once
+
+#include "console.h"
+#include "console_thread.h"
+
+// Segment layout: ConsoleSharedFrameHeader, then height uint32_t row stamps, the dirty row bitmap as
+// (height + 63) / 64 uint64_t words, then width * height cells. All of it is written by one process only
+typedef struct ConsoleSharedFrameHeader
+{
+    char magic[4];
+    uint32_t width;
+    uint32_t height;
+
+    // Seqlock: odd while the writer is updating. A read is consistent if this was even and unchanged around it
+    ConsoleAtomicInt sequence;
+
+    // Frames published so far. Row stamps hold the frame each row last changed in, the bitmap the rows of the latest frame
+    uint32_t frame;
+    uint32_t reserved;
+} ConsoleSharedFrameHeader;
+
+typedef struct ConsoleSharedFrameState ConsoleSharedFrameState;
+
+// Writer side, owned by the console's process
+typedef struct ConsoleSharedFrame
+{
+    ConsoleSharedFrameState* _state;
+} ConsoleSharedFrame;
+
+// Creates the named segment, e.g. "/console", and publishes every frame the console displays into it, copying only the
+// rows that changed. Like a recorder it runs in front of the current presenter. Leaves _state NULL on failure
+ConsoleSharedFrame ConsoleSharedFrame_create(Console* console, const char* name);
+
+// Restores the previous presenter and removes the segment. Readers that have it mapped keep the last frame
+void ConsoleSharedFrame_destroy(ConsoleSharedFrame* sharedFrame, Console* console);
+
+// Reader side. The pointers map the segment directly, so readers can also inspect cells in place between
+// ConsoleSharedFrameView_beginRead and ConsoleSharedFrameView_endRead
+typedef struct ConsoleSharedFrameView
+{
+    int width;
+    int height;
+
+    const ConsoleSharedFrameHeader* header;
+    const uint32_t* rowFrames;
+    const uint64_t* dirtyRows;
+    const ConsoleCell* cells;
+
+    size_t _size;
+#ifdef _WIN32
+    HANDLE _mapping;
+#endif
+} ConsoleSharedFrameView;
+
+// width and height are 0 if the segment does not exist
+ConsoleSharedFrameView ConsoleSharedFrameView_open(const char* name);
+void ConsoleSharedFrameView_close(ConsoleSharedFrameView* view);
+
+// Returns the sequence to pass to endRead, or an odd value if the writer is busy and the read should be tried later
+uint32_t ConsoleSharedFrameView_beginRead(const ConsoleSharedFrameView* view);
+
+// Returns 0 if the writer changed the segment since beginRead, in which case anything read is torn
+char ConsoleSharedFrameView_endRead(const ConsoleSharedFrameView* view, uint32_t sequence);
+
+// Copies the rows that changed since *frame into a buffer of the segment's size and moves *frame on. Returns 0 without
+// blocking if there is no newer frame or the writer is busy; rows copied from a torn read are copied again next time
+char ConsoleSharedFrameView_read(const ConsoleSharedFrameView* view, ConsoleBuffer* consoleBuffer, uint32_t* frame);
\ No newline at end of file
@@ -0,0 +1,334 @@
+#include "console_sprite.h"
+
+#define CONSOLE_SPRITE_SHORT_RUN 8
+
+// Rows with at least this many runs averaging under CONSOLE_SPRITE_SHORT_RUN / 2 cells are blitted masked
+#define CONSOLE_SPRITE_MASKED_MIN_RUNS 4
+
+static ConsoleSprite ConsoleSprite_empty()
+{
+    ConsoleSprite sprite;
+    memset(&sprite, 0, sizeof(sprite));
+    return sprite;
+}
+
+// Builds the runs from width x height cells and a mask that is non-zero for opaque cells. No opaque cell may equal transparentCell
+static ConsoleSprite ConsoleSprite_build(int width, int height, const ConsoleCell* cells, const uint8_t* opaque, ConsoleCell transparentCell)
+{
+    ConsoleSprite sprite = ConsoleSprite_empty();
+    sprite.width = width;
+    sprite.height = height;
+
+    int numRuns = 0;
+    int numCells = 0;
+    for (int i = 0; i < width * height; i++)
+    {
+        if (!opaque[i]) continue;
+        if (i % width == 0 || !opaque[i - 1]) numRuns++;
+        numCells++;
+    }
+
+    sprite._cells = malloc(max(numCells, 1) * sizeof(ConsoleCell));
+    CONSOLE_PROFILE_ALLOCATION();
+    sprite._runs = malloc(max(numRuns, 1) * sizeof(ConsoleSpriteRun));
+    CONSOLE_PROFILE_ALLOCATION();
+    sprite._rowRuns = malloc((height + 1) * sizeof(int));
+    CONSOLE_PROFILE_ALLOCATION();
+    sprite._bounds = (ConsoleRect){width, height, 0, 0};
+
+    numRuns = 0;
+    numCells = 0;
+    for (int y = 0; y < height; y++)
+    {
+        sprite._rowRuns[y] = numRuns;
+
+        for (int x = 0; x < width;)
+        {
+            if (!opaque[y * width + x])
+            {
+                x++;
+                continue;
+            }
+
+            ConsoleSpriteRun* run = &sprite._runs[numRuns++];
+            run->x = x;
+            run->offset = numCells;
+            while (x < width && opaque[y * width + x])
+            {
+                sprite._cells[numCells++] = cells[y * width + x];
+                x++;
+            }
+            run->length = x - run->x;
+
+            sprite._bounds.left = min(sprite._bounds.left, run->x);
+            sprite._bounds.right = max(sprite._bounds.right, x);
+            sprite._bounds.top = min(sprite._bounds.top, y);
+            sprite._bounds.bottom = y + 1;
+        }
+    }
+    sprite._rowRuns[height] = numRuns;
+
+    if (numRuns == 0) sprite._bounds = (ConsoleRect){0, 0, 0, 0};
+
+    // Copying many short runs one by one costs more than a masked copy over the row, which is vectorized
+    sprite._rowMasked = malloc(height * sizeof(int));
+    CONSOLE_PROFILE_ALLOCATION();
+    sprite._transparentCell = transparentCell;
+    int numMasked = 0;
+    for (int y = 0; y < height; y++)
+    {
+        const int rowRuns = sprite._rowRuns[y + 1] - sprite._rowRuns[y];
+        const ConsoleSpriteRun* last = &sprite._runs[sprite._rowRuns[y + 1] - 1];
+        const int rowCells = rowRuns > 0 ? last->offset + last->length - sprite._runs[sprite._rowRuns[y]].offset : 0;
+
+        char masked = rowRuns >= CONSOLE_SPRITE_MASKED_MIN_RUNS && rowCells * 2 < rowRuns * CONSOLE_SPRITE_SHORT_RUN;
+        sprite._rowMasked[y] = masked ? numMasked++ : -1;
+    }
+
+    if (numMasked > 0)
+    {
+        sprite._maskedRows = ConsoleBuffer_create(width, numMasked);
+        for (int y = 0; y < height; y++)
+        {
+            if (sprite._rowMasked[y] < 0) continue;
+
+            ConsoleCell* row = &sprite._maskedRows._cells[sprite._rowMasked[y] * width];
+            for (int x = 0; x < width; x++)
+            {
+                row[x] = opaque[y * width + x] ? cells[y * width + x] : transparentCell;
+            }
+        }
+    }
+
+    return sprite;
+}
+
+ConsoleSprite ConsoleSprite_create(const ConsoleBuffer* source, int sourceX, int sourceY, int width, int height, ConsoleCell transparentCell)
+{
+    if (width <= 0 || height <= 0) return ConsoleSprite_empty();
+
+    ConsoleCell* cells = malloc(width * height * sizeof(ConsoleCell));
+    CONSOLE_PROFILE_ALLOCATION();
+    uint8_t* opaque = malloc(width * height);
+    CONSOLE_PROFILE_ALLOCATION();
+
+    // Cells outside the source are transparent
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int sx = sourceX + x;
+            int sy = sourceY + y;
+            char inside = sx >= 0 && sx < source->width && sy >= 0 && sy < source->height;
+
+            cells[y * width + x] = inside ? source->_cells[sy * source->width + sx] : transparentCell;
+            opaque[y * width + x] = cells[y * width + x] != transparentCell;
+        }
+    }
+
+    ConsoleSprite sprite = ConsoleSprite_build(width, height, cells, opaque, transparentCell);
+    free(opaque);
+    free(cells);
+    return sprite;
+}
+
+// Reads a line without its line ending, keeping up to capacity characters. Returns its length, or -1 at the end of the file
+static int ConsoleSprite_readLine(FILE* file, char* line, int capacity)
+{
+    int length = 0;
+    int c = fgetc(file);
+    if (c == EOF) return -1;
+
+    while (c != EOF && c != '\n')
+    {
+        if (length < capacity) line[length] = (char)c;
+        length++;
+        c = fgetc(file);
+    }
+
+    length = min(length, capacity);
+    if (length > 0 && line[length - 1] == '\r') length--;
+    return length;
+}
+
+static int ConsoleSprite_hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+ConsoleSprite ConsoleSprite_load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return ConsoleSprite_empty();
+
+    char header[64];
+    int width = 0;
+    int height = 0;
+    int headerLength = ConsoleSprite_readLine(file, header, sizeof(header) - 1);
+    if (headerLength >= 0) header[headerLength] = '\0';
+
+    if (headerLength < 0 || sscanf(header, "sprite %d %d", &width, &height) != 2 || width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF)
+    {
+        fclose(file);
+        return ConsoleSprite_empty();
+    }
+
+    const int capacity = 2 * width + 1;
+    char* line = malloc(capacity);
+    CONSOLE_PROFILE_ALLOCATION();
+    ConsoleCell* cells = malloc(width * height * sizeof(ConsoleCell));
+    CONSOLE_PROFILE_ALLOCATION();
+    uint8_t* opaque = malloc(width * height);
+    CONSOLE_PROFILE_ALLOCATION();
+    char valid = 1;
+
+    for (int y = 0; y < height && valid; y++)
+    {
+        int length = ConsoleSprite_readLine(file, line, capacity);
+        valid = length >= 0;
+
+        for (int x = 0; x < width; x++)
+        {
+            cells[y * width + x] = CONSOLE_CELL(x < length ? line[x] : ' ', 0);
+        }
+    }
+
+    for (int y = 0; y < height && valid; y++)
+    {
+        valid = ConsoleSprite_readLine(file, line, capacity) >= 2 * width;
+
+        for (int x = 0; x < width && valid; x++)
+        {
+            const char* digits = &line[2 * x];
+            opaque[y * width + x] = !(digits[0] == '.' && digits[1] == '.');
+            if (!opaque[y * width + x]) continue;
+
+            int high = ConsoleSprite_hexDigit(digits[0]);
+            int low = ConsoleSprite_hexDigit(digits[1]);
+            valid = high >= 0 && low >= 0;
+            if (valid) cells[y * width + x] = CONSOLE_CELL(CONSOLE_CELL_CHAR(cells[y * width + x]), (high << 4) | low);
+        }
+    }
+
+    fclose(file);
+
+    // Transparent cells have no value of their own in the file, so masked rows use one no opaque cell has
+    ConsoleSprite sprite = ConsoleSprite_empty();
+    if (valid)
+    {
+        uint8_t* used = calloc(0x10000 / 8, 1);
+        CONSOLE_PROFILE_ALLOCATION();
+        for (int i = 0; i < width * height; i++)
+        {
+            if (opaque[i]) used[cells[i] >> 3] |= 1 << (cells[i] & 7);
+        }
+
+        int transparentCell = 0;
+        while (transparentCell < 0xFFFF && (used[transparentCell >> 3] & (1 << (transparentCell & 7)))) transparentCell++;
+        free(used);
+
+        sprite = ConsoleSprite_build(width, height, cells, opaque, (ConsoleCell)transparentCell);
+    }
+    free(opaque);
+    free(cells);
+    free(line);
+    return sprite;
+}
+
+void ConsoleSprite_destroy(ConsoleSprite* sprite)
+{
+    free(sprite->_cells);
+    free(sprite->_runs);
+    free(sprite->_rowRuns);
+    free(sprite->_rowMasked);
+    if (sprite->_maskedRows._cells) ConsoleBuffer_destroy(&sprite->_maskedRows);
+    *sprite = ConsoleSprite_empty();
+}
+
+int ConsoleSprite_getOpaqueCount(const ConsoleSprite* sprite)
+{
+    if (!sprite->_rowRuns) return 0;
+
+    const int numRuns = sprite->_rowRuns[sprite->height];
+    if (numRuns == 0) return 0;
+
+    const ConsoleSpriteRun* last = &sprite->_runs[numRuns - 1];
+    return last->offset + last->length;
+}
+
+void ConsoleBuffer_blitSprite(ConsoleBuffer* consoleBuffer, const ConsoleSprite* sprite, int x, int y)
+{
+    const ConsoleRect clip = consoleBuffer->_clip;
+    const ConsoleRect bounds = sprite->_bounds;
+
+    int left = (int)max((int64_t)x + bounds.left, (int64_t)clip.left);
+    int top = (int)max((int64_t)y + bounds.top, (int64_t)clip.top);
+    int right = (int)min((int64_t)x + bounds.right, (int64_t)clip.right);
+    int bottom = (int)min((int64_t)y + bounds.bottom, (int64_t)clip.bottom);
+    if (left >= right || top >= bottom) return;
+
+    ConsoleBuffer_markDirty(consoleBuffer, left, top, right - left, bottom - top);
+
+    // Only sprites cut by the left or right edge of the clip rect need their runs trimmed
+    const char clipped = left > x + bounds.left || right < x + bounds.right;
+
+    for (int row = top; row < bottom; row++)
+    {
+        const int spriteY = row - y;
+        const ConsoleSpriteRun* run = &sprite->_runs[sprite->_rowRuns[spriteY]];
+        const ConsoleSpriteRun* end = &sprite->_runs[sprite->_rowRuns[spriteY + 1]];
+        ConsoleCell* cells = &consoleBuffer->_cells[row * consoleBuffer->width];
+
+        if (sprite->_rowMasked[spriteY] >= 0)
+        {
+            // Consecutive masked rows are stored together, so they go in one blit over the columns their runs span
+            int from = run->x;
+            int to = (end - 1)->x + (end - 1)->length;
+            int rows = 1;
+            while (row + rows < bottom && sprite->_rowMasked[spriteY + rows] >= 0)
+            {
+                const ConsoleSpriteRun* first = &sprite->_runs[sprite->_rowRuns[spriteY + rows]];
+                const ConsoleSpriteRun* last = &sprite->_runs[sprite->_rowRuns[spriteY + rows + 1] - 1];
+                from = min(from, first->x);
+                to = max(to, last->x + last->length);
+                rows++;
+            }
+
+            ConsoleBuffer_blitMasked(consoleBuffer, &sprite->_maskedRows, x + from, row, from, sprite->_rowMasked[spriteY], to - from, rows, sprite->_transparentCell);
+            row += rows - 1;
+            continue;
+        }
+
+        for (; run < end; run++)
+        {
+            int start = x + run->x;
+            int length = run->length;
+            const ConsoleCell* source = &sprite->_cells[run->offset];
+
+            if (clipped)
+            {
+                if (start < left)
+                {
+                    length -= left - start;
+                    source += left - start;
+                    start = left;
+                }
+                length = min(length, right - start);
+                if (length <= 0) continue;
+            }
+
+            // Short runs, common around the edges of shapes, are cheaper to copy inline than through a call
+            if (length <= CONSOLE_SPRITE_SHORT_RUN)
+            {
+                for (int i = 0; i < length; i++) cells[start + i] = source[i];
+            }
+            else
+            {
+                memcpy(&cells[start], source, length * sizeof(ConsoleCell));
+            }
+        }
+    }
+}
\ No newline at end of file
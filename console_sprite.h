@@ -0,0 +1,53 @@
+//
+// --- Sprites, images stored as runs of opaque cells so blits skip transparent cells entirely
+//
+
+#pragma once
+
+#include "console.h"
+
+typedef struct ConsoleSpriteRun
+{
+    int x;
+    int length;
+
+    // Index of the run's first cell in _cells
+    int offset;
+} ConsoleSpriteRun;
+
+typedef struct ConsoleSprite
+{
+    int width;
+    int height;
+
+    // Opaque cells of all runs back to back, row by row
+    ConsoleCell* _cells;
+    ConsoleSpriteRun* _runs;
+
+    // Runs of row y are _runs[_rowRuns[y]] up to _runs[_rowRuns[y + 1]]
+    int* _rowRuns;
+
+    // Bounds of the opaque cells, marked dirty as a whole on blit
+    ConsoleRect _bounds;
+
+    // Rows made of many short runs are blitted as a masked copy of row _rowMasked[y] of _maskedRows instead, skipping
+    // cells equal to _transparentCell. -1 for rows copied run by run
+    int* _rowMasked;
+    ConsoleBuffer _maskedRows;
+    ConsoleCell _transparentCell;
+} ConsoleSprite;
+
+// Bakes a width x height region of source into a sprite, leaving out the cells equal to transparentCell
+ConsoleSprite ConsoleSprite_create(const ConsoleBuffer* source, int sourceX, int sourceY, int width, int height, ConsoleCell transparentCell);
+
+// Loads a sprite from a text file, width and height are 0 if it could not be read. The file starts with a line
+// "sprite <width> <height>", followed by height lines of characters, then height lines of attributes as two hex digits
+// per cell, e.g. 1F, with .. for transparent cells. Character lines shorter than the width are padded with spaces
+ConsoleSprite ConsoleSprite_load(const char* path);
+void ConsoleSprite_destroy(ConsoleSprite* sprite);
+
+// Number of opaque cells, what a blit of the whole sprite costs
+int ConsoleSprite_getOpaqueCount(const ConsoleSprite* sprite);
+
+// Copies the sprite's opaque runs with its top left corner at (x, y), clipped to the clip rect
+void ConsoleBuffer_blitSprite(ConsoleBuffer* consoleBuffer, const ConsoleSprite* sprite, int x, int y);
\ No newline at end of file
@@ -0,0 +1,757 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "console_stream.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+typedef SOCKET ConsoleSocket;
+#define CONSOLE_INVALID_SOCKET INVALID_SOCKET
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+typedef int ConsoleSocket;
+#define CONSOLE_INVALID_SOCKET -1
+#endif
+
+// A client that closed its end must not kill the server with SIGPIPE. Where send has no flag for it the socket option is set
+#ifdef MSG_NOSIGNAL
+#define CONSOLE_STREAM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define CONSOLE_STREAM_SEND_FLAGS 0
+#endif
+
+// Gaps between changed cells up to the size of a run header cost less to send than a new run
+#define CONSOLE_STREAM_GAP_MAX (int)(sizeof(ConsoleStreamRun) / sizeof(ConsoleCell))
+
+#define CONSOLE_STREAM_BACKLOG 8
+
+// An encoded frame, shared by every client it is sent to and freed when the last one has sent it
+typedef struct ConsoleStreamPacket
+{
+    int refs;
+    size_t size;
+    uint8_t data[];
+} ConsoleStreamPacket;
+
+typedef struct ConsoleStreamConnection
+{
+    ConsoleSocket socket;
+
+    // The packet being sent and how much of it went out. Clients take one packet at a time, the next frame is only
+    // sent once this one is done
+    ConsoleStreamPacket* packet;
+    size_t sent;
+
+    // The last frame sent. Clients that missed frames, or have none yet, catch up with a keyframe
+    uint32_t frame;
+    char hasFrame;
+} ConsoleStreamConnection;
+
+struct ConsoleStreamServerState
+{
+    ConsoleSocket listener;
+    char* path;
+
+    int width;
+    int height;
+
+    ConsoleStreamConnection* clients;
+    int numClients;
+    int clientCapacity;
+
+    // The last frame published, which deltas are encoded against and keyframes are taken from
+    ConsoleCell* previous;
+    uint32_t frame;
+
+    // Keyframe of the last frame, encoded once on first need
+    ConsoleStreamPacket* keyframe;
+
+    // Dirty mark taken from markCells at the last publish, as for the recorder
+    uint32_t mark;
+    const ConsoleCell* markCells;
+
+    // Delta being encoded, starting with room for its header
+    uint8_t* payload;
+    size_t payloadSize;
+    size_t payloadCapacity;
+
+    ConsoleStreamServerStats stats;
+    ConsolePresenter next;
+};
+
+struct ConsoleStreamClientState
+{
+    ConsoleSocket socket;
+
+    // Bytes received and not applied yet, never more than one whole frame
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+};
+
+static char ConsoleStream_startup()
+{
+#ifdef _WIN32
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    return 1;
+#endif
+}
+
+static void ConsoleStream_cleanup()
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+static void ConsoleStream_closeSocket(ConsoleSocket socket)
+{
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+static void ConsoleStream_setNonBlocking(ConsoleSocket socket)
+{
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(socket, FIONBIO, &nonBlocking);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+#endif
+}
+
+static char ConsoleStream_wouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+// Fills in the socket address for "unix:<path>" or "tcp:<port>", returning its length or 0 if the address is not valid
+static int ConsoleStream_parseAddress(const char* address, struct sockaddr_storage* storage)
+{
+    memset(storage, 0, sizeof(*storage));
+
+    if (strncmp(address, "tcp:", 4) == 0)
+    {
+        char* end;
+        long port = strtol(address + 4, &end, 10);
+        if (end == address + 4 || *end != '\0' || port <= 0 || port > 0xFFFF) return 0;
+
+        // Only ever loopback, frames are not meant to leave the machine
+        struct sockaddr_in* inet = (struct sockaddr_in*)storage;
+        inet->sin_family = AF_INET;
+        inet->sin_port = htons((uint16_t)port);
+        inet->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return sizeof(struct sockaddr_in);
+    }
+
+#ifndef _WIN32
+    if (strncmp(address, "unix:", 5) == 0)
+    {
+        struct sockaddr_un* local = (struct sockaddr_un*)storage;
+        if (address[5] == '\0' || strlen(address + 5) >= sizeof(local->sun_path)) return 0;
+
+        local->sun_family = AF_UNIX;
+        strcpy(local->sun_path, address + 5);
+        return sizeof(struct sockaddr_un);
+    }
+#endif
+
+    return 0;
+}
+
+// Returns the bytes sent, 0 if the socket is full, or -1 if the connection is gone
+static int ConsoleStream_send(ConsoleSocket socket, const uint8_t* data, size_t size)
+{
+    int sent = (int)send(socket, (const char*)data, (int)min(size, (size_t)1 << 30), CONSOLE_STREAM_SEND_FLAGS);
+    if (sent >= 0) return sent;
+    return ConsoleStream_wouldBlock() ? 0 : -1;
+}
+
+static ConsoleStreamPacket* ConsoleStreamPacket_create(const void* data, size_t size)
+{
+    ConsoleStreamPacket* packet = malloc(sizeof(ConsoleStreamPacket) + size);
+    CONSOLE_PROFILE_ALLOCATION();
+    packet->refs = 1;
+    packet->size = size;
+    memcpy(packet->data, data, size);
+    return packet;
+}
+
+static void ConsoleStreamPacket_release(ConsoleStreamPacket* packet)
+{
+    if (packet && --packet->refs == 0) free(packet);
+}
+
+static void ConsoleStreamServer_reservePayload(ConsoleStreamServerState* state, size_t size)
+{
+    if (state->payloadSize + size > state->payloadCapacity)
+    {
+        state->payloadCapacity = max(state->payloadCapacity * 2, state->payloadSize + size);
+        state->payload = realloc(state->payload, state->payloadCapacity);
+        CONSOLE_PROFILE_ALLOCATION();
+    }
+}
+
+static void ConsoleStreamServer_appendRun(ConsoleStreamServerState* state, int offset, const ConsoleCell* cells, int count)
+{
+    size_t size = sizeof(ConsoleStreamRun) + count * sizeof(ConsoleCell);
+    ConsoleStreamServer_reservePayload(state, size);
+
+    ConsoleStreamRun run = {(uint32_t)offset, (uint32_t)count};
+    memcpy(&state->payload[state->payloadSize], &run, sizeof(run));
+    memcpy(&state->payload[state->payloadSize + sizeof(run)], cells, count * sizeof(ConsoleCell));
+    state->payloadSize += size;
+}
+
+// Encodes the cells of row y within [start, end) that differ from the previous frame, updating previous as it goes
+static void ConsoleStreamServer_encodeSpan(ConsoleStreamServerState* state, const ConsoleCell* cells, int y, int start, int end)
+{
+    const ConsoleCell* row = &cells[y * state->width];
+    ConsoleCell* previousRow = &state->previous[y * state->width];
+    if (memcmp(&row[start], &previousRow[start], (end - start) * sizeof(ConsoleCell)) == 0) return;
+
+    int x = start;
+    while (1)
+    {
+        while (x < end && row[x] == previousRow[x]) x++;
+        if (x >= end) break;
+
+        int runEnd = x + 1;
+        while (runEnd < end)
+        {
+            if (row[runEnd] != previousRow[runEnd])
+            {
+                runEnd++;
+                continue;
+            }
+
+            int gapEnd = runEnd;
+            while (gapEnd < end && gapEnd - runEnd <= CONSOLE_STREAM_GAP_MAX && row[gapEnd] == previousRow[gapEnd]) gapEnd++;
+            if (gapEnd >= end || gapEnd - runEnd > CONSOLE_STREAM_GAP_MAX) break;
+            runEnd = gapEnd;
+        }
+
+        ConsoleStreamServer_appendRun(state, y * state->width + x, &row[x], runEnd - x);
+        memcpy(&previousRow[x], &row[x], (runEnd - x) * sizeof(ConsoleCell));
+        x = runEnd;
+    }
+}
+
+// Encodes the frame as a delta against the previous one into payload, after room for the header. With dirty tracking
+// only tiles written since the last publish are compared
+static void ConsoleStreamServer_encodeDelta(ConsoleStreamServerState* state, ConsoleBuffer* consoleBuffer)
+{
+    const uint32_t mark = state->mark;
+    const char useMark = state->markCells == consoleBuffer->_cells && consoleBuffer->_tileStamps;
+    state->mark = ConsoleBuffer_takeDirtyMark(consoleBuffer);
+    state->markCells = consoleBuffer->_cells;
+
+    state->payloadSize = 0;
+    ConsoleStreamServer_reservePayload(state, sizeof(ConsoleStreamFrameHeader));
+    state->payloadSize = sizeof(ConsoleStreamFrameHeader);
+
+    for (int tileY = 0; tileY * CONSOLE_TILE_HEIGHT < state->height; tileY++)
+    {
+        const int top = tileY * CONSOLE_TILE_HEIGHT;
+        const int bottom = min(top + CONSOLE_TILE_HEIGHT, state->height);
+
+        if (!useMark)
+        {
+            for (int y = top; y < bottom; y++) ConsoleStreamServer_encodeSpan(state, consoleBuffer->_cells, y, 0, state->width);
+            continue;
+        }
+
+        int tileX = 0;
+        while (tileX < consoleBuffer->_tilesX)
+        {
+            if (!ConsoleBuffer_isTileDirty(consoleBuffer, tileX, tileY, mark))
+            {
+                tileX++;
+                continue;
+            }
+
+            int tileEnd = tileX + 1;
+            while (tileEnd < consoleBuffer->_tilesX && ConsoleBuffer_isTileDirty(consoleBuffer, tileEnd, tileY, mark)) tileEnd++;
+
+            const int start = tileX * CONSOLE_TILE_WIDTH;
+            const int end = min(tileEnd * CONSOLE_TILE_WIDTH, state->width);
+            for (int y = top; y < bottom; y++)
+            {
+                ConsoleStreamServer_encodeSpan(state, consoleBuffer->_cells, y, start, end);
+            }
+            tileX = tileEnd;
+        }
+    }
+}
+
+static ConsoleStreamPacket* ConsoleStreamServer_getKeyframe(ConsoleStreamServerState* state)
+{
+    if (state->keyframe) return state->keyframe;
+
+    const size_t frameSize = state->width * state->height * sizeof(ConsoleCell);
+    ConsoleStreamFrameHeader header = {CONSOLE_STREAM_KEYFRAME, (uint32_t)frameSize, state->frame, 0};
+
+    ConsoleStreamPacket* packet = malloc(sizeof(ConsoleStreamPacket) + sizeof(header) + frameSize);
+    CONSOLE_PROFILE_ALLOCATION();
+    packet->refs = 1;
+    packet->size = sizeof(header) + frameSize;
+    memcpy(packet->data, &header, sizeof(header));
+    memcpy(&packet->data[sizeof(header)], state->previous, frameSize);
+
+    state->keyframe = packet;
+    state->stats.bytesEncoded += packet->size;
+    return packet;
+}
+
+// Sends what is left of the client's packet. Returns 0 if the connection is gone
+static char ConsoleStreamServer_flush(ConsoleStreamServerState* state, ConsoleStreamConnection* client)
+{
+    while (client->packet)
+    {
+        int sent = ConsoleStream_send(client->socket, &client->packet->data[client->sent], client->packet->size - client->sent);
+        if (sent < 0) return 0;
+        if (sent == 0) break;
+
+        client->sent += sent;
+        state->stats.bytesSent += sent;
+        if (client->sent == client->packet->size)
+        {
+            ConsoleStreamPacket_release(client->packet);
+            client->packet = NULL;
+        }
+    }
+
+    return 1;
+}
+
+static void ConsoleStreamServer_removeClient(ConsoleStreamServerState* state, int index)
+{
+    ConsoleStreamConnection* client = &state->clients[index];
+    ConsoleStream_closeSocket(client->socket);
+    ConsoleStreamPacket_release(client->packet);
+
+    state->clients[index] = state->clients[--state->numClients];
+}
+
+static void ConsoleStreamServer_accept(ConsoleStreamServerState* state)
+{
+    while (1)
+    {
+        ConsoleSocket socket = accept(state->listener, NULL, NULL);
+        if (socket == CONSOLE_INVALID_SOCKET) return;
+
+        ConsoleStream_setNonBlocking(socket);
+
+        // The hello is tiny and the socket's buffer empty, a client it does not fit in whole is dropped
+        ConsoleStreamHello hello = {{'C', 'S', 'T', 'R'}, CONSOLE_STREAM_VERSION, (uint32_t)state->width, (uint32_t)state->height};
+        if (ConsoleStream_send(socket, (const uint8_t*)&hello, sizeof(hello)) != (int)sizeof(hello))
+        {
+            ConsoleStream_closeSocket(socket);
+            continue;
+        }
+
+        if (state->numClients == state->clientCapacity)
+        {
+            state->clientCapacity = max(state->clientCapacity * 2, 4);
+            state->clients = realloc(state->clients, state->clientCapacity * sizeof(ConsoleStreamConnection));
+            CONSOLE_PROFILE_ALLOCATION();
+        }
+
+        ConsoleStreamConnection* client = &state->clients[state->numClients++];
+        memset(client, 0, sizeof(ConsoleStreamConnection));
+        client->socket = socket;
+        state->stats.bytesSent += sizeof(hello);
+    }
+}
+
+// Moves every client on to the latest frame. Clients one frame behind get delta if there is one, clients further
+// behind a keyframe, and clients still sending an earlier frame skip this one
+static void ConsoleStreamServer_serviceClients(ConsoleStreamServerState* state, ConsoleStreamPacket* delta)
+{
+    for (int i = 0; i < state->numClients; i++)
+    {
+        ConsoleStreamConnection* client = &state->clients[i];
+        if (!ConsoleStreamServer_flush(state, client))
+        {
+            ConsoleStreamServer_removeClient(state, i--);
+            continue;
+        }
+
+        if (state->frame == 0 || (client->hasFrame && client->frame == state->frame)) continue;
+
+        if (client->packet)
+        {
+            if (delta) state->stats.skipped++;
+            continue;
+        }
+
+        if (delta && client->hasFrame && client->frame + 1 == state->frame)
+        {
+            client->packet = delta;
+        }
+        else
+        {
+            client->packet = ConsoleStreamServer_getKeyframe(state);
+            state->stats.keyframes++;
+        }
+        client->packet->refs++;
+        client->sent = 0;
+        client->frame = state->frame;
+        client->hasFrame = 1;
+
+        if (!ConsoleStreamServer_flush(state, client)) ConsoleStreamServer_removeClient(state, i--);
+    }
+}
+
+static void ConsoleStreamServer_publish(ConsoleStreamServerState* state, ConsoleBuffer* consoleBuffer)
+{
+    ConsoleStreamServer_accept(state);
+    ConsoleStreamServer_encodeDelta(state, consoleBuffer);
+
+    // The first frame is published even if it matches the buffer the server started from
+    const size_t size = state->payloadSize - sizeof(ConsoleStreamFrameHeader);
+    if (size == 0 && state->frame > 0)
+    {
+        ConsoleStreamServer_serviceClients(state, NULL);
+        return;
+    }
+
+    state->frame++;
+    state->stats.frames++;
+    ConsoleStreamPacket_release(state->keyframe);
+    state->keyframe = NULL;
+
+    // A delta as large as the frame is no better than a keyframe, which clients behind need anyway
+    ConsoleStreamPacket* delta = NULL;
+    char waiting = 0;
+    for (int i = 0; i < state->numClients && !waiting; i++)
+    {
+        waiting = state->clients[i].hasFrame && !state->clients[i].packet;
+    }
+
+    if (waiting && size < state->width * state->height * sizeof(ConsoleCell))
+    {
+        ConsoleStreamFrameHeader header = {CONSOLE_STREAM_DELTA, (uint32_t)size, state->frame, 0};
+        memcpy(state->payload, &header, sizeof(header));
+        delta = ConsoleStreamPacket_create(state->payload, state->payloadSize);
+        state->stats.bytesEncoded += delta->size;
+    }
+
+    ConsoleStreamServer_serviceClients(state, delta);
+    ConsoleStreamPacket_release(delta);
+}
+
+static void ConsoleStreamServer_present(void* userData, Console* console)
+{
+    ConsoleStreamServerState* state = userData;
+    ConsoleStreamServer_publish(state, &console->consoleBuffer);
+
+    ConsolePresenter self = console->_presenter;
+    console->_presenter = state->next;
+    Console_display(console);
+    console->_presenter = self;
+}
+
+ConsoleStreamServer ConsoleStreamServer_create(Console* console, const char* address)
+{
+    ConsoleStreamServer server;
+    server._state = NULL;
+
+    struct sockaddr_storage storage;
+    int length = ConsoleStream_parseAddress(address, &storage);
+    if (length == 0 || !ConsoleStream_startup()) return server;
+
+    ConsoleSocket listener = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (listener == CONSOLE_INVALID_SOCKET)
+    {
+        ConsoleStream_cleanup();
+        return server;
+    }
+
+    const char* path = NULL;
+    if (storage.ss_family == AF_INET)
+    {
+        // Lets a restarted server take the port back while connections of the last one linger
+        int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    }
+    else
+    {
+        // A socket file left behind by a server that did not shut down would fail the bind. Anything else at the path is
+        // left alone and the bind fails instead
+        path = address + 5;
+#ifndef _WIN32
+        struct stat status;
+        if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode)) unlink(path);
+#endif
+    }
+
+    if (bind(listener, (struct sockaddr*)&storage, length) != 0 || listen(listener, CONSOLE_STREAM_BACKLOG) != 0)
+    {
+        ConsoleStream_closeSocket(listener);
+        ConsoleStream_cleanup();
+        return server;
+    }
+    ConsoleStream_setNonBlocking(listener);
+
+    const int width = console->consoleBuffer.width;
+    const int height = console->consoleBuffer.height;
+
+    ConsoleStreamServerState* state = malloc(sizeof(ConsoleStreamServerState));
+    CONSOLE_PROFILE_ALLOCATION();
+    memset(state, 0, sizeof(ConsoleStreamServerState));
+    state->listener = listener;
+    state->width = width;
+    state->height = height;
+    state->previous = malloc(width * height * sizeof(ConsoleCell));
+    CONSOLE_PROFILE_ALLOCATION();
+    memcpy(state->previous, console->consoleBuffer._cells, width * height * sizeof(ConsoleCell));
+
+    if (path)
+    {
+        state->path = malloc(strlen(path) + 1);
+        CONSOLE_PROFILE_ALLOCATION();
+        strcpy(state->path, path);
+    }
+
+    state->next = console->_presenter;
+    ConsolePresenter presenter;
+    presenter.present = ConsoleStreamServer_present;
+    presenter.userData = state;
+    Console_setPresenter(console, &presenter);
+
+    server._state = state;
+    return server;
+}
+
+void ConsoleStreamServer_destroy(ConsoleStreamServer* server, Console* console)
+{
+    ConsoleStreamServerState* state = server->_state;
+    if (!state) return;
+
+    Console_setPresenter(console, state->next.present ? &state->next : NULL);
+
+    while (state->numClients > 0) ConsoleStreamServer_removeClient(state, state->numClients - 1);
+    ConsoleStream_closeSocket(state->listener);
+#ifndef _WIN32
+    if (state->path) unlink(state->path);
+#endif
+    ConsoleStream_cleanup();
+
+    ConsoleStreamPacket_release(state->keyframe);
+    free(state->clients);
+    free(state->previous);
+    free(state->payload);
+    free(state->path);
+    free(state);
+    server->_state = NULL;
+}
+
+void ConsoleStreamServer_poll(ConsoleStreamServer* server)
+{
+    ConsoleStreamServerState* state = server->_state;
+    ConsoleStreamServer_accept(state);
+
+    // Clients never send anything, so a readable socket is one that was closed. Sends find those too, but only once
+    // there is a frame to send
+    for (int i = 0; i < state->numClients; i++)
+    {
+        char byte;
+        int count = (int)recv(state->clients[i].socket, &byte, 1, MSG_PEEK);
+        if (count == 0 || (count < 0 && !ConsoleStream_wouldBlock())) ConsoleStreamServer_removeClient(state, i--);
+    }
+
+    ConsoleStreamServer_serviceClients(state, NULL);
+}
+
+ConsoleStreamServerStats ConsoleStreamServer_getStats(const ConsoleStreamServer* server)
+{
+    ConsoleStreamServerStats stats = server->_state->stats;
+    stats.clients = server->_state->numClients;
+    return stats;
+}
+
+static ConsoleStreamClient ConsoleStreamClient_empty()
+{
+    ConsoleStreamClient client;
+    memset(&client, 0, sizeof(client));
+    return client;
+}
+
+// Waits up to timeoutMs for the socket to have something to read
+static char ConsoleStreamClient_wait(ConsoleSocket socket, int timeoutMs)
+{
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(socket, &readable);
+
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    return select((int)socket + 1, &readable, NULL, NULL, &timeout) > 0;
+}
+
+ConsoleStreamClient ConsoleStreamClient_connect(const char* address, int timeoutMs)
+{
+    ConsoleStreamClient client = ConsoleStreamClient_empty();
+
+    struct sockaddr_storage storage;
+    int length = ConsoleStream_parseAddress(address, &storage);
+    if (length == 0 || !ConsoleStream_startup()) return client;
+
+    ConsoleSocket connection = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (connection == CONSOLE_INVALID_SOCKET)
+    {
+        ConsoleStream_cleanup();
+        return client;
+    }
+
+    // The server accepts when it next displays or polls, and answers with the hello straight away
+    ConsoleStreamHello hello;
+    int received = 0;
+    if (connect(connection, (struct sockaddr*)&storage, length) == 0)
+    {
+        const double deadline = Console_getTime() + timeoutMs / 1000.0;
+        while (received < (int)sizeof(hello))
+        {
+            const int remainingMs = (int)((deadline - Console_getTime()) * 1000.0);
+            if (remainingMs <= 0 || !ConsoleStreamClient_wait(connection, remainingMs)) break;
+
+            int count = (int)recv(connection, (char*)&hello + received, (int)sizeof(hello) - received, 0);
+            if (count <= 0) break;
+            received += count;
+        }
+    }
+
+    if (received < (int)sizeof(hello) || memcmp(hello.magic, "CSTR", 4) != 0 || hello.version != CONSOLE_STREAM_VERSION ||
+        hello.width == 0 || hello.height == 0 || hello.width > 0xFFFF || hello.height > 0xFFFF)
+    {
+        ConsoleStream_closeSocket(connection);
+        ConsoleStream_cleanup();
+        return client;
+    }
+    ConsoleStream_setNonBlocking(connection);
+
+    ConsoleStreamClientState* state = malloc(sizeof(ConsoleStreamClientState));
+    CONSOLE_PROFILE_ALLOCATION();
+    state->socket = connection;
+    state->size = 0;
+    state->capacity = sizeof(ConsoleStreamFrameHeader) + hello.width * hello.height * sizeof(ConsoleCell);
+    state->data = malloc(state->capacity);
+    CONSOLE_PROFILE_ALLOCATION();
+
+    client.width = hello.width;
+    client.height = hello.height;
+    client._state = state;
+    return client;
+}
+
+void ConsoleStreamClient_close(ConsoleStreamClient* client)
+{
+    ConsoleStreamClientState* state = client->_state;
+    if (!state) return;
+
+    ConsoleStream_closeSocket(state->socket);
+    ConsoleStream_cleanup();
+    free(state->data);
+    free(state);
+    *client = ConsoleStreamClient_empty();
+}
+
+// Applies one frame's payload, returning 0 if it does not fit the buffer
+static char ConsoleStreamClient_apply(ConsoleStreamClient* client, ConsoleBuffer* consoleBuffer, const ConsoleStreamFrameHeader* header, const uint8_t* payload)
+{
+    const int width = client->width;
+    const size_t numCells = (size_t)width * client->height;
+
+    if (header->type == CONSOLE_STREAM_KEYFRAME)
+    {
+        if (header->size != numCells * sizeof(ConsoleCell)) return 0;
+
+        memcpy(consoleBuffer->_cells, payload, header->size);
+        ConsoleBuffer_markDirty(consoleBuffer, 0, 0, width, client->height);
+        return 1;
+    }
+
+    if (header->type != CONSOLE_STREAM_DELTA) return 0;
+
+    size_t offset = 0;
+    while (offset < header->size)
+    {
+        ConsoleStreamRun run;
+        if (header->size - offset < sizeof(run)) return 0;
+        memcpy(&run, &payload[offset], sizeof(run));
+        offset += sizeof(run);
+
+        if (run.offset > numCells || run.count > numCells - run.offset || (header->size - offset) / sizeof(ConsoleCell) < run.count) return 0;
+        memcpy(&consoleBuffer->_cells[run.offset], &payload[offset], run.count * sizeof(ConsoleCell));
+        offset += run.count * sizeof(ConsoleCell);
+
+        // Runs are encoded within a row, though nothing breaks if one is not
+        const int x = run.offset % width;
+        const int y = run.offset / width;
+        if (x + run.count <= (uint32_t)width) ConsoleBuffer_markDirty(consoleBuffer, x, y, run.count, 1);
+        else ConsoleBuffer_markDirty(consoleBuffer, 0, y, width, (run.offset + run.count - 1) / width - y + 1);
+    }
+
+    return 1;
+}
+
+int ConsoleStreamClient_read(ConsoleStreamClient* client, ConsoleBuffer* consoleBuffer)
+{
+    ConsoleStreamClientState* state = client->_state;
+    char changed = 0;
+
+    while (1)
+    {
+        int count = (int)recv(state->socket, (char*)&state->data[state->size], (int)(state->capacity - state->size), 0);
+        if (count < 0 && ConsoleStream_wouldBlock()) break;
+
+        // Frames that arrived before the server went are still shown
+        if (count <= 0) return changed ? 1 : -1;
+        state->size += count;
+
+        size_t offset = 0;
+        while (state->size - offset >= sizeof(ConsoleStreamFrameHeader))
+        {
+            ConsoleStreamFrameHeader header;
+            memcpy(&header, &state->data[offset], sizeof(header));
+            if (header.size > state->capacity - sizeof(header)) return -1;
+            if (state->size - offset - sizeof(header) < header.size) break;
+
+            if (!ConsoleStreamClient_apply(client, consoleBuffer, &header, &state->data[offset + sizeof(header)])) return -1;
+            offset += sizeof(header) + header.size;
+            changed = 1;
+        }
+
+        memmove(state->data, &state->data[offset], state->size - offset);
+        state->size -= offset;
+    }
+
+    return changed;
+}
\ No newline at end of file
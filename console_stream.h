@@ -0,0 +1,96 @@
+//
+// --- Frame streaming, publishes displayed frames to viewers connected over a socket
+//
+
+#pragma once
+
+#include "console.h"
+
+#define CONSOLE_STREAM_VERSION 1
+
+// Sent once to each client when it is accepted
+typedef struct ConsoleStreamHello
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+} ConsoleStreamHello;
+
+typedef enum ConsoleStreamFrameType
+{
+    // The size is width * height cells
+    CONSOLE_STREAM_KEYFRAME = 0,
+
+    // The cells that changed since the frame before, as runs of a ConsoleStreamRun followed by count cells
+    CONSOLE_STREAM_DELTA = 1,
+} ConsoleStreamFrameType;
+
+// Precedes every frame. Fields and cells are in the byte order of the server, streams are meant for local sockets
+typedef struct ConsoleStreamFrameHeader
+{
+    uint32_t type;
+    uint32_t size;
+    uint32_t frame;
+    uint32_t reserved;
+} ConsoleStreamFrameHeader;
+
+typedef struct ConsoleStreamRun
+{
+    uint32_t offset;
+    uint32_t count;
+} ConsoleStreamRun;
+
+typedef struct ConsoleStreamServerStats
+{
+    int clients;
+
+    // Frames published, frames not sent to clients that were still busy with an earlier one, and keyframes sent to
+    // new clients or to catch up those that skipped
+    uint32_t frames;
+    uint32_t skipped;
+    uint32_t keyframes;
+
+    // Bytes encoded, each shared by every client it goes to, and bytes sent
+    uint64_t bytesEncoded;
+    uint64_t bytesSent;
+} ConsoleStreamServerStats;
+
+typedef struct ConsoleStreamServerState ConsoleStreamServerState;
+
+typedef struct ConsoleStreamServer
+{
+    ConsoleStreamServerState* _state;
+} ConsoleStreamServer;
+
+// Listens on address, a Unix domain socket path as "unix:/tmp/console.sock" or a loopback TCP port as "tcp:7000", and
+// from then on publishes every frame the console displays to the clients connected. Like a recorder it runs in front
+// of the current presenter. Leaves _state NULL if the socket could not be set up
+ConsoleStreamServer ConsoleStreamServer_create(Console* console, const char* address);
+
+// Restores the previous presenter and disconnects all clients
+void ConsoleStreamServer_destroy(ConsoleStreamServer* server, Console* console);
+
+// Accepts clients and sends what is waiting without a new frame, for programs that display rarely, e.g. between
+// Console_waitEvents calls. Never blocks
+void ConsoleStreamServer_poll(ConsoleStreamServer* server);
+
+ConsoleStreamServerStats ConsoleStreamServer_getStats(const ConsoleStreamServer* server);
+
+typedef struct ConsoleStreamClientState ConsoleStreamClientState;
+
+typedef struct ConsoleStreamClient
+{
+    int width;
+    int height;
+
+    ConsoleStreamClientState* _state;
+} ConsoleStreamClient;
+
+// Connects to a server's address and waits up to timeoutMs milliseconds to be accepted. width and height are 0 on failure
+ConsoleStreamClient ConsoleStreamClient_connect(const char* address, int timeoutMs);
+void ConsoleStreamClient_close(ConsoleStreamClient* client);
+
+// Applies the frames that have arrived to a buffer of the stream's size without blocking, marking the cells they changed
+// dirty. Returns 1 if the buffer changed, 0 if not, and -1 once the server has gone or sent something unreadable
+int ConsoleStreamClient_read(ConsoleStreamClient* client, ConsoleBuffer* consoleBuffer);
\ No newline at end of file
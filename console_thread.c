@@ -0,0 +1,320 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "console_thread.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#endif
+
+typedef struct ConsoleThreadStart
+{
+    ConsoleThreadFunc func;
+    void* userData;
+} ConsoleThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI ConsoleThread_main(LPVOID parameter)
+#else
+static void* ConsoleThread_main(void* parameter)
+#endif
+{
+    ConsoleThreadStart start = *(ConsoleThreadStart*)parameter;
+    free(parameter);
+
+    start.func(start.userData);
+    return 0;
+}
+
+char ConsoleThread_start(ConsoleThread* thread, ConsoleThreadFunc func, void* userData)
+{
+    ConsoleThreadStart* start = malloc(sizeof(ConsoleThreadStart));
+    CONSOLE_PROFILE_ALLOCATION();
+    start->func = func;
+    start->userData = userData;
+
+#ifdef _WIN32
+    thread->_handle = CreateThread(NULL, 0, ConsoleThread_main, start, 0, NULL);
+    if (thread->_handle) return 1;
+#else
+    if (pthread_create(&thread->_thread, NULL, ConsoleThread_main, start) == 0) return 1;
+#endif
+
+    free(start);
+    return 0;
+}
+
+void ConsoleThread_join(ConsoleThread* thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread->_handle, INFINITE);
+    CloseHandle(thread->_handle);
+#else
+    pthread_join(thread->_thread, NULL);
+#endif
+}
+
+void ConsoleMutex_init(ConsoleMutex* mutex)
+{
+#ifdef _WIN32
+    InitializeSRWLock(&mutex->_lock);
+#else
+    pthread_mutex_init(&mutex->_mutex, NULL);
+#endif
+}
+
+void ConsoleMutex_destroy(ConsoleMutex* mutex)
+{
+#ifndef _WIN32
+    pthread_mutex_destroy(&mutex->_mutex);
+#endif
+}
+
+void ConsoleMutex_lock(ConsoleMutex* mutex)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&mutex->_lock);
+#else
+    pthread_mutex_lock(&mutex->_mutex);
+#endif
+}
+
+void ConsoleMutex_unlock(ConsoleMutex* mutex)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&mutex->_lock);
+#else
+    pthread_mutex_unlock(&mutex->_mutex);
+#endif
+}
+
+void ConsoleCondition_init(ConsoleCondition* condition)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(&condition->_condition);
+#else
+    // Timed waits count against the monotonic clock, so changing the system time does not stretch or cut them short
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&condition->_condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+#endif
+}
+
+void ConsoleCondition_destroy(ConsoleCondition* condition)
+{
+#ifndef _WIN32
+    pthread_cond_destroy(&condition->_condition);
+#endif
+}
+
+void ConsoleCondition_wait(ConsoleCondition* condition, ConsoleMutex* mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableSRW(&condition->_condition, &mutex->_lock, INFINITE, 0);
+#else
+    pthread_cond_wait(&condition->_condition, &mutex->_mutex);
+#endif
+}
+
+char ConsoleCondition_waitTimeout(ConsoleCondition* condition, ConsoleMutex* mutex, int timeoutMs)
+{
+#ifdef _WIN32
+    return SleepConditionVariableSRW(&condition->_condition, &mutex->_lock, (DWORD)max(timeoutMs, 0), 0) != 0;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    return pthread_cond_timedwait(&condition->_condition, &mutex->_mutex, &deadline) != ETIMEDOUT;
+#endif
+}
+
+void ConsoleCondition_signal(ConsoleCondition* condition)
+{
+#ifdef _WIN32
+    WakeConditionVariable(&condition->_condition);
+#else
+    pthread_cond_signal(&condition->_condition);
+#endif
+}
+
+void ConsoleCondition_broadcast(ConsoleCondition* condition)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(&condition->_condition);
+#else
+    pthread_cond_broadcast(&condition->_condition);
+#endif
+}
+
+int Console_getCpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return max((int)info.dwNumberOfProcessors, 1);
+#else
+    return max((int)sysconf(_SC_NPROCESSORS_ONLN), 1);
+#endif
+}
+
+struct ConsoleWorkerShared
+{
+    ConsoleMutex mutex;
+    ConsoleCondition wake;
+    ConsoleCondition done;
+
+    ConsoleThread* threads;
+    int numThreads;
+
+    // The current batch, replaced under the mutex whenever the generation changes
+    ConsoleJobFunc func;
+    void* userData;
+    int numJobs;
+    ConsoleAtomicInt nextJob;
+
+    int generation;
+    int busy;
+    char quit;
+};
+
+static void ConsoleWorkerPool_runJobs(ConsoleWorkerShared* shared, ConsoleJobFunc func, void* userData, int numJobs)
+{
+    int job;
+    while ((job = ConsoleAtomic_fetchAdd(&shared->nextJob, 1)) < numJobs)
+    {
+        func(userData, job);
+    }
+}
+
+static void ConsoleWorkerPool_worker(void* userData)
+{
+    ConsoleWorkerShared* shared = userData;
+    int seenGeneration = 0;
+
+    ConsoleMutex_lock(&shared->mutex);
+    while (1)
+    {
+        while (shared->generation == seenGeneration && !shared->quit)
+        {
+            ConsoleCondition_wait(&shared->wake, &shared->mutex);
+        }
+        if (shared->quit) break;
+
+        seenGeneration = shared->generation;
+        ConsoleJobFunc func = shared->func;
+        void* jobData = shared->userData;
+        int numJobs = shared->numJobs;
+        ConsoleMutex_unlock(&shared->mutex);
+
+        ConsoleWorkerPool_runJobs(shared, func, jobData, numJobs);
+
+        ConsoleMutex_lock(&shared->mutex);
+        if (--shared->busy == 0) ConsoleCondition_signal(&shared->done);
+    }
+    ConsoleMutex_unlock(&shared->mutex);
+}
+
+ConsoleWorkerPool ConsoleWorkerPool_create(int numThreads)
+{
+    if (numThreads <= 0) numThreads = Console_getCpuCount() - 1;
+
+    ConsoleWorkerShared* shared = malloc(sizeof(ConsoleWorkerShared));
+    CONSOLE_PROFILE_ALLOCATION();
+    ConsoleMutex_init(&shared->mutex);
+    ConsoleCondition_init(&shared->wake);
+    ConsoleCondition_init(&shared->done);
+    shared->func = NULL;
+    shared->userData = NULL;
+    shared->numJobs = 0;
+    shared->nextJob = 0;
+    shared->generation = 0;
+    shared->busy = 0;
+    shared->quit = 0;
+
+    shared->threads = malloc(max(numThreads, 1) * sizeof(ConsoleThread));
+    CONSOLE_PROFILE_ALLOCATION();
+    shared->numThreads = 0;
+    for (int i = 0; i < numThreads; i++)
+    {
+        if (!ConsoleThread_start(&shared->threads[shared->numThreads], ConsoleWorkerPool_worker, shared)) break;
+        shared->numThreads++;
+    }
+
+    ConsoleWorkerPool pool;
+    pool._shared = shared;
+    return pool;
+}
+
+void ConsoleWorkerPool_destroy(ConsoleWorkerPool* pool)
+{
+    ConsoleWorkerShared* shared = pool->_shared;
+    if (!shared) return;
+
+    ConsoleMutex_lock(&shared->mutex);
+    shared->quit = 1;
+    ConsoleCondition_broadcast(&shared->wake);
+    ConsoleMutex_unlock(&shared->mutex);
+
+    for (int i = 0; i < shared->numThreads; i++)
+    {
+        ConsoleThread_join(&shared->threads[i]);
+    }
+
+    ConsoleCondition_destroy(&shared->done);
+    ConsoleCondition_destroy(&shared->wake);
+    ConsoleMutex_destroy(&shared->mutex);
+    free(shared->threads);
+    free(shared);
+
+    pool->_shared = NULL;
+}
+
+int ConsoleWorkerPool_getWidth(const ConsoleWorkerPool* pool)
+{
+    return pool->_shared->numThreads + 1;
+}
+
+void ConsoleWorkerPool_run(ConsoleWorkerPool* pool, ConsoleJobFunc func, void* userData, int numJobs)
+{
+    ConsoleWorkerShared* shared = pool->_shared;
+
+    if (shared->numThreads == 0 || numJobs <= 1)
+    {
+        for (int job = 0; job < numJobs; job++)
+        {
+            func(userData, job);
+        }
+        return;
+    }
+
+    ConsoleMutex_lock(&shared->mutex);
+    shared->func = func;
+    shared->userData = userData;
+    shared->numJobs = numJobs;
+    ConsoleAtomic_store(&shared->nextJob, 0);
+    shared->busy = shared->numThreads;
+    shared->generation++;
+    ConsoleCondition_broadcast(&shared->wake);
+    ConsoleMutex_unlock(&shared->mutex);
+
+    ConsoleWorkerPool_runJobs(shared, func, userData, numJobs);
+
+    ConsoleMutex_lock(&shared->mutex);
+    while (shared->busy > 0)
+    {
+        ConsoleCondition_wait(&shared->done, &shared->mutex);
+    }
+    ConsoleMutex_unlock(&shared->mutex);
+}
\ No newline at end of file
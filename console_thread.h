@@ -0,0 +1,93 @@
+//
+// --- Threads, locks, atomics and a worker pool over Win32 and pthreads
+//
+
+#pragma once
+
+#include "console.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef volatile LONG ConsoleAtomicInt;
+
+static inline int ConsoleAtomic_load(ConsoleAtomicInt* atomic) { return InterlockedCompareExchange(atomic, 0, 0); }
+static inline void ConsoleAtomic_store(ConsoleAtomicInt* atomic, int value) { InterlockedExchange(atomic, value); }
+static inline int ConsoleAtomic_fetchAdd(ConsoleAtomicInt* atomic, int value) { return InterlockedExchangeAdd(atomic, value); }
+static inline void ConsoleAtomic_fence() { MemoryBarrier(); }
+#else
+typedef volatile int ConsoleAtomicInt;
+
+static inline int ConsoleAtomic_load(ConsoleAtomicInt* atomic) { return __atomic_load_n(atomic, __ATOMIC_ACQUIRE); }
+static inline void ConsoleAtomic_store(ConsoleAtomicInt* atomic, int value) { __atomic_store_n(atomic, value, __ATOMIC_RELEASE); }
+static inline int ConsoleAtomic_fetchAdd(ConsoleAtomicInt* atomic, int value) { return __atomic_fetch_add(atomic, value, __ATOMIC_ACQ_REL); }
+static inline void ConsoleAtomic_fence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#endif
+
+typedef void (*ConsoleThreadFunc)(void* userData);
+
+typedef struct ConsoleThread
+{
+#ifdef _WIN32
+    HANDLE _handle;
+#else
+    pthread_t _thread;
+#endif
+} ConsoleThread;
+
+typedef struct ConsoleMutex
+{
+#ifdef _WIN32
+    SRWLOCK _lock;
+#else
+    pthread_mutex_t _mutex;
+#endif
+} ConsoleMutex;
+
+typedef struct ConsoleCondition
+{
+#ifdef _WIN32
+    CONDITION_VARIABLE _condition;
+#else
+    pthread_cond_t _condition;
+#endif
+} ConsoleCondition;
+
+// Returns 0 if the thread could not be started
+char ConsoleThread_start(ConsoleThread* thread, ConsoleThreadFunc func, void* userData);
+void ConsoleThread_join(ConsoleThread* thread);
+
+void ConsoleMutex_init(ConsoleMutex* mutex);
+void ConsoleMutex_destroy(ConsoleMutex* mutex);
+void ConsoleMutex_lock(ConsoleMutex* mutex);
+void ConsoleMutex_unlock(ConsoleMutex* mutex);
+
+void ConsoleCondition_init(ConsoleCondition* condition);
+void ConsoleCondition_destroy(ConsoleCondition* condition);
+void ConsoleCondition_wait(ConsoleCondition* condition, ConsoleMutex* mutex);
+// Returns 0 if timeoutMs passed without a wake up. Callers recheck their condition either way
+char ConsoleCondition_waitTimeout(ConsoleCondition* condition, ConsoleMutex* mutex, int timeoutMs);
+void ConsoleCondition_signal(ConsoleCondition* condition);
+void ConsoleCondition_broadcast(ConsoleCondition* condition);
+
+int Console_getCpuCount();
+
+typedef void (*ConsoleJobFunc)(void* userData, int job);
+
+typedef struct ConsoleWorkerShared ConsoleWorkerShared;
+
+// Fixed set of threads that run numbered jobs. The calling thread joins in, so a pool of n threads runs jobs n + 1 wide
+typedef struct ConsoleWorkerPool
+{
+    ConsoleWorkerShared* _shared;
+} ConsoleWorkerPool;
+
+// numThreads of 0 or less starts one thread less than the CPU count
+ConsoleWorkerPool ConsoleWorkerPool_create(int numThreads);
+void ConsoleWorkerPool_destroy(ConsoleWorkerPool* pool);
+int ConsoleWorkerPool_getWidth(const ConsoleWorkerPool* pool);
+
+// Calls func for every job from 0 to numJobs - 1 across the pool and returns once all have finished
+void ConsoleWorkerPool_run(ConsoleWorkerPool* pool, ConsoleJobFunc func, void* userData, int numJobs);
\ No newline at end of file
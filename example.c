@@ -8,34 +8,15 @@
 #include <stdbool.h>
 
 #include "console.h"
+#include "console_history.h"
+#include "console_layer.h"
 
 #define SCREEN_WIDTH 80
 #define SCREEN_HEIGHT 40
 #define UNDO_HISTORY_MAX 30
 
-void drawingBuffers_shiftRight(ConsoleBuffer* drawingBuffers)
-{
-    ConsoleBuffer_destroy(&drawingBuffers[UNDO_HISTORY_MAX - 1]);
-
-    for (int i = UNDO_HISTORY_MAX - 1; i > 0; i--)
-    {
-        drawingBuffers[i] = drawingBuffers[i - 1];
-    }
-
-    drawingBuffers[0] = ConsoleBuffer_copy(&drawingBuffers[1]);
-}
-
-void drawingBuffers_shiftLeft(ConsoleBuffer* drawingBuffers)
-{
-    ConsoleBuffer_destroy(&drawingBuffers[0]);
-
-    for (int i = 0; i < UNDO_HISTORY_MAX - 1; i++)
-    {
-        drawingBuffers[i] = drawingBuffers[i + 1];
-    }
-
-    drawingBuffers[UNDO_HISTORY_MAX - 1] = ConsoleBuffer_copy(&drawingBuffers[UNDO_HISTORY_MAX - 2]);
-}
+// Keyed out of the preview and chrome layers
+#define TRANSPARENT_CELL CONSOLE_CELL(0, 0xFF)
 
 uint8_t getSelectedColour(uint8_t selected_colour)
 {
@@ -45,26 +26,104 @@ uint8_t getSelectedColour(uint8_t selected_colour)
     return colour;
 }
 
-int main(int argc, char* argv[])
+// Fills the ellipse fitting the rect between two corners
+void drawEllipseInRect(ConsoleBuffer* consoleBuffer, int x1, int y1, int x2, int y2, char c, WORD attrib)
 {
-    const char* title = "Epic Console Drawing";
-    const int titleLen = strlen(title);
-
-    Console console = Console_create(SCREEN_WIDTH, SCREEN_HEIGHT, title);
+    ConsoleBuffer_fillEllipse(consoleBuffer, (x1 + x2) / 2, (y1 + y2) / 2, abs(x2 - x1) / 2, abs(y2 - y1) / 2, c, attrib);
+}
 
-    ConsoleBuffer drawingBuffers[UNDO_HISTORY_MAX];
-    for (int i = 0; i < UNDO_HISTORY_MAX; i++)
+// Border, title, tooltips and colour selection, redrawn only when the fill tool or colour changes
+void drawChrome(ConsoleBuffer* chrome, const char* title, bool fillTool, uint8_t selectedColour)
+{
+    ConsoleBuffer_clear(chrome, CONSOLE_CELL_CHAR(TRANSPARENT_CELL), CONSOLE_CELL_ATTRIB(TRANSPARENT_CELL));
+
+    // Draw border
+    ConsoleBuffer_drawLine(chrome, 0, 0, 0, chrome->height, ' ', 8 << 4);
+    ConsoleBuffer_drawLine(chrome, 0, 0, chrome->width, 0, ' ', 8 << 4);
+    ConsoleBuffer_drawLine(chrome, chrome->width - 1, 0, chrome->width - 1, chrome->height, ' ', 8 << 4);
+    ConsoleBuffer_drawRect(chrome, 0, chrome->height - 2, chrome->width, 2, ' ', 8 << 4);
+
+    // Title/tooltips
+    int startTitle = SCREEN_WIDTH / 2 - (int)strlen(title) / 2;
+    ConsoleBuffer_drawText(chrome, title, startTitle, 0, 0x8F);
+    ConsoleBuffer_drawText(chrome, "Alt for ellipse tool", 1, 0, 0x8F);
+    ConsoleBuffer_drawText(chrome, fillTool ? "F for fill tool: on " : "F for fill tool: off", SCREEN_WIDTH - 21, 0, 0x8F);
+
+    ConsoleBuffer_drawText(chrome, "Space to clear", 0, SCREEN_HEIGHT - 2, 0x8F);
+    ConsoleBuffer_drawText(chrome, "Escape to quit", 0, SCREEN_HEIGHT - 1, 0x8F);
+    ConsoleBuffer_drawText(chrome, "Shift for line tool", 18, SCREEN_HEIGHT - 2, 0x8F);
+    ConsoleBuffer_drawText(chrome, "Ctrl for rect tool", 18, SCREEN_HEIGHT - 1, 0x8F);
+
+    // Colour selection
+    const int colourSelectionX = 43;
+    const int colourWidth = 2;
+    ConsoleBuffer_setChar(chrome, colourSelectionX, SCREEN_HEIGHT - 2, '<');
+    ConsoleBuffer_setForegroundAttrib(chrome, colourSelectionX, SCREEN_HEIGHT - 2, 0xF);
+    ConsoleBuffer_setChar(chrome, colourSelectionX + 16 * colourWidth + 1, SCREEN_HEIGHT - 2, '>');
+    ConsoleBuffer_setForegroundAttrib(chrome, colourSelectionX + 16 * colourWidth + 1, SCREEN_HEIGHT - 2, 0xF);
+
+    for (int i = 1; i < 16; i++)
     {
-        drawingBuffers[i] = ConsoleBuffer_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+        uint8_t colour = getSelectedColour(i);
+
+        for (int j = 0; j < colourWidth; j++)
+        {
+            ConsoleBuffer_setChar(chrome, colourSelectionX + i * colourWidth + j, SCREEN_HEIGHT - 2, ' ');
+            ConsoleBuffer_setBackgroundAttrib(chrome, colourSelectionX + i * colourWidth + j, SCREEN_HEIGHT - 2, colour);
+        }
+        
+        if ((selectedColour + 1) == i)
+        {
+            ConsoleBuffer_setChar(chrome, colourSelectionX + i * colourWidth, SCREEN_HEIGHT - 1, '^');
+            ConsoleBuffer_setForegroundAttrib(chrome, colourSelectionX + i * colourWidth, SCREEN_HEIGHT - 1, 0xF);
+        }
     }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* title = "Epic Console Drawing";
 
-    ConsoleBuffer* drawingBuffer = &drawingBuffers[UNDO_HISTORY_MAX - 1];
+    Console console = Console_create(SCREEN_WIDTH, SCREEN_HEIGHT, title);
+    ConsoleBuffer_setDirtyTracking(&console.consoleBuffer, 1);
+
+    ConsoleBuffer drawing = ConsoleBuffer_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+    ConsoleBuffer* drawingBuffer = &drawing;
+    ConsoleBuffer_setDirtyTracking(drawingBuffer, 1);
+
+    // Each edit is snapshotted after it is made, only the tiles it touched are copied
+    ConsoleHistory history = ConsoleHistory_create(drawingBuffer, UNDO_HISTORY_MAX);
+
+    // The screen is composed from the drawing, a shape preview, the chrome and the cursor. Each frame only the tiles
+    // under layers that changed are recomposed, so the chrome costs nothing until it is redrawn
+    ConsoleBuffer preview = ConsoleBuffer_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+    ConsoleBuffer chrome = ConsoleBuffer_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+    ConsoleBuffer cursor = ConsoleBuffer_create(1, 1);
+    ConsoleBuffer_clear(&preview, CONSOLE_CELL_CHAR(TRANSPARENT_CELL), CONSOLE_CELL_ATTRIB(TRANSPARENT_CELL));
+
+    ConsoleCompositor compositor = ConsoleCompositor_create(SCREEN_WIDTH, SCREEN_HEIGHT, CONSOLE_CELL(0, 0));
+    ConsoleCompositor_addLayer(&compositor, drawingBuffer, 0, 0);
+    int previewLayer = ConsoleCompositor_addLayer(&compositor, &preview, 0, 0);
+    int chromeLayer = ConsoleCompositor_addLayer(&compositor, &chrome, 0, 0);
+    int cursorLayer = ConsoleCompositor_addLayer(&compositor, &cursor, 0, 0);
+    ConsoleCompositor_setLayerTransparency(&compositor, previewLayer, 1, TRANSPARENT_CELL);
+    ConsoleCompositor_setLayerTransparency(&compositor, chromeLayer, 1, TRANSPARENT_CELL);
+
+    int previewX = 0;
+    int previewY = 0;
+    int previewWidth = 0;
+    int previewHeight = 0;
+    bool chromeChanged = true;
 
     int shapeStartX = 0;
     int shapeStartY = 0;
     bool drawingShape = false;
+    bool fillTool = false;
     uint8_t selectedColour = 14;
 
+    // Flood fill scratch, reset after each fill
+    ConsoleArena scratch = ConsoleArena_create(4096);
+
     bool running = true;
     while (running)
     {
@@ -83,27 +142,39 @@ int main(int argc, char* argv[])
                     }
                     if (event.Event.KeyEvent.wVirtualKeyCode == VK_SPACE)
                     {
-                        drawingBuffers_shiftLeft(drawingBuffers);
                         ConsoleBuffer_clear(drawingBuffer, 0, 0);
+                        ConsoleHistory_snapshot(&history, drawingBuffer);
+                    }
+
+                    if (event.Event.KeyEvent.wVirtualKeyCode == 0x46) // f
+                    {
+                        fillTool = !fillTool;
+                        chromeChanged = true;
                     }
 
                     if (event.Event.KeyEvent.wVirtualKeyCode == VK_LEFT)
                     {
                         selectedColour = ((selectedColour - 1) % 15 + 15) % 15;
+                        chromeChanged = true;
                     }
                     if (event.Event.KeyEvent.wVirtualKeyCode == VK_RIGHT)
                     {
                         selectedColour = ((selectedColour + 1) % 15 + 15) % 15;
+                        chromeChanged = true;
                     }
 
                     if (event.Event.KeyEvent.wVirtualKeyCode == 0x5A && Console_isKeyPressed(&console, VK_CONTROL)) // ctrl z
                     {
-                        drawingBuffers_shiftRight(drawingBuffers);
+                        ConsoleHistory_undo(&history, drawingBuffer);
+                    }
+                    if (event.Event.KeyEvent.wVirtualKeyCode == 0x59 && Console_isKeyPressed(&console, VK_CONTROL)) // ctrl y
+                    {
+                        ConsoleHistory_redo(&history, drawingBuffer);
                     }
                 }
                 else
                 {
-                    if (event.Event.KeyEvent.wVirtualKeyCode == VK_SHIFT || event.Event.KeyEvent.wVirtualKeyCode == VK_CONTROL)
+                    if (event.Event.KeyEvent.wVirtualKeyCode == VK_SHIFT || event.Event.KeyEvent.wVirtualKeyCode == VK_CONTROL || event.Event.KeyEvent.wVirtualKeyCode == VK_MENU)
                     {
                         drawingShape = false;
                     }
@@ -114,7 +185,7 @@ int main(int argc, char* argv[])
         int mouseX = Console_getMouseX(&console);
         int mouseY = Console_getMouseY(&console);
 
-        if (Console_isKeyPressed(&console, VK_SHIFT) || Console_isKeyPressed(&console, VK_CONTROL))
+        if (Console_isKeyPressed(&console, VK_SHIFT) || Console_isKeyPressed(&console, VK_CONTROL) || Console_isKeyPressed(&console, VK_MENU))
         {
             if (Console_isLeftMouseJustPressed(&console) || Console_isRightMouseJustPressed(&console))
             {
@@ -136,38 +207,56 @@ int main(int argc, char* argv[])
 
                 if (Console_isKeyPressed(&console, VK_SHIFT))
                 {
-                    drawingBuffers_shiftLeft(drawingBuffers);
                     ConsoleBuffer_drawLine(drawingBuffer, shapeStartX, shapeStartY, mouseX, mouseY, c, attrib);
+                    ConsoleHistory_snapshot(&history, drawingBuffer);
                 }
                 else if (Console_isKeyPressed(&console, VK_CONTROL))
                 {
-                    drawingBuffers_shiftLeft(drawingBuffers);
                     ConsoleBuffer_drawRect(drawingBuffer, shapeStartX, shapeStartY, mouseX - shapeStartX + 1, mouseY - shapeStartY + 1, c, attrib);
+                    ConsoleHistory_snapshot(&history, drawingBuffer);
+                }
+                else if (Console_isKeyPressed(&console, VK_MENU))
+                {
+                    drawEllipseInRect(drawingBuffer, shapeStartX, shapeStartY, mouseX, mouseY, c, attrib);
+                    ConsoleHistory_snapshot(&history, drawingBuffer);
                 }
 
                 drawingShape = false;
             }
         }
 
-        if (!drawingShape)
+        else if (fillTool)
+        {
+            if (Console_isLeftMouseJustPressed(&console) || Console_isRightMouseJustPressed(&console))
+            {
+                uint8_t colour = Console_isLeftMouseJustPressed(&console) ? getSelectedColour(selectedColour + 1) : 0;
+                if (ConsoleBuffer_floodFill(drawingBuffer, mouseX, mouseY, 0, colour << 4, CONSOLE_FILL_MATCH_ATTRIB, &scratch) > 0)
+                {
+                    ConsoleHistory_snapshot(&history, drawingBuffer);
+                }
+                ConsoleArena_reset(&scratch);
+            }
+        }
+        else if (!drawingShape)
         {
             if (Console_isLeftMousePressed(&console) && ConsoleBuffer_getPixel(drawingBuffer, mouseX, mouseY).Attributes != getSelectedColour(selectedColour + 1) << 4)
             {
-                drawingBuffers_shiftLeft(drawingBuffers);
                 ConsoleBuffer_setChar(drawingBuffer, mouseX, mouseY, 0);
                 ConsoleBuffer_setBackgroundAttrib(drawingBuffer, mouseX, mouseY, getSelectedColour(selectedColour + 1));
+                ConsoleHistory_snapshot(&history, drawingBuffer);
             }
             else if (Console_isRightMousePressed(&console) && ConsoleBuffer_getPixel(drawingBuffer, mouseX, mouseY).Attributes != 0)
             {
-                drawingBuffers_shiftLeft(drawingBuffers);
                 ConsoleBuffer_setChar(drawingBuffer, mouseX, mouseY, 0);
                 ConsoleBuffer_setBackgroundAttrib(drawingBuffer, mouseX, mouseY, 0);
+                ConsoleHistory_snapshot(&history, drawingBuffer);
             }
         }
 
-        ConsoleBuffer_clear(&console.consoleBuffer, 0, 0);
-
-        memcpy(console.consoleBuffer._buffer, drawingBuffer->_buffer, console.consoleBuffer.width * console.consoleBuffer.height * sizeof(CHAR_INFO));
+        // Shape preview, erasing the previous one first so only the tiles it touches are recomposed
+        ConsoleBuffer_drawRect(&preview, previewX, previewY, previewWidth, previewHeight, CONSOLE_CELL_CHAR(TRANSPARENT_CELL), CONSOLE_CELL_ATTRIB(TRANSPARENT_CELL));
+        previewWidth = 0;
+        previewHeight = 0;
 
         if (drawingShape)
         {
@@ -183,63 +272,51 @@ int main(int argc, char* argv[])
 
             if (Console_isKeyPressed(&console, VK_SHIFT))
             {
-                ConsoleBuffer_drawLine(&console.consoleBuffer, shapeStartX, shapeStartY, mouseX, mouseY, c, attrib);
+                ConsoleBuffer_drawLine(&preview, shapeStartX, shapeStartY, mouseX, mouseY, c, attrib);
             }
             else if (Console_isKeyPressed(&console, VK_CONTROL))
             {
-                ConsoleBuffer_drawRect(&console.consoleBuffer, shapeStartX, shapeStartY, mouseX - shapeStartX + 1, mouseY - shapeStartY + 1, c, attrib);
+                ConsoleBuffer_drawRect(&preview, shapeStartX, shapeStartY, mouseX - shapeStartX + 1, mouseY - shapeStartY + 1, c, attrib);
             }
+            else if (Console_isKeyPressed(&console, VK_MENU))
+            {
+                drawEllipseInRect(&preview, shapeStartX, shapeStartY, mouseX, mouseY, c, attrib);
+            }
+
+            previewX = min(shapeStartX, mouseX);
+            previewY = min(shapeStartY, mouseY);
+            previewWidth = abs(mouseX - shapeStartX) + 1;
+            previewHeight = abs(mouseY - shapeStartY) + 1;
         }
 
-        // Draw border
-        ConsoleBuffer_drawLine(&console.consoleBuffer, 0, 0, 0, console.consoleBuffer.height, ' ', 8 << 4);
-        ConsoleBuffer_drawLine(&console.consoleBuffer, 0, 0, console.consoleBuffer.width, 0, ' ', 8 << 4);
-        ConsoleBuffer_drawLine(&console.consoleBuffer, console.consoleBuffer.width - 1, 0, console.consoleBuffer.width - 1, console.consoleBuffer.height, ' ', 8 << 4);
-        ConsoleBuffer_drawRect(&console.consoleBuffer, 0, console.consoleBuffer.height - 2, console.consoleBuffer.width, 2, ' ', 8 << 4);
-
-        // Title/tooltips
-        int startTitle = SCREEN_WIDTH / 2 - titleLen / 2;
-        ConsoleBuffer_drawText(&console.consoleBuffer, title, startTitle, 0, 0x8F);
-
-        ConsoleBuffer_drawText(&console.consoleBuffer, "Space to clear", 0, SCREEN_HEIGHT - 2, 0x8F);
-        ConsoleBuffer_drawText(&console.consoleBuffer, "Escape to quit", 0, SCREEN_HEIGHT - 1, 0x8F);
-        ConsoleBuffer_drawText(&console.consoleBuffer, "Shift for line tool", 18, SCREEN_HEIGHT - 2, 0x8F);
-        ConsoleBuffer_drawText(&console.consoleBuffer, "Ctrl for rect tool", 18, SCREEN_HEIGHT - 1, 0x8F);
-
-        // Colour selection
-        const int colourSelectionX = 43;
-        const int colourWidth = 2;
-        ConsoleBuffer_setChar(&console.consoleBuffer, colourSelectionX, SCREEN_HEIGHT - 2, '<');
-        ConsoleBuffer_setForegroundAttrib(&console.consoleBuffer, colourSelectionX, SCREEN_HEIGHT - 2, 0xF);
-        ConsoleBuffer_setChar(&console.consoleBuffer, colourSelectionX + 16 * colourWidth + 1, SCREEN_HEIGHT - 2, '>');
-        ConsoleBuffer_setForegroundAttrib(&console.consoleBuffer, colourSelectionX + 16 * colourWidth + 1, SCREEN_HEIGHT - 2, 0xF);
-
-        for (int i = 1; i < 16; i++)
+        if (chromeChanged)
         {
-            uint8_t colour = getSelectedColour(i);
-
-            for (int j = 0; j < colourWidth; j++)
-            {
-                ConsoleBuffer_setChar(&console.consoleBuffer, colourSelectionX + i * colourWidth + j, SCREEN_HEIGHT - 2, ' ');
-                ConsoleBuffer_setBackgroundAttrib(&console.consoleBuffer, colourSelectionX + i * colourWidth + j, SCREEN_HEIGHT - 2, colour);
-            }
-            
-            if ((selectedColour + 1) == i)
-            {
-                ConsoleBuffer_setChar(&console.consoleBuffer, colourSelectionX + i * colourWidth, SCREEN_HEIGHT - 1, '^');
-                ConsoleBuffer_setForegroundAttrib(&console.consoleBuffer, colourSelectionX + i * colourWidth, SCREEN_HEIGHT - 1, 0xF);
-            }
+            drawChrome(&chrome, title, fillTool, selectedColour);
+            chromeChanged = false;
         }
 
-        ConsoleBuffer_setChar(&console.consoleBuffer, mouseX, mouseY, ' ');
         int cursorColour = 7;
         if (Console_isLeftMousePressed(&console)) cursorColour = 15;
         else if (Console_isRightMousePressed(&console)) cursorColour = 4;
-        ConsoleBuffer_setBackgroundAttrib(&console.consoleBuffer, mouseX, mouseY, cursorColour);
+        if (ConsoleBuffer_getPixel(&cursor, 0, 0).Attributes != cursorColour << 4)
+        {
+            ConsoleBuffer_setBackgroundAttrib(&cursor, 0, 0, cursorColour);
+        }
+        ConsoleCompositor_setLayerPosition(&compositor, cursorLayer, mouseX, mouseY);
+
+        ConsoleCompositor_display(&compositor, &console);
 
-        Console_display(&console);
+        // Everything on screen follows the input, so there is nothing to do until more arrives
+        if (running) Console_waitEvents(&console, -1);
     }
 
+    ConsoleCompositor_destroy(&compositor);
+    ConsoleBuffer_destroy(&cursor);
+    ConsoleBuffer_destroy(&chrome);
+    ConsoleBuffer_destroy(&preview);
+    ConsoleArena_destroy(&scratch);
+    ConsoleHistory_destroy(&history);
+    ConsoleBuffer_destroy(drawingBuffer);
     Console_destroy(&console);
 
     return 0;
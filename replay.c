@@ -0,0 +1,158 @@
+//
+// --- Replays a console_record.h recording, at its own pace or as fast as possible as a benchmark
+//
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "console.h"
+#include "console_record.h"
+
+typedef struct ReplayBench
+{
+    uint64_t bytes;
+} ReplayBench;
+
+void replay_countBytes(void* userData, const char* bytes, size_t size)
+{
+    ReplayBench* bench = userData;
+    bench->bytes += size;
+}
+
+// Displays every frame on a headless console, so the cost is decoding plus the normal display path
+int replay_bench(ConsoleRecording* recording, int repeats)
+{
+    ReplayBench bench = {0};
+    Console console = Console_createHeadless(recording->width, recording->height, replay_countBytes, &bench);
+    ConsoleBuffer_setDirtyTracking(&console.consoleBuffer, 1);
+
+    double decodeSeconds = 0;
+    double displaySeconds = 0;
+
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        for (int frame = 0; frame < recording->numFrames; frame++)
+        {
+            double start = Console_getTime();
+            ConsoleRecording_readFrame(recording, frame, &console.consoleBuffer);
+            double decoded = Console_getTime();
+            Console_display(&console);
+            double displayed = Console_getTime();
+
+            decodeSeconds += decoded - start;
+            displaySeconds += displayed - decoded;
+        }
+    }
+
+    double frames = (double)recording->numFrames * repeats;
+    double cells = (double)frames * recording->width * recording->height;
+
+    printf("%-10s %10s %10s %10s %10s %12s\n", "size", "frames", "frames/s", "decode", "display", "bytes/frame");
+    printf("%5dx%-4d %10.0f %10.1f %10.2f %10.2f %12.1f\n", recording->width, recording->height, frames,
+        frames / (decodeSeconds + displaySeconds), decodeSeconds * 1e9 / cells, displaySeconds * 1e9 / cells, bench.bytes / frames);
+
+    Console_destroy(&console);
+    return 0;
+}
+
+// Plays in real time. Space pauses, the arrow keys seek and escape quits
+int replay_play(ConsoleRecording* recording)
+{
+    Console console = Console_create(recording->width, recording->height, "Replay");
+
+    int frame = 0;
+    bool paused = false;
+    bool quit = false;
+
+    // Added to recording times to get Console_getTime times, moved on seeks and pauses
+    double offset = Console_getTime() - ConsoleRecording_readFrame(recording, frame, &console.consoleBuffer);
+    Console_display(&console);
+
+    while (!quit)
+    {
+        Console_refreshEvents(&console);
+
+        ConsoleEvent event;
+        while (Console_pollEvent(&console, &event))
+        {
+            if (event.EventType != KEY_EVENT || !event.Event.KeyEvent.bKeyDown) continue;
+
+            WORD key = event.Event.KeyEvent.wVirtualKeyCode;
+            if (key == VK_ESCAPE)
+            {
+                quit = true;
+            }
+            else if (key == VK_SPACE)
+            {
+                paused = !paused;
+            }
+            else if (key == VK_LEFT || key == VK_RIGHT)
+            {
+                frame += (key == VK_LEFT) ? -CONSOLE_RECORD_KEYFRAME_INTERVAL : CONSOLE_RECORD_KEYFRAME_INTERVAL;
+                frame = max(min(frame, recording->numFrames - 1), 0);
+            }
+            else
+            {
+                continue;
+            }
+
+            offset = Console_getTime() - ConsoleRecording_readFrame(recording, frame, &console.consoleBuffer);
+            Console_display(&console);
+        }
+
+        if (quit) break;
+
+        if (paused || frame + 1 >= recording->numFrames)
+        {
+            Console_waitEvents(&console, -1);
+            continue;
+        }
+
+        // Sleeps until the next frame is due, unless a key comes first
+        double nextTime = ConsoleRecording_readFrame(recording, frame + 1, &console.consoleBuffer);
+        int waitMs = (int)((nextTime + offset - Console_getTime()) * 1000.0);
+        if (waitMs > 0 && Console_waitEvents(&console, waitMs)) continue;
+
+        frame++;
+        Console_display(&console);
+    }
+
+    Console_destroy(&console);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: replay <recording> [--bench [repeats]]\n");
+        return 1;
+    }
+
+    ConsoleRecording recording = ConsoleRecording_open(argv[1]);
+    if (recording.width == 0 || recording.numFrames == 0)
+    {
+        printf("could not read %s\n", argv[1]);
+        ConsoleRecording_close(&recording);
+        return 1;
+    }
+
+    int result;
+    if (argc > 2 && strcmp(argv[2], "--bench") == 0)
+    {
+        result = replay_bench(&recording, argc > 3 ? max(atoi(argv[3]), 1) : 1);
+    }
+    else
+    {
+        result = replay_play(&recording);
+    }
+
+    ConsoleRecording_close(&recording);
+    return result;
+}
\ No newline at end of file
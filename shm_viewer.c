@@ -0,0 +1,57 @@
+//
+// --- Mirrors a console published with ConsoleSharedFrame in this terminal. Escape quits
+//
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "console.h"
+#include "console_shm.h"
+
+#define VIEWER_POLL_MS 16
+
+int main(int argc, char* argv[])
+{
+    const char* name = argc > 1 ? argv[1] : "/console";
+
+    ConsoleSharedFrameView view = ConsoleSharedFrameView_open(name);
+    if (view.width == 0)
+    {
+        printf("no shared frame named %s\n", name);
+        return 1;
+    }
+
+    Console console = Console_create(view.width, view.height, "Viewer");
+    ConsoleBuffer_setDirtyTracking(&console.consoleBuffer, 1);
+
+    uint32_t frame = 0;
+    bool quit = false;
+
+    while (!quit)
+    {
+        Console_refreshEvents(&console);
+
+        ConsoleEvent event;
+        while (Console_pollEvent(&console, &event))
+        {
+            if (event.EventType == KEY_EVENT && event.Event.KeyEvent.bKeyDown && event.Event.KeyEvent.wVirtualKeyCode == VK_ESCAPE)
+            {
+                quit = true;
+            }
+        }
+
+        // Only rows that changed since the last frame read are copied, and only changed cells are written out
+        if (ConsoleSharedFrameView_read(&view, &console.consoleBuffer, &frame))
+        {
+            Console_display(&console);
+        }
+
+        Console_waitEvents(&console, VIEWER_POLL_MS);
+    }
+
+    Console_destroy(&console);
+    ConsoleSharedFrameView_close(&view);
+    return 0;
+}
\ No newline at end of file
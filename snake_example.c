@@ -8,6 +8,7 @@
 #include <time.h>
 
 #include "console.h"
+#include "console_stream.h"
 
 #define SCREEN_WIDTH 80
 #define SCREEN_HEIGHT 40
@@ -58,12 +59,16 @@ int sign(int value)
     return value > 0 ? 1 : -1;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
     srand(time(NULL));
 
     Console console = Console_create(SCREEN_WIDTH, SCREEN_HEIGHT, "Snake");
 
+    // Given an address, e.g. unix:/tmp/snake.sock, the game is streamed to stream_client viewers
+    ConsoleStreamServer server = {0};
+    if (argc > 1) server = ConsoleStreamServer_create(&console, argv[1]);
+
     Vec2 snake[SNAKE_LENGTH_MAX];
     int snakeLen = snake_init(snake);
     int dir = 0; // right, down, left, up
@@ -72,20 +77,22 @@ int main()
     apple.x = rand() % (SCREEN_WIDTH / 2);
     apple.y = rand() % SCREEN_HEIGHT;
 
-    int moveTick = 0;
-    const int MOVE_TICK_MAX = 230;
+    // The snake moves at a fixed rate, and the loop sleeps between moves and key presses
+    const double MOVES_PER_SECOND = 8;
+    ConsolePacer pacer = ConsolePacer_create(MOVES_PER_SECOND, 0);
 
     bool gameOver = false;
 
     bool running = true;
     while (running)
     {
-        Console_refreshEvents(&console);
+        ConsolePacer_wait(&pacer, &console);
+        if (server._state) ConsoleStreamServer_poll(&server);
 
         ConsoleEvent event;
         while (Console_pollEvent(&console, &event))
         {
-            if (event.Event.KeyEvent.bKeyDown)
+            if (event.EventType == KEY_EVENT && event.Event.KeyEvent.bKeyDown)
             {
                 if (event.Event.KeyEvent.wVirtualKeyCode == VK_ESCAPE)
                 {
@@ -111,10 +118,8 @@ int main()
             }
         }
 
-        moveTick++;
-        if (moveTick >= MOVE_TICK_MAX && !gameOver)
+        while (ConsolePacer_update(&pacer) && !gameOver)
         {
-            moveTick = 0;
             snake_shift(snake, snakeLen);
             if (dir == 0)
             {
@@ -156,6 +161,11 @@ int main()
             }
         }
 
+        if (!ConsolePacer_present(&pacer))
+        {
+            continue;
+        }
+
         ConsoleBuffer_clear(&console.consoleBuffer, 0, 0);
 
         ConsoleBuffer_drawRect(&console.consoleBuffer, apple.x * 2, apple.y, 2, 1, ' ', BACKGROUND_RED);
@@ -167,7 +177,7 @@ int main()
 
         ConsoleBuffer_drawText(&console.consoleBuffer, "SCORE:", 0, 0, 15);
         char scoreStr[20];
-        itoa(snakeLen - SNAKE_LENGTH_INIT, scoreStr, 10);
+        snprintf(scoreStr, sizeof(scoreStr), "%d", snakeLen - SNAKE_LENGTH_INIT);
         ConsoleBuffer_drawText(&console.consoleBuffer, scoreStr, 8, 0, 15);
         
         if (gameOver)
@@ -175,8 +185,12 @@ int main()
             ConsoleBuffer_drawText(&console.consoleBuffer, "Game Over!", SCREEN_WIDTH / 2 - 5, SCREEN_HEIGHT / 2, 15);
         }
 
+        // Frame timings and counters, only drawn when built with -DCONSOLE_PROFILE
+        Console_drawProfileOverlay(&console, 0, SCREEN_HEIGHT - 3);
+
         Console_display(&console);
     }
 
+    ConsoleStreamServer_destroy(&server, &console);
     Console_destroy(&console);
 }
\ No newline at end of file
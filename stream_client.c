@@ -0,0 +1,56 @@
+//
+// --- Mirrors a console streamed with ConsoleStreamServer in this terminal. Escape quits
+//
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "console.h"
+#include "console_stream.h"
+
+#define CLIENT_POLL_MS 16
+#define CLIENT_CONNECT_MS 5000
+
+int main(int argc, char* argv[])
+{
+    const char* address = argc > 1 ? argv[1] : "unix:/tmp/console.sock";
+
+    ConsoleStreamClient client = ConsoleStreamClient_connect(address, CLIENT_CONNECT_MS);
+    if (client.width == 0)
+    {
+        printf("could not connect to %s\n", address);
+        return 1;
+    }
+
+    Console console = Console_create(client.width, client.height, "Stream");
+    ConsoleBuffer_setDirtyTracking(&console.consoleBuffer, 1);
+
+    bool quit = false;
+
+    while (!quit)
+    {
+        Console_refreshEvents(&console);
+
+        ConsoleEvent event;
+        while (Console_pollEvent(&console, &event))
+        {
+            if (event.EventType == KEY_EVENT && event.Event.KeyEvent.bKeyDown && event.Event.KeyEvent.wVirtualKeyCode == VK_ESCAPE)
+            {
+                quit = true;
+            }
+        }
+
+        // Frames arrive as the cells that changed, so only those are written out
+        int result = ConsoleStreamClient_read(&client, &console.consoleBuffer);
+        if (result > 0) Console_display(&console);
+        if (result < 0) quit = true;
+
+        Console_waitEvents(&console, CLIENT_POLL_MS);
+    }
+
+    Console_destroy(&console);
+    ConsoleStreamClient_close(&client);
+    return 0;
+}
\ No newline at end of file